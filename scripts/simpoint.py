@@ -0,0 +1,220 @@
+#!/usr/bin/python3
+
+# Sampled-simulation driver for the basic-block vectors written by the
+# emulator's +bbv=<file> profiling (WithSodorBBV).
+#
+# Clusters the per-interval vectors SimPoint-style (random projection, k-means,
+# BIC to pick k), picks the interval closest to each cluster centre as its
+# representative, and extrapolates whole-program CPI from the representatives'
+# CPI weighted by cluster size. Since the profiling run is a full run, the
+# estimate is reported against the true CPI as well.
+#
+#   ./simpoint.py dhrystone.bb
+#   ./simpoint.py dhrystone.bb --simpoints dhrystone.simpts --weights dhrystone.weights
+#
+# Sampled runs: once the representatives are chosen, a configuration under
+# study only needs to measure those intervals. Given the same +bbv_interval and
+# +bbv_sample=<simpts>, the emulator writes their cycles to its +bbv file and
+# stops after the last one; --measured then estimates CPI from that file. The
+# emulator has no functional fast-forward or checkpoints, so the intervals up
+# to the last representative are still simulated in detail (which also warms
+# the caches and predictors): what a sampled run saves is the rest of the
+# program, reported as "Simulated" below.
+#
+#   emulator +bbv=dhrystone.sample +bbv_sample=dhrystone.simpts dhrystone.riscv
+#   ./simpoint.py dhrystone.bb --measured dhrystone.sample
+
+import argparse
+import math
+import random
+import sys
+
+parser = argparse.ArgumentParser(description="SODOR basic-block vector clustering and CPI estimation")
+parser.add_argument('bb', help="basic-block vector file (+bbv=<file>)")
+parser.add_argument('--cycles', help="per-interval cycle counts (default: <bb>.cycles)")
+parser.add_argument('--measured',
+                    help="cycles measured for the representatives in separate sampled runs, as "
+                         "'<interval> <instructions> <cycles>' lines (default: take them from --cycles)")
+parser.add_argument('-k', '--max-k', type=int, default=10, help="maximum number of clusters")
+parser.add_argument('--dim', type=int, default=15, help="dimensions to project the vectors to")
+parser.add_argument('--bic-threshold', type=float, default=0.9,
+                    help="pick the smallest k whose BIC reaches this fraction of the best")
+parser.add_argument('--seeds', type=int, default=5, help="k-means initialisations per k")
+parser.add_argument('--seed', type=int, default=1, help="random seed")
+parser.add_argument('--simpoints', help="write the chosen intervals here (SimPoint .simpts format)")
+parser.add_argument('--weights', help="write the cluster weights here (SimPoint .weights format)")
+
+args = parser.parse_args()
+rng = random.Random(args.seed)
+
+
+def read_bbv(path):
+    vectors = []
+    with open(path) as f:
+        for line in f:
+            if not line.startswith('T'):
+                continue
+            v = {}
+            for field in line[1:].split():
+                _, block, count = field.split(':')
+                v[int(block)] = int(count)
+            vectors.append(v)
+    return vectors
+
+
+def read_cycles(path):
+    intervals = {}
+    with open(path) as f:
+        for line in f:
+            if line.startswith('#') or not line.strip():
+                continue
+            interval, insts, cycles = (int(x) for x in line.split())
+            intervals[interval] = (insts, cycles)
+    return intervals
+
+
+def project(vectors, dim):
+    # Each block gets a random direction; every vector is normalised to its
+    # interval's instruction count first so partial intervals compare fairly
+    directions = {}
+    points = []
+    for v in vectors:
+        total = sum(v.values())
+        p = [0.0] * dim
+        for block, count in v.items():
+            if block not in directions:
+                directions[block] = [rng.uniform(-1, 1) for _ in range(dim)]
+            d = directions[block]
+            for i in range(dim):
+                p[i] += d[i] * count / total
+        points.append(p)
+    return points
+
+
+def dist2(a, b):
+    return sum((x - y) ** 2 for x, y in zip(a, b))
+
+
+def kmeans(points, k, iterations=100):
+    # k-means++ seeding
+    centers = [rng.choice(points)]
+    while len(centers) < k:
+        d = [min(dist2(p, c) for c in centers) for p in points]
+        total = sum(d)
+        if total == 0:
+            centers.append(rng.choice(points))
+            continue
+        r = rng.uniform(0, total)
+        for p, w in zip(points, d):
+            r -= w
+            if r <= 0:
+                centers.append(p)
+                break
+        else:
+            centers.append(points[-1])
+
+    labels = [0] * len(points)
+    for _ in range(iterations):
+        new_labels = [min(range(k), key=lambda c: dist2(p, centers[c])) for p in points]
+        if new_labels == labels and _ > 0:
+            break
+        labels = new_labels
+        for c in range(k):
+            members = [p for p, l in zip(points, labels) if l == c]
+            if members:
+                centers[c] = [sum(x) / len(members) for x in zip(*members)]
+    return labels, centers
+
+
+def bic(points, labels, centers):
+    # Spherical Gaussian BIC as in x-means (Pelleg and Moore), as used by SimPoint
+    R = len(points)
+    K = len(centers)
+    M = len(points[0])
+    if R <= K:
+        return float('-inf')
+    variance = sum(dist2(p, centers[l]) for p, l in zip(points, labels)) / (R - K)
+    variance = max(variance, 1e-12)
+    loglik = 0.0
+    for c in range(K):
+        Rn = labels.count(c)
+        if Rn == 0:
+            continue
+        loglik += (Rn * math.log(Rn) - Rn * math.log(R)
+                   - Rn / 2 * math.log(2 * math.pi) - Rn * M / 2 * math.log(variance)
+                   - (Rn - K) / 2)
+    params = (K - 1) + M * K + 1
+    return loglik - params / 2 * math.log(R)
+
+
+vectors = read_bbv(args.bb)
+if not vectors:
+    sys.exit("No basic-block vectors found in {}. Was the emulator run with +bbv=<file>?".format(args.bb))
+cycles = read_cycles(args.cycles or args.bb + ".cycles")
+if len(cycles) != len(vectors):
+    sys.exit("{} intervals in the vector file but {} in the cycle file".format(len(vectors), len(cycles)))
+insts = [cycles[i][0] for i in range(len(vectors))]
+total_insts = sum(insts)
+
+points = project(vectors, args.dim)
+
+# Cluster for every k, keep the best of several seeds, and pick the smallest
+# k that scores close enough to the best BIC
+results = []
+for k in range(1, min(args.max_k, len(points)) + 1):
+    best = max((kmeans(points, k) for _ in range(args.seeds)), key=lambda r: bic(points, *r))
+    results.append((k, bic(points, *best), best))
+scores = [s for _, s, _ in results]
+lo, hi = min(scores), max(scores)
+k, _, (labels, centers) = next(r for r in results if hi == lo or (r[1] - lo) >= args.bic_threshold * (hi - lo))
+
+# One representative per cluster: the interval closest to the centre
+clusters = []
+for c in range(k):
+    members = [i for i, l in enumerate(labels) if l == c]
+    if not members:
+        continue
+    rep = min(members, key=lambda i: dist2(points[i], centers[c]))
+    weight = sum(insts[i] for i in members) / total_insts
+    clusters.append((c, rep, weight, len(members)))
+
+measured = read_cycles(args.measured) if args.measured else cycles
+for _, rep, _, _ in clusters:
+    if rep not in measured:
+        sys.exit("No measurement for representative interval {} in {}".format(rep, args.measured))
+
+estimated_cpi = sum(weight * measured[rep][1] / measured[rep][0] for _, rep, weight, _ in clusters)
+full_cpi = sum(c for _, c in cycles.values()) / total_insts
+sampled_insts = sum(measured[rep][0] for _, rep, _, _ in clusters)
+last_rep = max(rep for _, rep, _, _ in clusters)
+run_insts = sum(insts[:last_rep + 1])
+
+if args.simpoints:
+    with open(args.simpoints, 'w') as f:
+        for c, rep, _, _ in clusters:
+            f.write("{} {}\n".format(rep, c))
+if args.weights:
+    with open(args.weights, 'w') as f:
+        for c, _, weight, _ in clusters:
+            f.write("{:.6f} {}\n".format(weight, c))
+
+print("""
+Intervals    : {intervals} ({insts} instructions)
+Clusters     : {k}
+""".format(intervals=len(vectors), insts=total_insts, k=k))
+print("Cluster  Interval  Members  Weight    CPI")
+for c, rep, weight, members in clusters:
+    print("{:7d}  {:8d}  {:7d}  {:6.3f}  {:6.3f}".format(
+        c, rep, members, weight, measured[rep][1] / measured[rep][0]))
+print("""
+Estimated CPI : {est:.3f}
+Full-run CPI  : {full:.3f}
+Error         : {err:+.2f} %
+Measured      : {frac:.2f} % of instructions
+Simulated     : {run:.2f} % of instructions (sampled run, up to interval {last})
+""".format(est=estimated_cpi,
+           full=full_cpi,
+           err=100 * (estimated_cpi - full_cpi) / full_cpi,
+           frac=100 * sampled_insts / total_insts,
+           run=100 * run_insts / total_insts,
+           last=last_rep))
@@ -0,0 +1,246 @@
+#!/usr/bin/python3
+
+# Synthesis estimate of a core's cycle time and area, to weigh against its CPI.
+#
+# Synthesizes the core module out of the generated Verilog with Yosys, either
+# to generic gates or to a Liberty cell library, and reports
+#   depth  the longest combinational path between registers/ports, in gates
+#   area   in NAND2 gate equivalents (generic gates) or library units
+#   fmax   from the depth: 1 / (depth * gate delay + flop overhead)
+# The fmax is a first-order estimate for comparing cores and options against
+# each other. It leaves out wires and the scratchpad's access time.
+#
+#   ./synth.py emulator/rv32_5stage/generated-src --label rv32_5stage -o rv32_5stage.synth
+#   ./synth.py gen-collateral/ --top Core --liberty cells.lib
+#
+# scripts/time_report.py combines the .synth files with the CPI of benchmark runs.
+
+import argparse
+import os
+import re
+import shutil
+import subprocess
+import sys
+import tempfile
+
+parser = argparse.ArgumentParser(description="SODOR core synthesis estimate (Yosys)")
+parser.add_argument('verilog', nargs='+', help="generated Verilog files or directories")
+parser.add_argument('--top', default='Core', help="module to synthesize (default: Core)")
+parser.add_argument('--label', help="name of the core/configuration in the report (default: top)")
+parser.add_argument('--core', help="core the configuration belongs to, to find its runs (default: label)")
+parser.add_argument('--liberty', help="map to this Liberty library instead of generic gates")
+parser.add_argument('--gate-delay', type=float, default=50.0,
+                    help="delay of one gate on the critical path, in ps (default: 50)")
+parser.add_argument('--ff-overhead', type=float, default=150.0,
+                    help="clock-to-q plus setup time of the flops, in ps (default: 150)")
+parser.add_argument('--yosys', default='yosys', help="yosys binary")
+parser.add_argument('--log', help="keep the yosys log here")
+parser.add_argument('-o', '--output', help="write the results here, for time_report.py")
+
+args = parser.parse_args()
+label = args.label or args.top
+
+# Area of the generic gates in NAND2 equivalents
+GATE_AREA = {
+    'BUF': 1.0, 'NOT': 0.67,
+    'NAND': 1.0, 'NOR': 1.0, 'AND': 1.33, 'OR': 1.33, 'ANDNOT': 1.33, 'ORNOT': 1.33,
+    'XOR': 2.33, 'XNOR': 2.33, 'MUX': 2.33,
+    'DFF': 4.67,
+}
+
+# Modules that only exist for simulation (DPI, plusargs) are replaced with
+# empty black boxes of the same ports. Chisel's asserts, printfs and random
+# initialization sit in `ifndef SYNTHESIS regions, which Yosys skips, so these
+# do not count.
+SIM_ONLY = re.compile(r'import\s+"DPI-C"|\$value\$plusargs')
+MODULE = re.compile(r'^\s*module\s+(\w+)', re.M)
+DIRECTIVE = re.compile(r'^\s*`(ifdef|ifndef|elsif|else|endif)\b\s*(\w*)')
+
+
+def verilog_files(paths):
+    files = []
+    for path in paths:
+        if os.path.isdir(path):
+            for root, _, names in os.walk(path):
+                files += [os.path.join(root, n) for n in sorted(names) if n.endswith(('.v', '.sv'))]
+        else:
+            files.append(path)
+    return files
+
+
+def split_modules(files):
+    # module name -> (file, text of the module)
+    modules = {}
+    for f in files:
+        with open(f) as fd:
+            text = fd.read()
+        starts = [m.start() for m in MODULE.finditer(text)]
+        for i, start in enumerate(starts):
+            body = text[start:starts[i + 1] if i + 1 < len(starts) else len(text)]
+            name = MODULE.match(body).group(1)
+            modules.setdefault(name, (f, body))
+    return modules
+
+
+def used_modules(modules, top):
+    # Everything the top instantiates, transitively
+    words = {}
+    for name, (_, body) in modules.items():
+        words[name] = set(re.findall(r'\b([A-Za-z_]\w*)\s+(?:#\s*\(|[A-Za-z_]\w*\s*\()', body)) & modules.keys()
+    used, todo = set(), [top]
+    while todo:
+        name = todo.pop()
+        if name in used:
+            continue
+        used.add(name)
+        todo += words[name] - used
+    return used
+
+
+def synthesized(body):
+    # The text left with SYNTHESIS defined; other macros keep all branches
+    kept, stack = [], []  # per open `if: (tests SYNTHESIS, branch skipped)
+    for line in body.splitlines(True):
+        m = DIRECTIVE.match(line)
+        if m:
+            kind, name = m.groups()
+            if kind in ('ifdef', 'ifndef'):
+                stack.append((name == 'SYNTHESIS', name == 'SYNTHESIS' and kind == 'ifndef'))
+            elif kind == 'endif':
+                if stack:
+                    stack.pop()
+            elif stack and stack[-1][0]:
+                # `else or `elsif after `ifdef/`ifndef SYNTHESIS
+                stack[-1] = (True, not stack[-1][1] if kind == 'else' else True)
+            continue
+        if not any(skipped for _, skipped in stack):
+            kept.append(line)
+    return ''.join(kept)
+
+
+def sim_only(body):
+    return SIM_ONLY.search(synthesized(body)) is not None
+
+
+def stub(body):
+    # The ANSI header with its ports, without the body
+    header = body[:body.index(');') + 2]
+    return "(* blackbox *)\n" + header + "\nendmodule\n"
+
+
+files = verilog_files(args.verilog)
+modules = split_modules(files)
+if args.top not in modules:
+    sys.exit("Module {} not found in {}".format(args.top, ' '.join(args.verilog)))
+used = used_modules(modules, args.top)
+
+sources, stubs = set(), []
+for name in sorted(used):
+    f, body = modules[name]
+    if sim_only(body):
+        stubs.append(stub(body))
+    else:
+        sources.add(f)
+# Files holding a simulation-only module next to synthesizable ones are read
+# module by module
+mixed = {f for f in sources if any(modules[n][0] == f and sim_only(modules[n][1]) for n in used)}
+sources -= mixed
+
+workdir = tempfile.mkdtemp(prefix='sodor-synth-')
+extra = os.path.join(workdir, 'extra.sv')
+with open(extra, 'w') as fd:
+    fd.write(''.join(stubs))
+    for name in sorted(used):
+        f, body = modules[name]
+        if f in mixed and not sim_only(body):
+            fd.write(body + '\n')
+
+if args.liberty:
+    mapping = """
+dfflibmap -liberty {lib}
+abc -liberty {lib}
+opt_clean
+""".format(lib=args.liberty)
+    stat = "stat -liberty {}".format(args.liberty)
+else:
+    mapping = """
+abc -g AND,NAND,OR,NOR,XOR,XNOR,ANDNOT,ORNOT,MUX
+opt_clean
+"""
+    stat = "stat"
+
+script = """
+read_verilog -sv -DSYNTHESIS {sources} {extra}
+hierarchy -check -top {top}
+synth -flatten -top {top}
+{mapping}
+ltp -noff
+{stat}
+""".format(sources=' '.join(sorted(sources)), extra=extra, top=args.top, mapping=mapping, stat=stat)
+
+script_file = os.path.join(workdir, 'synth.ys')
+with open(script_file, 'w') as fd:
+    fd.write(script)
+
+log_file = args.log or os.path.join(workdir, 'yosys.log')
+print("Synthesizing {} ({} modules) ...".format(args.top, len(used)), file=sys.stderr)
+result = subprocess.run([args.yosys, '-q', '-l', log_file, '-s', script_file],
+                        stdout=subprocess.DEVNULL, stderr=subprocess.PIPE, universal_newlines=True)
+with open(log_file) as fd:
+    log = fd.read()
+shutil.rmtree(workdir, ignore_errors=True)
+if result.returncode != 0:
+    sys.exit("yosys failed:\n" + result.stderr + log[-2000:])
+
+depth = int(re.findall(r'Longest topological path in \S+ \(length=(\d+)\)', log)[-1])
+# Cell counts from stat, "<cell> <count>" or "<count> <cell>" depending on the yosys version
+cells = {}
+for line in log.split('Printing statistics.')[-1].splitlines():
+    tokens = line.split()
+    if len(tokens) != 2 or tokens[0].isdigit() == tokens[1].isdigit():
+        continue
+    count, cell = tokens if tokens[0].isdigit() else tokens[::-1]
+    if cell not in ('wires', 'wire', 'bits', 'cells', 'ports', 'memories', 'processes'):
+        cells[cell] = int(count)
+if args.liberty:
+    area = float(re.findall(r'Chip area for (?:top )?module .*: ([0-9.]+)', log)[-1])
+    area_unit = "library units"
+    flops = sum(n for c, n in cells.items() if 'DFF' in c.upper() or c.upper().startswith(('DF', 'SDF')))
+else:
+    area = 0.0
+    flops = 0
+    for cell, count in cells.items():
+        kind = re.sub(r'^\$_|_$', '', cell).split('_')[0]
+        kind = 'DFF' if 'DFF' in kind else kind
+        area += GATE_AREA.get(kind, 1.0) * count
+        flops += count if kind == 'DFF' else 0
+    area_unit = "GE"
+
+period_ps = depth * args.gate_delay + args.ff_overhead
+fmax = 1e6 / period_ps
+
+report = """label: {label}
+core: {core}
+top: {top}
+depth: {depth}
+flops: {flops}
+area: {area:.0f}
+area_unit: {area_unit}
+period_ps: {period:.0f}
+fmax_mhz: {fmax:.1f}
+""".format(label=label, core=args.core or label, top=args.top, depth=depth, flops=flops,
+           area=area, area_unit=area_unit, period=period_ps, fmax=fmax)
+
+if args.output:
+    with open(args.output, 'w') as fd:
+        fd.write(report)
+
+print("""
+{label}:
+Critical path : {depth} gates
+Flops         : {flops}
+Area          : {area:.0f} {area_unit}
+Cycle time    : {period:.0f} ps ({gate:.0f} ps/gate, {ff:.0f} ps flop overhead)
+fmax          : {fmax:.1f} MHz
+""".format(label=label, depth=depth, flops=flops, area=area, area_unit=area_unit,
+           period=period_ps, gate=args.gate_delay, ff=args.ff_overhead, fmax=fmax))
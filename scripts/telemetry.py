@@ -0,0 +1,130 @@
+#!/usr/bin/python3
+
+# Monitor for the live telemetry of running emulators (+telemetry=<file>,
+# WithSodorTelemetry; the file layout is described in SodorTelemetry.cc).
+#
+# Prints one line per hart of every telemetry file: cycles, instructions, IPC,
+# simulation speed, the pc of the last retired instruction and the share of
+# stalled and killed cycles, then the throughput summed over all running jobs.
+# A job whose emulator process is gone before it finished is reported as
+# dead, one that has not published for --stale seconds as stale, and one
+# whose hart retired nothing between two looks as hung.
+#
+#   ./telemetry.py runs/*.tm
+#   ./telemetry.py runs/*.tm --watch 10
+
+import argparse
+import glob
+import mmap
+import os
+import struct
+import sys
+import time
+
+parser = argparse.ArgumentParser(description="SODOR emulator telemetry monitor")
+parser.add_argument('files', nargs='+', help="telemetry files (+telemetry=<file>); globs are expanded")
+parser.add_argument('-w', '--watch', type=float, metavar='SECONDS',
+                    help="keep polling every SECONDS (and detect hung harts)")
+parser.add_argument('--stale', type=float, default=60,
+                    help="seconds without an update after which a running job is stale (default: 60)")
+
+args = parser.parse_args()
+
+HEADER = struct.Struct('=8sQQQQ24x')
+SLOT = struct.Struct('=QQQQQQQQdd48x')
+STATES = {1: 'running', 2: 'finished'}
+
+
+def read_slot(data, offset):
+    # The emulator bumps seq around every update; retry until it is even and stable
+    for _ in range(100):
+        seq = struct.unpack_from('=Q', data, offset)[0]
+        slot = SLOT.unpack_from(data, offset)
+        if seq % 2 == 0 and struct.unpack_from('=Q', data, offset)[0] == seq:
+            return slot
+    return None
+
+
+def read(path):
+    # Mapped rather than read, so that a retry sees the emulator's next write
+    try:
+        with open(path, 'rb') as f:
+            data = mmap.mmap(f.fileno(), 0, access=mmap.ACCESS_READ)
+    except (OSError, ValueError) as e:
+        print("%s: %s" % (path, e), file=sys.stderr)
+        return None
+    if len(data) < HEADER.size or data[:8] != b'SODORTM\0':
+        data.close()
+        return None
+    _, version, nslots, pid, start_ns = HEADER.unpack_from(data)
+    if version != 1:
+        print("%s: unknown telemetry version %d" % (path, version), file=sys.stderr)
+        data.close()
+        return None
+    harts = {}
+    for hart in range(nslots):
+        slot = read_slot(data, HEADER.size + hart * SLOT.size)
+        if slot and slot[1] != 0:
+            harts[hart] = slot
+    data.close()
+    return pid, start_ns, harts
+
+
+def alive(pid):
+    try:
+        os.kill(pid, 0)
+    except ProcessLookupError:
+        return False
+    except PermissionError:
+        pass
+    return True
+
+
+def ratio(num, den):
+    return num / den if den else 0.0
+
+
+def report(paths, last):
+    now = time.time_ns()
+    total_speed = 0.0
+    running = 0
+    seen = {}
+    print("%-32s %4s %-8s %14s %14s %6s %10s %10s %7s %7s" %
+          ("file", "hart", "state", "cycles", "instret", "ipc", "cycles/s", "pc", "stall%", "kill%"))
+    for path in paths:
+        run = read(path)
+        if run is None:
+            continue
+        pid, start_ns, harts = run
+        for hart, (seq, state, update_ns, cycles, instret, stall, kill, pc, speed, avg) in sorted(harts.items()):
+            status = STATES.get(state, '?')
+            if state == 1:
+                if not alive(pid):
+                    status = 'dead'
+                elif now - update_ns > args.stale * 1e9:
+                    status = 'stale'
+                elif (path, hart) in last and last[(path, hart)][0] != cycles and last[(path, hart)][1] == instret:
+                    status = 'hung'
+                if status in ('running', 'hung'):
+                    running += 1
+                    total_speed += speed
+            seen[(path, hart)] = (cycles, instret)
+            print("%-32s %4d %-8s %14d %14d %6.3f %10.0f %10x %6.1f%% %6.1f%%" %
+                  (path[-32:], hart, status, cycles, instret, ratio(instret, cycles), speed, pc,
+                   100 * ratio(stall, cycles), 100 * ratio(kill, cycles)))
+    print("%d running, %.0f cycles/s in total" % (running, total_speed))
+    return seen
+
+
+def expand(patterns):
+    paths = []
+    for pattern in patterns:
+        paths += sorted(glob.glob(pattern)) or [pattern]
+    return paths
+
+
+last = report(expand(args.files), {})
+while args.watch:
+    time.sleep(args.watch)
+    print()
+    last = report(expand(args.files), last)
@@ -0,0 +1,94 @@
+#!/usr/bin/python3
+
+# Time per benchmark from cycle time and CPI together.
+#
+# A pipeline option that lowers the CPI can lengthen the critical path by more
+# than it saves, so the cores are compared on execution time: the cycles of a
+# run times the cycle time estimated by synth.py.
+#
+#   ./time_report.py emulator/*/synth/*.synth
+#   ./time_report.py rv32_5stage.synth rv32_5stage-nobypass.synth --outputs 'runs/{label}/*.out'
+#
+# The benchmark runs are the emulator outputs with the CPI and cycle counts
+# reported by the run (see "make report-cpi"). {core} and {label} in --outputs
+# are replaced with the fields of each .synth file.
+
+import argparse
+import glob
+import os
+import re
+import sys
+
+parser = argparse.ArgumentParser(description="SODOR time-per-benchmark report")
+parser.add_argument('synth', nargs='+', help=".synth files written by synth.py")
+parser.add_argument('--outputs', default='emulator/{core}/output/*.out',
+                    help="benchmark outputs of each configuration (default: emulator/{core}/output/*.out)")
+
+args = parser.parse_args()
+
+
+def read_synth(path):
+    fields = {}
+    with open(path) as f:
+        for line in f:
+            if ':' in line:
+                key, value = line.split(':', 1)
+                fields[key.strip()] = value.strip()
+    return fields
+
+
+def read_run(path):
+    with open(path) as f:
+        text = f.read()
+    cpi = re.findall(r'CPI\s*:\s*([0-9.]+)', text)
+    cycles = re.findall(r'Cycles\s*:\s*(\d+)', text)
+    if not cpi:
+        return None
+    return float(cpi[-1]), int(cycles[-1]) if cycles else None
+
+
+configs = []
+for path in args.synth:
+    synth = read_synth(path)
+    pattern = args.outputs.format(core=synth['core'], label=synth['label'])
+    runs = {}
+    for out in sorted(glob.glob(pattern)):
+        run = read_run(out)
+        if run:
+            runs[os.path.basename(out)[:-len('.out')]] = run
+    if not runs:
+        print("warning: no benchmark outputs with CPI in {}".format(pattern), file=sys.stderr)
+    configs.append((synth, runs))
+
+print("Config                   Depth        Area     fmax  Avg CPI  ns/inst")
+for synth, runs in configs:
+    period_ns = float(synth['period_ps']) / 1000
+    if runs:
+        cpi = sum(c for c, _ in runs.values()) / len(runs)
+        cpi_str, time_str = "{:9.3f}".format(cpi), "{:9.3f}".format(cpi * period_ns)
+    else:
+        cpi_str = time_str = "{:>9}".format('-')
+    print("{:20s}  {:8d}  {:10.0f}  {:7.1f}{}{}".format(
+        synth['label'], int(synth['depth']), float(synth['area']), float(synth['fmax_mhz']),
+        cpi_str, time_str))
+print("(area in {})".format(', '.join(sorted({s['area_unit'] for s, _ in configs}))))
+
+benchmarks = sorted({b for _, runs in configs for b in runs})
+if not benchmarks:
+    sys.exit(0)
+
+# CPI and run time of every benchmark, one column per configuration
+print()
+print("{:24s}".format("Benchmark") + ''.join("{:>22s}".format(s['label']) for s, _ in configs))
+print("{:24s}".format("") + "{:>22s}".format("CPI        us") * len(configs))
+for bench in benchmarks:
+    row = "{:24s}".format(bench)
+    for synth, runs in configs:
+        if bench in runs and runs[bench][1] is not None:
+            cpi, cycles = runs[bench]
+            row += "{:>12.3f}{:>10.2f}".format(cpi, cycles * float(synth['period_ps']) / 1e6)
+        elif bench in runs:
+            row += "{:>12.3f}{:>10s}".format(runs[bench][0], '-')
+        else:
+            row += "{:>12s}{:>10s}".format('-', '-')
+    print(row)
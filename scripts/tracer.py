@@ -13,13 +13,16 @@ parser.add_argument('file', nargs='?', type=argparse.FileType('r'),
                     help="workload.out file")
 parser.add_argument('-u', '--ucode', action='store_true',
                     help='Process the tracefile from the UCode machine')
+parser.add_argument('-r', '--roi', action='store_true',
+                    help='The trace only covers the region of interest (5-stage built with WithSodorTriggers)')
 
 args = parser.parse_args()
 
 # Variables for collecting stats
 # We don't collect stats until the core has completed executing the bootrom,
 # so collecting_stats is initialized as False
-collecting_stats = False
+# With --roi, the core only printed the cycles it was measuring, so every line counts
+collecting_stats = args.roi
 start_cycle = 0
 
 n_instructions = 0       # Total instructions retired while collecting_stats == True
@@ -116,7 +119,7 @@ for line in args.file:
 
 
         # Start recording stats after we jump to the target binary at 0x8000_0000
-        if retire and pc == 0x80000000:
+        if retire and pc == 0x80000000 and not args.roi:
             collecting_stats = True
             start_cycle = cycle
 
@@ -143,7 +146,10 @@ for line in args.file:
             else:
                 n_bubbles += 1
 
-            n_cycles = cycle - start_cycle
+            if args.roi:
+                n_cycles += 1
+            else:
+                n_cycles = cycle - start_cycle
 
 
 if (n_instructions == 0):
@@ -0,0 +1,206 @@
+// See LICENSE for license details.
+
+// Batch mode: runs every program of a list in one emulator process (see
+// batch.scala). The list file names one ELF per line; blank lines and lines
+// starting with # are skipped. The first program is loaded and started by
+// the host as usual, so the emulator has to be given that same program on its
+// command line. Each later one is loaded here, straight into the sparse
+// scratchpad memory (SimSparseMem.cc), after the memory has been cleared.
+//
+// One JSON object per program is written to the +batch_out file as it
+// finishes, then one with the totals:
+//   {"program": "rv32ui-p-add", "status": "pass", "code": 0, "cycles": 1234}
+//   {"programs": 10, "passed": 9, "failed": 1, "cycles": 56789, "seconds": 1.5}
+// status is pass, fail (code is the program's exit code), syscall (the
+// program asked the host for something; code is the tohost value) or timeout.
+// cycles count from the program's first fetch at its entry point to its
+// write to tohost.
+
+#include <chrono>
+#include <cinttypes>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <elf.h>
+#include <fstream>
+#include <string>
+#include <vector>
+
+extern "C" void sparse_mem_write(int mem_id, long long addr, long long data, int size);
+extern "C" void sparse_mem_clear(int mem_id);
+
+namespace {
+
+// Where the riscv-tests and the benchmarks link tohost when the ELF has no
+// symbol table
+const uint64_t DEFAULT_TOHOST = 0x80001000;
+
+struct program_t {
+  std::string path;
+  uint64_t entry = 0;
+  uint64_t tohost = DEFAULT_TOHOST;
+};
+
+template <typename ehdr_t, typename phdr_t, typename shdr_t, typename sym_t>
+void parse_elf(const std::vector<char>& buf, program_t& prog, bool load, int mem_id)
+{
+  ehdr_t eh;
+  memcpy(&eh, buf.data(), sizeof(eh));
+  prog.entry = eh.e_entry;
+
+  for (int i = 0; load && i < eh.e_phnum; i++) {
+    phdr_t ph;
+    memcpy(&ph, buf.data() + eh.e_phoff + i * eh.e_phentsize, sizeof(ph));
+    if (ph.p_type != PT_LOAD)
+      continue;
+    // Only the file contents: the memory was cleared, so .bss is zero already
+    for (uint64_t j = 0; j < ph.p_filesz; j++)
+      sparse_mem_write(mem_id, ph.p_paddr + j, (uint8_t)buf[ph.p_offset + j], 0);
+  }
+
+  for (int i = 0; i < eh.e_shnum; i++) {
+    shdr_t sh;
+    memcpy(&sh, buf.data() + eh.e_shoff + i * eh.e_shentsize, sizeof(sh));
+    if (sh.sh_type != SHT_SYMTAB)
+      continue;
+    shdr_t strtab;
+    memcpy(&strtab, buf.data() + eh.e_shoff + sh.sh_link * eh.e_shentsize, sizeof(strtab));
+    for (uint64_t off = 0; off + sizeof(sym_t) <= sh.sh_size; off += sizeof(sym_t)) {
+      sym_t sym;
+      memcpy(&sym, buf.data() + sh.sh_offset + off, sizeof(sym));
+      if (!strcmp(buf.data() + strtab.sh_offset + sym.st_name, "tohost"))
+        prog.tohost = sym.st_value;
+    }
+  }
+}
+
+// Reads the entry point and tohost of the program and, if load is set,
+// copies its segments into the scratchpad of the given memory id
+void read_elf(program_t& prog, bool load, int mem_id = 0)
+{
+  std::ifstream f(prog.path, std::ios::binary);
+  std::vector<char> buf((std::istreambuf_iterator<char>(f)), std::istreambuf_iterator<char>());
+  if (buf.size() < sizeof(Elf64_Ehdr) || memcmp(buf.data(), ELFMAG, SELFMAG)) {
+    fprintf(stderr, "batch: %s is not an ELF file\n", prog.path.c_str());
+    exit(1);
+  }
+  if (buf[EI_CLASS] == ELFCLASS32)
+    parse_elf<Elf32_Ehdr, Elf32_Phdr, Elf32_Shdr, Elf32_Sym>(buf, prog, load, mem_id);
+  else
+    parse_elf<Elf64_Ehdr, Elf64_Phdr, Elf64_Shdr, Elf64_Sym>(buf, prog, load, mem_id);
+}
+
+// Names may contain anything but are written between quotes
+std::string quote(const std::string& s)
+{
+  std::string q = "\"";
+  for (char c : s) {
+    if (c == '"' || c == '\\')
+      q += '\\';
+    if ((unsigned char)c < 0x20)
+      continue;
+    q += c;
+  }
+  return q + "\"";
+}
+
+class batch_t
+{
+ public:
+  batch_t(const char* list, const char* out)
+    : start(std::chrono::steady_clock::now())
+  {
+    std::ifstream f(list);
+    if (!f) {
+      fprintf(stderr, "batch: cannot open %s\n", list);
+      exit(1);
+    }
+    for (std::string line; std::getline(f, line); ) {
+      line.erase(0, line.find_first_not_of(" \t"));
+      line.erase(line.find_last_not_of(" \t\r") + 1);
+      if (!line.empty() && line[0] != '#')
+        programs.push_back(program_t{line});
+    }
+
+    results = *out ? fopen(out, "w") : stderr;
+    if (!results) {
+      fprintf(stderr, "batch: cannot create %s\n", out);
+      exit(1);
+    }
+    if (!programs.empty())
+      read_elf(programs[0], false); // the host loads the first one
+  }
+
+  bool empty() const { return programs.empty(); }
+  const program_t& current() const { return programs[index]; }
+  bool last() const { return index + 1 == programs.size(); }
+
+  void exit_program(uint64_t data, uint64_t cycles)
+  {
+    const char* status = data == 1 ? "pass" : data == 0 ? "timeout" : data & 1 ? "fail" : "syscall";
+    uint64_t code = data & 1 ? data >> 1 : data;
+    fprintf(results, "{\"program\": %s, \"status\": \"%s\", \"code\": %" PRIu64 ", \"cycles\": %" PRIu64 "}\n",
+            quote(current().path).c_str(), status, code, cycles);
+    fflush(results);
+    passed += data == 1;
+    total_cycles += cycles;
+
+    if (last()) {
+      double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+      fprintf(results, "{\"programs\": %zu, \"passed\": %zu, \"failed\": %zu, \"cycles\": %" PRIu64 ", \"seconds\": %.3f}\n",
+              programs.size(), passed, programs.size() - passed, total_cycles, seconds);
+      fflush(results);
+    }
+  }
+
+  // mem_id is the running hart's scratchpad (SimMemoryModule's memId)
+  void load_next(int mem_id)
+  {
+    index++;
+    sparse_mem_clear(mem_id);
+    read_elf(programs[index], true, mem_id);
+  }
+
+ private:
+  std::vector<program_t> programs;
+  size_t index = 0;
+  size_t passed = 0;
+  uint64_t total_cycles = 0;
+  FILE* results;
+  std::chrono::steady_clock::time_point start;
+};
+
+batch_t* batch = nullptr;
+
+}
+
+// Returns 0 if the list is empty: the emulator then runs its program as usual
+extern "C" int batch_init(const char* list, const char* out, long long* entry, long long* tohost, int* last)
+{
+  if (batch) {
+    fprintf(stderr, "batch: only one hart can run a batch\n");
+    exit(1);
+  }
+  batch = new batch_t(list, out);
+  if (batch->empty())
+    return 0;
+  *entry = batch->current().entry;
+  *tohost = batch->current().tohost;
+  *last = batch->last();
+  return 1;
+}
+
+// exit_data is the value written to tohost, or 0 if the program timed out
+extern "C" void batch_exit(long long exit_data, long long cycles)
+{
+  batch->exit_program(exit_data, cycles);
+}
+
+extern "C" void batch_load(int mem_id, long long* entry, long long* tohost, int* last)
+{
+  batch->load_next(mem_id);
+  *entry = batch->current().entry;
+  *tohost = batch->current().tohost;
+  *last = batch->last();
+}
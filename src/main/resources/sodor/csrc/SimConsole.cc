@@ -0,0 +1,14 @@
+// See LICENSE for license details.
+
+// DPI sink of the Sodor MMIO console. Each character goes into stdio's
+// buffer, which is only flushed at the end of a line, so that a printf-heavy
+// program does not turn into one write(2) per character.
+
+#include <cstdio>
+
+extern "C" void sim_console_putchar(char ch)
+{
+  fputc(ch, stdout);
+  if (ch == '\n')
+    fflush(stdout);
+}
@@ -0,0 +1,113 @@
+// See LICENSE for license details.
+
+// Sparse, page-allocated backing store for the Sodor scratchpad when it is
+// built with useSimMemory. Pages are allocated on the first non-zero write;
+// reads of untouched memory return zero without allocating anything, so the
+// emulator only pays for the memory a program actually uses.
+
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+
+namespace {
+
+const int PAGE_SHIFT = 12;
+const uint64_t PAGE_SIZE = 1ULL << PAGE_SHIFT;
+const uint64_t PAGE_MASK = PAGE_SIZE - 1;
+
+class sparse_mem_t
+{
+ public:
+  uint8_t read_byte(uint64_t addr)
+  {
+    uint8_t* page = lookup(addr >> PAGE_SHIFT, false);
+    return page ? page[addr & PAGE_MASK] : 0;
+  }
+
+  void write_byte(uint64_t addr, uint8_t data)
+  {
+    uint8_t* page = lookup(addr >> PAGE_SHIFT, data != 0);
+    if (page)
+      page[addr & PAGE_MASK] = data;
+  }
+
+  void clear()
+  {
+    pages.clear();
+    last_page = nullptr;
+    epoch++;
+  }
+
+  // Bumped whenever the memory is changed from outside the design (see
+  // SimSparseMem.v)
+  uint32_t epoch = 0;
+
+ private:
+  uint8_t* lookup(uint64_t ppn, bool alloc)
+  {
+    // Instruction fetch and most loads/stores hit the same page as the
+    // previous access, so keep a one-entry cache in front of the hash map.
+    if (last_page && ppn == last_ppn)
+      return last_page;
+
+    auto it = pages.find(ppn);
+    if (it == pages.end()) {
+      if (!alloc)
+        return nullptr;
+      it = pages.emplace(ppn, std::unique_ptr<uint8_t[]>(new uint8_t[PAGE_SIZE]())).first;
+    }
+
+    last_ppn = ppn;
+    last_page = it->second.get();
+    return last_page;
+  }
+
+  std::unordered_map<uint64_t, std::unique_ptr<uint8_t[]>> pages;
+  uint64_t last_ppn = 0;
+  uint8_t* last_page = nullptr;
+};
+
+sparse_mem_t& get_mem(int mem_id)
+{
+  static std::unordered_map<int, sparse_mem_t> mems;
+  return mems[mem_id];
+}
+
+}
+
+// Accesses are up to 8 bytes; signed reads are sign-extended to 64 bits and
+// the port keeps the low word of its width
+extern "C" long long sparse_mem_read(int mem_id, long long addr, int size, int is_signed, int epoch)
+{
+  sparse_mem_t& mem = get_mem(mem_id);
+  int bytes = 1 << size;
+  uint64_t data = 0;
+  for (int i = 0; i < bytes; i++)
+    data |= (uint64_t)mem.read_byte(addr + i) << (8 * i);
+
+  if (is_signed && bytes < 8) {
+    int shift = 64 - 8 * bytes;
+    return (int64_t)(data << shift) >> shift;
+  }
+  return data;
+}
+
+extern "C" void sparse_mem_write(int mem_id, long long addr, long long data, int size)
+{
+  sparse_mem_t& mem = get_mem(mem_id);
+  int bytes = 1 << size;
+  for (int i = 0; i < bytes; i++)
+    mem.write_byte(addr + i, (uint64_t)data >> (8 * i));
+}
+
+// Drops every page, so that the whole memory reads as zero again (used by the
+// batch runner between programs, see SimBatch.cc)
+extern "C" void sparse_mem_clear(int mem_id)
+{
+  get_mem(mem_id).clear();
+}
+
+extern "C" int sparse_mem_epoch(int mem_id)
+{
+  return get_mem(mem_id).epoch;
+}
@@ -0,0 +1,142 @@
+// See LICENSE for license details.
+
+// Basic-block vector profiling for sampled simulation. SodorBBV.v follows the
+// retire valid/pc of the core, splits the run into intervals of a fixed
+// number of retired instructions and reports each basic block (by its entry
+// pc) as it ends and each interval as it ends. Per interval, this writes:
+//   <file>         one SimPoint "T:<block>:<count> ..." line, counting the
+//                  instructions retired in each basic block
+//   <file>.cycles  "<interval> <instructions> <cycles>"
+// scripts/simpoint.py clusters the vectors and estimates CPI from them. Hart 0
+// writes to <file> itself; any other hart n to <file>.<n> and
+// <file>.<n>.cycles, so that each hart has its own profile.
+//
+// In a sampled run (+bbv_sample=<simpts>, the representatives chosen by
+// simpoint.py --simpoints) no vectors are written: <file> only gets the
+// "<interval> <instructions> <cycles>" lines of the listed intervals, which is
+// what simpoint.py --measured reads, and the emulator stops once every
+// sampling hart is past its last listed interval.
+
+#include <cinttypes>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace {
+
+class bbv_t
+{
+ public:
+  bbv_t(const std::string& path, const char* sample)
+    : sampled(*sample)
+  {
+    if (sampled) {
+      std::ifstream f(sample);
+      if (!f) {
+        fprintf(stderr, "bbv: cannot open %s\n", sample);
+        abort();
+      }
+      // SimPoint .simpts: "<interval> <cluster>" per line
+      for (uint64_t interval, cluster; f >> interval >> cluster; )
+        samples.insert(interval);
+      bb = nullptr;
+      cyc = fopen(path.c_str(), "w");
+    }
+    else {
+      bb = fopen(path.c_str(), "w");
+      cyc = fopen((path + ".cycles").c_str(), "w");
+    }
+    if ((!sampled && !bb) || !cyc) {
+      fprintf(stderr, "bbv: cannot open %s for writing\n", path.c_str());
+      abort();
+    }
+    fprintf(cyc, "# interval instructions cycles\n");
+  }
+
+  ~bbv_t()
+  {
+    if (bb)
+      fclose(bb);
+    fclose(cyc);
+  }
+
+  void block(uint32_t pc, uint64_t count)
+  {
+    counts[pc] += count;
+  }
+
+  void interval(uint64_t insts, uint64_t cycles)
+  {
+    if (!sampled) {
+      fprintf(bb, "T");
+      for (auto& c : counts) {
+        auto id = ids.emplace(c.first, ids.size() + 1).first->second;
+        fprintf(bb, ":%zu:%" PRIu64 " ", id, c.second);
+      }
+      fprintf(bb, "\n");
+      counts.clear();
+    }
+    if (!sampled || samples.count(n_intervals))
+      fprintf(cyc, "%" PRIu64 " %" PRIu64 " %" PRIu64 "\n", n_intervals, insts, cycles);
+    n_intervals++;
+  }
+
+  // Past the last interval a sampled run has to measure
+  bool done() const
+  {
+    return sampled && (samples.empty() || n_intervals > *samples.rbegin());
+  }
+
+  const bool sampled;
+
+ private:
+  FILE* bb;
+  FILE* cyc;
+  std::set<uint64_t> samples;
+  std::unordered_map<uint32_t, uint64_t> counts;
+  std::unordered_map<uint32_t, size_t> ids;
+  uint64_t n_intervals = 0;
+};
+
+std::vector<bbv_t*> profilers;
+
+}
+
+extern "C" int bbv_init(const char* path, int hartid, const char* sample)
+{
+  std::string name = hartid == 0 ? path : std::string(path) + "." + std::to_string(hartid);
+  profilers.push_back(new bbv_t(name, sample));
+  return profilers.size() - 1;
+}
+
+extern "C" void bbv_block(int id, int pc, long long count)
+{
+  profilers[id]->block(pc, count);
+}
+
+// Returns 1 when the emulator can stop: this was a sampled run and every
+// sampling hart has measured all of its intervals
+extern "C" int bbv_interval(int id, long long insts, long long cycles)
+{
+  profilers[id]->interval(insts, cycles);
+  if (!profilers[id]->sampled)
+    return 0;
+  for (auto p : profilers)
+    if (p && p->sampled && !p->done())
+      return 0;
+  return 1;
+}
+
+// The last, partial interval
+extern "C" void bbv_finish(int id, long long insts, long long cycles)
+{
+  if (insts)
+    profilers[id]->interval(insts, cycles);
+  delete profilers[id];
+  profilers[id] = nullptr;
+}
@@ -0,0 +1,488 @@
+// See LICENSE for license details.
+
+// Lockstep co-simulation of the Sodor cores against a small RV32I reference
+// model. The emulator is started with +cosim=<elf> (the same program that is
+// loaded into the target); the reference loads the ELF itself and, for every
+// instruction the core retires, executes the same instruction and compares
+// pc, instruction bits and the register write-back. The run stops at the
+// first divergence.
+//
+// What the reference does not model it takes from the core instead of
+// checking it:
+//   - code outside the ELF image (e.g. the boot ROM): register writes are
+//     copied over and checking resumes at the next retire inside the image,
+//   - CSR reads, and loads from devices, tohost/fromhost or memory that has
+//     not been written yet. Memory is any 256 MiB region the image was
+//     loaded into; everything else is treated as a device,
+//   - interrupt and exception targets. Exceptions are still checked to
+//     happen on an instruction the reference considers trapping.
+// Memory written behind the core's back (DMA, debug module) is not tracked.
+
+#include <cinttypes>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace {
+
+// Just enough of the ELF32 format to load a statically linked program
+struct elf32_ehdr_t {
+  uint8_t  e_ident[16];
+  uint16_t e_type, e_machine;
+  uint32_t e_version, e_entry, e_phoff, e_shoff, e_flags;
+  uint16_t e_ehsize, e_phentsize, e_phnum, e_shentsize, e_shnum, e_shstrndx;
+};
+
+struct elf32_phdr_t {
+  uint32_t p_type, p_offset, p_vaddr, p_paddr, p_filesz, p_memsz, p_flags, p_align;
+};
+
+struct elf32_shdr_t {
+  uint32_t sh_name, sh_type, sh_flags, sh_addr, sh_offset, sh_size, sh_link, sh_info, sh_addralign, sh_entsize;
+};
+
+struct elf32_sym_t {
+  uint32_t st_name, st_value, st_size;
+  uint8_t  st_info, st_other;
+  uint16_t st_shndx;
+};
+
+const uint32_t PT_LOAD = 1;
+const uint32_t SHT_SYMTAB = 2;
+
+const int PAGE_SHIFT = 12;
+const uint32_t PAGE_SIZE = 1u << PAGE_SHIFT;
+const uint32_t PAGE_MASK = PAGE_SIZE - 1;
+
+// Stores are tracked in any 256 MiB region that holds part of the image
+const int REGION_SHIFT = 28;
+
+const int HISTORY = 16;
+
+const uint32_t CSR_MTVEC = 0x305;
+const uint32_t CSR_MEPC  = 0x341;
+
+struct commit_t {
+  uint32_t pc, inst;
+  bool wen;
+  uint32_t rd, wdata;
+};
+
+// Architectural effect of one instruction, computed before it is applied
+struct effect_t {
+  bool trap = false;       // illegal, misaligned, ecall or ebreak
+  bool ecall = false;      // ecall/ebreak: retired, then vectors to mtvec
+  bool mret = false;
+  uint32_t next_pc = 0;
+  uint32_t rd = 0;         // 0: no register write
+  uint32_t wdata = 0;
+  bool adopt = false;      // take wdata from the core (CSR read, device load)
+  bool store = false;
+  uint32_t addr = 0, data = 0, bytes = 0;
+  int csr = -1;            // CSR written from csr_src, if modelled
+  int csr_op = 0;          // 1: write, 2: set, 3: clear
+  uint32_t csr_src = 0;
+};
+
+class rv32i_ref_t
+{
+ public:
+  explicit rv32i_ref_t(int hartid) : hartid(hartid) {}
+
+  bool load_elf(const std::string& path)
+  {
+    std::ifstream f(path, std::ios::binary);
+    std::vector<char> buf((std::istreambuf_iterator<char>(f)), std::istreambuf_iterator<char>());
+    if (buf.size() < sizeof(elf32_ehdr_t) || memcmp(buf.data(), "\177ELF", 4) || buf[4] != 1) {
+      fprintf(stderr, "cosim: %s is not an ELF32 file\n", path.c_str());
+      return false;
+    }
+    elf32_ehdr_t eh;
+    memcpy(&eh, buf.data(), sizeof(eh));
+
+    for (int i = 0; i < eh.e_phnum; i++) {
+      elf32_phdr_t ph;
+      memcpy(&ph, buf.data() + eh.e_phoff + i * eh.e_phentsize, sizeof(ph));
+      if (ph.p_type != PT_LOAD || ph.p_memsz == 0)
+        continue;
+      regions.insert(ph.p_paddr >> REGION_SHIFT);
+      for (uint32_t j = 0; j < ph.p_memsz; j++)
+        *byte(ph.p_paddr + j, true) = j < ph.p_filesz ? buf[ph.p_offset + j] : 0;
+    }
+
+    // tohost/fromhost are written by the host, so loads from them are not checked
+    for (int i = 0; i < eh.e_shnum; i++) {
+      elf32_shdr_t sh;
+      memcpy(&sh, buf.data() + eh.e_shoff + i * eh.e_shentsize, sizeof(sh));
+      if (sh.sh_type != SHT_SYMTAB)
+        continue;
+      elf32_shdr_t strtab;
+      memcpy(&strtab, buf.data() + eh.e_shoff + sh.sh_link * eh.e_shentsize, sizeof(strtab));
+      for (uint32_t off = 0; off + sizeof(elf32_sym_t) <= sh.sh_size; off += sizeof(elf32_sym_t)) {
+        elf32_sym_t sym;
+        memcpy(&sym, buf.data() + sh.sh_offset + off, sizeof(sym));
+        const char* name = buf.data() + strtab.sh_offset + sym.st_name;
+        if (!strcmp(name, "tohost") || !strcmp(name, "fromhost"))
+          devices.emplace_back(sym.st_value, sym.st_value + 8);
+      }
+    }
+    return true;
+  }
+
+  // Returns false on a divergence
+  bool commit(const commit_t& c)
+  {
+    push_history(c);
+
+    // Unmodelled code: follow the core until it jumps into the image
+    if (!byte(c.pc, false)) {
+      if (c.wen && c.rd)
+        x[c.rd] = c.wdata;
+      synced = false;
+      adopted++;
+      return true;
+    }
+    if (!synced) {
+      pc = c.pc;
+      synced = true;
+    }
+
+    if (c.pc != pc)
+      return mismatch(c, "pc", pc, c.pc);
+    uint32_t inst = load(pc, 4);
+    if (c.inst != inst)
+      return mismatch(c, "instruction", inst, c.inst);
+
+    effect_t e = execute(inst);
+    if (e.trap && !e.ecall)
+      return mismatch(c, "core retired an instruction that should trap", 0, 0);
+
+    uint32_t dut_rd = c.wen ? c.rd : 0;
+    if (e.adopt && e.rd)
+      e.wdata = c.wdata;
+    if (e.rd != dut_rd)
+      return mismatch(c, "destination register", e.rd, dut_rd);
+    if (e.rd && e.wdata != c.wdata)
+      return mismatch(c, "write-back data", e.wdata, c.wdata);
+
+    apply(e);
+    checked++;
+    return true;
+  }
+
+  // An exception or interrupt redirected the core to target without
+  // retiring the instruction at pc
+  bool trap(bool interrupt, uint32_t target)
+  {
+    if (!synced)
+      return true;
+    if (!interrupt && (pc & 3) == 0 && byte(pc, false) && !execute(load(pc, 4)).trap) {
+      commit_t c = { pc, load(pc, 4), false, 0, 0 };
+      return mismatch(c, "core took an exception the reference does not", 0, 0);
+    }
+    mepc = pc;
+    pc = target;
+    return true;
+  }
+
+  void finish()
+  {
+    fprintf(stderr, "cosim: hart %d checked %" PRIu64 " instructions (%" PRIu64 " outside the image)\n",
+            hartid, checked, adopted);
+  }
+
+ private:
+  uint8_t* byte(uint32_t addr, bool alloc)
+  {
+    auto it = pages.find(addr >> PAGE_SHIFT);
+    if (it == pages.end()) {
+      if (!alloc)
+        return nullptr;
+      it = pages.emplace(addr >> PAGE_SHIFT, std::unique_ptr<uint8_t[]>(new uint8_t[PAGE_SIZE]())).first;
+    }
+    return &it->second[addr & PAGE_MASK];
+  }
+
+  // Anything outside the regions the image was loaded into is a device
+  bool is_device(uint32_t addr, uint32_t bytes)
+  {
+    for (auto& d : devices)
+      if (addr < d.second && addr + bytes > d.first)
+        return true;
+    return !regions.count(addr >> REGION_SHIFT);
+  }
+
+  // Loads from memory nobody has written yet are not checked either
+  bool is_unknown(uint32_t addr, uint32_t bytes)
+  {
+    if (is_device(addr, bytes))
+      return true;
+    for (uint32_t i = 0; i < bytes; i++)
+      if (!byte(addr + i, false))
+        return true;
+    return false;
+  }
+
+  uint32_t load(uint32_t addr, uint32_t bytes)
+  {
+    uint32_t data = 0;
+    for (uint32_t i = 0; i < bytes; i++) {
+      uint8_t* b = byte(addr + i, false);
+      data |= (uint32_t)(b ? *b : 0) << (8 * i);
+    }
+    return data;
+  }
+
+  effect_t execute(uint32_t inst)
+  {
+    effect_t e;
+    e.next_pc = pc + 4;
+
+    uint32_t opcode = inst & 0x7f;
+    uint32_t rd = (inst >> 7) & 0x1f;
+    uint32_t funct3 = (inst >> 12) & 0x7;
+    uint32_t rs1 = x[(inst >> 15) & 0x1f];
+    uint32_t rs2 = x[(inst >> 20) & 0x1f];
+    uint32_t funct7 = inst >> 25;
+    int32_t imm_i = (int32_t)inst >> 20;
+    int32_t imm_s = ((int32_t)inst >> 25 << 5) | ((inst >> 7) & 0x1f);
+    int32_t imm_b = ((int32_t)inst >> 31 << 12) | ((inst & 0x80) << 4) | (((inst >> 25) & 0x3f) << 5) | (((inst >> 8) & 0xf) << 1);
+    int32_t imm_j = ((int32_t)inst >> 31 << 20) | (inst & 0xff000) | (((inst >> 20) & 1) << 11) | (((inst >> 21) & 0x3ff) << 1);
+    uint32_t imm_u = inst & 0xfffff000;
+
+    auto write = [&](uint32_t value) { e.rd = rd; e.wdata = value; };
+    auto jump = [&](uint32_t target) {
+      if (target & 3)
+        e.trap = true;
+      e.next_pc = target;
+    };
+
+    switch (opcode) {
+      case 0x37: write(imm_u); break;                                   // lui
+      case 0x17: write(pc + imm_u); break;                              // auipc
+      case 0x6f: write(pc + 4); jump(pc + imm_j); break;                // jal
+      case 0x67:                                                        // jalr
+        if (funct3) { e.trap = true; break; }
+        write(pc + 4); jump((rs1 + imm_i) & ~1u);
+        break;
+      case 0x63: {                                                      // branches
+        bool taken;
+        switch (funct3) {
+          case 0: taken = rs1 == rs2; break;
+          case 1: taken = rs1 != rs2; break;
+          case 4: taken = (int32_t)rs1 < (int32_t)rs2; break;
+          case 5: taken = (int32_t)rs1 >= (int32_t)rs2; break;
+          case 6: taken = rs1 < rs2; break;
+          case 7: taken = rs1 >= rs2; break;
+          default: e.trap = true; return e;
+        }
+        if (taken)
+          jump(pc + imm_b);
+        break;
+      }
+      case 0x03: {                                                      // loads
+        uint32_t bytes = 1u << (funct3 & 3);
+        uint32_t addr = rs1 + imm_i;
+        if (funct3 == 3 || funct3 > 5 || (addr & (bytes - 1))) { e.trap = true; break; }
+        uint32_t data = load(addr, bytes);
+        if (!(funct3 & 4) && bytes < 4)
+          data = (int32_t)(data << (32 - 8 * bytes)) >> (32 - 8 * bytes);
+        write(data);
+        e.adopt = is_unknown(addr, bytes);
+        break;
+      }
+      case 0x23: {                                                      // stores
+        uint32_t bytes = 1u << funct3;
+        uint32_t addr = rs1 + imm_s;
+        if (funct3 > 2 || (addr & (bytes - 1))) { e.trap = true; break; }
+        e.store = true; e.addr = addr; e.data = rs2; e.bytes = bytes;
+        break;
+      }
+      case 0x13: {                                                      // op-imm
+        uint32_t shamt = imm_i & 0x1f;
+        switch (funct3) {
+          case 0: write(rs1 + imm_i); break;
+          case 1: if (funct7) e.trap = true; else write(rs1 << shamt); break;
+          case 2: write((int32_t)rs1 < imm_i); break;
+          case 3: write(rs1 < (uint32_t)imm_i); break;
+          case 4: write(rs1 ^ imm_i); break;
+          case 5:
+            if (funct7 == 0x00) write(rs1 >> shamt);
+            else if (funct7 == 0x20) write((int32_t)rs1 >> shamt);
+            else e.trap = true;
+            break;
+          case 6: write(rs1 | imm_i); break;
+          case 7: write(rs1 & imm_i); break;
+        }
+        break;
+      }
+      case 0x33:                                                        // op
+        if (funct7 == 0x07 && (funct3 == 5 || funct3 == 7)) {           // czero.eqz, czero.nez
+          write((rs2 == 0) == (funct3 == 5) ? 0 : rs1);
+          break;
+        }
+        if (funct7 != 0x00 && !(funct7 == 0x20 && (funct3 == 0 || funct3 == 5))) { e.trap = true; break; }
+        switch (funct3) {
+          case 0: write(funct7 ? rs1 - rs2 : rs1 + rs2); break;
+          case 1: write(rs1 << (rs2 & 0x1f)); break;
+          case 2: write((int32_t)rs1 < (int32_t)rs2); break;
+          case 3: write(rs1 < rs2); break;
+          case 4: write(rs1 ^ rs2); break;
+          case 5: write(funct7 ? (uint32_t)((int32_t)rs1 >> (rs2 & 0x1f)) : rs1 >> (rs2 & 0x1f)); break;
+          case 6: write(rs1 | rs2); break;
+          case 7: write(rs1 & rs2); break;
+        }
+        break;
+      case 0x0f:                                                        // fence, fence.i
+        if (funct3 > 1) e.trap = true;
+        break;
+      case 0x73:                                                        // system
+        if (funct3 == 0) {
+          if (inst == 0x00000073 || inst == 0x00100073) {              // ecall, ebreak
+            e.trap = e.ecall = true;
+            e.next_pc = mtvec & ~3u;
+          } else if (inst == 0x30200073) {                              // mret
+            e.mret = true;
+            e.next_pc = mepc;
+          } else if (inst != 0x10500073 && inst != 0x7b200073) {        // wfi, dret
+            e.trap = true;
+          }
+        } else if (funct3 != 4) {                                       // csrr[wsc][i]
+          uint32_t csr = inst >> 20;
+          write(0);
+          e.adopt = true;
+          if (csr == CSR_MTVEC || csr == CSR_MEPC) {
+            e.csr = csr;
+            e.csr_op = funct3 & 3;
+            e.csr_src = (funct3 & 4) ? (inst >> 15) & 0x1f : rs1;
+          }
+        } else {
+          e.trap = true;
+        }
+        break;
+      default:
+        e.trap = true;
+    }
+    if (e.rd == 0)
+      e.wdata = 0;
+    return e;
+  }
+
+  void apply(const effect_t& e)
+  {
+    if (e.rd)
+      x[e.rd] = e.wdata;
+    if (e.store && !is_device(e.addr, e.bytes))
+      for (uint32_t i = 0; i < e.bytes; i++)
+        *byte(e.addr + i, true) = e.data >> (8 * i);
+    if (e.csr >= 0) {
+      uint32_t& r = e.csr == CSR_MTVEC ? mtvec : mepc;
+      // csrrs/csrrc with a zero source do not write
+      if (e.csr_op == 1) r = e.csr_src;
+      else if (e.csr_op == 2) r |= e.csr_src;
+      else r &= ~e.csr_src;
+      mepc &= ~3u;
+    }
+    if (e.ecall)
+      mepc = pc;
+    pc = e.next_pc;
+  }
+
+  void push_history(const commit_t& c)
+  {
+    history[history_head] = c;
+    history_head = (history_head + 1) % HISTORY;
+    history_size = std::min(history_size + 1, HISTORY);
+  }
+
+  bool mismatch(const commit_t& c, const char* what, uint32_t ref, uint32_t dut)
+  {
+    fprintf(stderr, "\n*** cosim: hart %d diverged after %" PRIu64 " instructions: %s\n", hartid, checked, what);
+    fprintf(stderr, "    reference 0x%08x  core 0x%08x\n", ref, dut);
+    fprintf(stderr, "    core retired pc=0x%08x inst=0x%08x DASM(%08x)", c.pc, c.inst, c.inst);
+    if (c.wen && c.rd)
+      fprintf(stderr, " x%d=0x%08x", c.rd, c.wdata);
+    fprintf(stderr, "\n    reference pc=0x%08x inst=0x%08x DASM(%08x)\n", pc, load(pc, 4), load(pc, 4));
+
+    fprintf(stderr, "last %d retired by the core (oldest first):\n", history_size);
+    for (int i = 0; i < history_size; i++) {
+      const commit_t& h = history[(history_head - history_size + i + HISTORY) % HISTORY];
+      fprintf(stderr, "    0x%08x (0x%08x) DASM(%08x)", h.pc, h.inst, h.inst);
+      if (h.wen && h.rd)
+        fprintf(stderr, " x%d 0x%08x", h.rd, h.wdata);
+      fprintf(stderr, "\n");
+    }
+
+    fprintf(stderr, "reference registers:\n");
+    for (int i = 0; i < 32; i++)
+      fprintf(stderr, "    x%-2d 0x%08x%s", i, x[i], i % 4 == 3 ? "\n" : "");
+    fprintf(stderr, "    mepc 0x%08x mtvec 0x%08x\n", mepc, mtvec);
+    return false;
+  }
+
+  int hartid;
+  uint32_t pc = 0;
+  uint32_t x[32] = {};
+  uint32_t mepc = 0, mtvec = 0;
+  bool synced = false;
+  uint64_t checked = 0, adopted = 0;
+
+  std::unordered_map<uint32_t, std::unique_ptr<uint8_t[]>> pages;
+  std::vector<std::pair<uint32_t, uint32_t>> devices;
+  std::set<uint32_t> regions;
+
+  commit_t history[HISTORY];
+  int history_head = 0, history_size = 0;
+};
+
+std::string elf_path;
+std::map<int, std::unique_ptr<rv32i_ref_t>> harts;
+
+rv32i_ref_t* get_hart(int hartid)
+{
+  auto it = harts.find(hartid);
+  if (it == harts.end()) {
+    std::unique_ptr<rv32i_ref_t> ref(new rv32i_ref_t(hartid));
+    if (!ref->load_elf(elf_path))
+      return nullptr;
+    it = harts.emplace(hartid, std::move(ref)).first;
+  }
+  return it->second.get();
+}
+
+}
+
+extern "C" void cosim_init(const char* elf)
+{
+  elf_path = elf;
+}
+
+extern "C" int cosim_commit(int hartid, int pc, int inst, int wen, int rd, int wdata)
+{
+  rv32i_ref_t* ref = get_hart(hartid);
+  if (!ref)
+    return 1;
+  commit_t c = { (uint32_t)pc, (uint32_t)inst, wen != 0, (uint32_t)rd, (uint32_t)wdata };
+  return ref->commit(c) ? 0 : 1;
+}
+
+extern "C" int cosim_trap(int hartid, int interrupt, int target)
+{
+  rv32i_ref_t* ref = get_hart(hartid);
+  if (!ref)
+    return 1;
+  return ref->trap(interrupt != 0, target) ? 0 : 1;
+}
+
+extern "C" void cosim_finish()
+{
+  for (auto& h : harts)
+    h.second->finish();
+}
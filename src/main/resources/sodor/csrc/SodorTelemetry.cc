@@ -0,0 +1,177 @@
+// See LICENSE for license details.
+
+// Live telemetry of a running emulator. Every hart with a SodorTelemetry
+// instance publishes its counters into a slot of one small memory-mapped file
+// every telemetry interval, and once more when the emulator exits, so that an
+// outside monitor (scripts/telemetry.py) can follow a run while it is going:
+// spot a hung or slow job, or add up the throughput of many.
+//
+// File layout, native endian (all fields 64 bits):
+//   header   magic "SODORTM", version, number of slots, pid of the emulator,
+//            wall-clock start time (ns since the epoch), padding to 64 bytes
+//   slot[n]  one per hart id, 128 bytes each, see telemetry_slot_t
+// A slot's seq is odd while it is being written; readers retry until they see
+// the same even seq before and after reading it.
+
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <fcntl.h>
+#include <map>
+#include <string>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+
+const uint64_t kVersion = 1;
+const size_t kSlots = 64; // hart ids 0 to 63
+
+struct telemetry_header_t {
+  char     magic[8];
+  uint64_t version;
+  uint64_t slots;
+  uint64_t pid;
+  uint64_t start_ns;
+  uint64_t pad[3];
+};
+
+enum : uint64_t { SLOT_UNUSED, SLOT_RUNNING, SLOT_FINISHED };
+
+struct telemetry_slot_t {
+  uint64_t seq;
+  uint64_t state;
+  uint64_t update_ns;       // wall clock of this update
+  uint64_t cycles;
+  uint64_t instret;
+  uint64_t stall_cycles;
+  uint64_t kill_cycles;
+  uint64_t pc;              // of the last retired instruction
+  double   cycles_per_sec;  // since the previous update
+  double   avg_cycles_per_sec;
+  uint64_t pad[6];
+};
+
+static_assert(sizeof(telemetry_header_t) == 64, "telemetry header layout");
+static_assert(sizeof(telemetry_slot_t) == 128, "telemetry slot layout");
+
+uint64_t now_ns()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_REALTIME, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+// One mapping per file, shared by all harts that publish into it
+class telemetry_file_t
+{
+ public:
+  explicit telemetry_file_t(const char* path)
+  {
+    size_t size = sizeof(telemetry_header_t) + kSlots * sizeof(telemetry_slot_t);
+    int fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0 || ftruncate(fd, size) != 0) {
+      fprintf(stderr, "telemetry: cannot create %s: %s\n", path, strerror(errno));
+      abort();
+    }
+    void* p = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (p == MAP_FAILED) {
+      fprintf(stderr, "telemetry: cannot map %s: %s\n", path, strerror(errno));
+      abort();
+    }
+    base = (char*)p;
+
+    auto* header = (telemetry_header_t*)base;
+    header->version = kVersion;
+    header->slots = kSlots;
+    header->pid = getpid();
+    header->start_ns = now_ns();
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    memcpy(header->magic, "SODORTM", 8); // last, so readers never see a half-made header
+  }
+
+  uint64_t start_ns() const { return ((telemetry_header_t*)base)->start_ns; }
+
+  telemetry_slot_t* slot(uint32_t hartid)
+  {
+    return (telemetry_slot_t*)(base + sizeof(telemetry_header_t)) + hartid;
+  }
+
+ private:
+  char* base;
+};
+
+std::map<std::string, telemetry_file_t*> files;
+
+class telemetry_t
+{
+ public:
+  telemetry_t(telemetry_file_t* file, uint32_t hartid)
+    : file(file), slot(file->slot(hartid)), last_ns(now_ns())
+  {
+    publish(SLOT_RUNNING, 0, 0, 0, 0, 0);
+  }
+
+  void update(uint64_t cycles, uint64_t instret, uint64_t stall, uint64_t kill, uint64_t pc, bool finished)
+  {
+    publish(finished ? SLOT_FINISHED : SLOT_RUNNING, cycles, instret, stall, kill, pc);
+  }
+
+ private:
+  void publish(uint64_t state, uint64_t cycles, uint64_t instret, uint64_t stall, uint64_t kill, uint64_t pc)
+  {
+    uint64_t now = now_ns();
+    double dt = (now - last_ns) / 1e9;
+    double total = (now - file->start_ns()) / 1e9;
+
+    uint64_t seq = slot->seq;
+    __atomic_store_n(&slot->seq, seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    slot->state = state;
+    slot->update_ns = now;
+    slot->cycles = cycles;
+    slot->instret = instret;
+    slot->stall_cycles = stall;
+    slot->kill_cycles = kill;
+    slot->pc = pc;
+    slot->cycles_per_sec = dt > 0 ? (cycles - last_cycles) / dt : 0;
+    slot->avg_cycles_per_sec = total > 0 ? cycles / total : 0;
+    __atomic_store_n(&slot->seq, seq + 2, __ATOMIC_RELEASE);
+
+    last_ns = now;
+    last_cycles = cycles;
+  }
+
+  telemetry_file_t* file;
+  telemetry_slot_t* slot;
+  uint64_t last_ns;
+  uint64_t last_cycles = 0;
+};
+
+std::vector<telemetry_t*> harts;
+
+}
+
+extern "C" int telemetry_init(const char* path, int hartid)
+{
+  if (hartid < 0 || (size_t)hartid >= kSlots) {
+    fprintf(stderr, "telemetry: hart id %d has no slot (at most %zu harts)\n", hartid, kSlots);
+    abort();
+  }
+  auto& file = files[path];
+  if (!file)
+    file = new telemetry_file_t(path);
+  harts.push_back(new telemetry_t(file, hartid));
+  return harts.size() - 1;
+}
+
+extern "C" void telemetry_update(int id, long long cycles, long long instret, long long stall_cycles,
+                                 long long kill_cycles, long long pc, int finished)
+{
+  harts[id]->update(cycles, instret, stall_cycles, kill_cycles, pc, finished);
+}
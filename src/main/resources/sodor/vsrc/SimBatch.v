@@ -0,0 +1,131 @@
+// See LICENSE for license details.
+
+import "DPI-C" function int batch_init
+(
+  input  string  list,
+  input  string  out,
+  output longint entry,
+  output longint tohost,
+  output int     last
+);
+
+import "DPI-C" function void batch_exit
+(
+  input  longint exit_data,
+  input  longint cycles
+);
+
+import "DPI-C" function void batch_load
+(
+  input  int     mem_id,
+  output longint entry,
+  output longint tohost,
+  output int     last
+);
+
+module SimBatch #(
+  parameter RESET_CYCLES = 8
+)(
+  input         clock,
+  input         reset,
+  input         fetch_valid,
+  input  [63:0] fetch_pc,
+  input         store_valid,
+  input  [63:0] store_addr,
+  input  [63:0] store_data,
+  input  [31:0] mem_id,
+  output        active,
+  output        boot,
+  output        core_reset,
+  output [63:0] reset_vector,
+  output [63:0] tohost,
+  output [63:0] exit_value
+);
+
+  // Batch mode only runs when the emulator is given +batch=<list>
+  //   +batch_out=<file>         results, one JSON object per line (default: stderr)
+  //   +batch_max_cycles=<n>     give up on a program after n cycles (default: never)
+  string list, out;
+  longint max_cycles;
+  reg running;      // a program of the batch is running
+  reg finished;     // the last program has exited
+  reg boot_r;
+  reg pending;      // the next program is loaded on the next cycle
+  reg started;
+  longint entry_r, tohost_r, cycles, reset_count;
+  longint failures;
+  int last_r;
+  reg [63:0] final_value;
+
+  initial begin
+    running = 0;
+    if ($value$plusargs("batch=%s", list)) begin
+      if (!$value$plusargs("batch_out=%s", out))
+        out = "";
+      running = batch_init(list, out, entry_r, tohost_r, last_r) != 0;
+    end
+    if (!$value$plusargs("batch_max_cycles=%d", max_cycles))
+      max_cycles = 0;
+    finished = 0;
+    boot_r = 1;
+    pending = 0;
+    started = 0;
+    cycles = 0;
+    reset_count = 0;
+    failures = 0;
+    final_value = 0;
+  end
+
+  // Any non-zero write to tohost ends the program: 1 is a pass, another odd
+  // value a failure with an exit code, an even value a request to the host
+  wire exit_store = running && store_valid && store_addr == tohost_r && store_data != 0;
+  wire timeout = running && started && max_cycles != 0 && cycles >= max_cycles;
+  wire failed = !exit_store || store_data != 1;
+  wire [62:0] total_failures = failures + failed;
+  wire advance = (exit_store || timeout) && last_r == 0;
+
+  always @(posedge clock) begin
+    if (!reset && running) begin
+      if (pending) begin
+        // The core has been in reset since the exit, so nothing else writes
+        // to the scratchpad while it is reloaded
+        batch_load(mem_id, entry_r, tohost_r, last_r);
+        pending = 0;
+      end
+      else if (exit_store || timeout) begin
+        if (failed)
+          failures = failures + 1;
+        batch_exit(exit_store ? store_data : 0, cycles);
+        if (advance) begin
+          pending = 1;
+          reset_count = RESET_CYCLES;
+          boot_r = 0;
+        end
+        else begin
+          running = 0;
+          finished = 1;
+          final_value = failures == 0 ? 64'd1 : {failures[62:0], 1'b1};
+          if (timeout)
+            $finish; // the last program never wrote tohost, so the host would wait forever
+        end
+        started = 0;
+        cycles = 0;
+      end
+      else if (reset_count != 0)
+        reset_count = reset_count - 1;
+      else if (!started && fetch_valid && fetch_pc == entry_r)
+        started = 1;
+      if (started)
+        cycles = cycles + 1;
+    end
+  end
+
+  assign active = running || finished;
+  assign boot = boot_r;
+  assign core_reset = advance || pending || reset_count != 0;
+  assign reset_vector = entry_r;
+  assign tohost = tohost_r;
+  assign exit_value = finished ? final_value :
+                      last_r == 0 ? 64'd0 :
+                      total_failures == 0 ? 64'd1 : {total_failures, 1'b1};
+endmodule
@@ -0,0 +1,20 @@
+// See LICENSE for license details.
+
+import "DPI-C" function void sim_console_putchar
+(
+  input byte ch
+);
+
+module SimConsole(
+  input       clock,
+  input       reset,
+  input       valid,
+  input [7:0] data
+);
+
+  always @(posedge clock)
+  begin
+    if (!reset && valid)
+      sim_console_putchar(data);
+  end
+endmodule
@@ -14,9 +14,17 @@ import "DPI-C" function int debug_tick
   input  int        debug_resp_bits_data
 );
 
-module SimDTM(
+// With USE_TICK set, debug_tick is only called on the cycles `tick` is set.
+// In event-driven mode SimDTMPoll (see debug.scala) clears it while the host
+// has nothing to do; otherwise it is always set. The DMI request is held
+// between ticks, so `tick` must be set whenever debug_req_valid is. With
+// USE_TICK at 0 (the default) `tick` is ignored and may be left unconnected.
+module SimDTM #(
+  parameter USE_TICK = 0
+)(
   input clk,
   input reset,
+  input tick,
 
   output        debug_req_valid,
   input         debug_req_ready,
@@ -62,7 +70,7 @@ module SimDTM(
       __debug_resp_ready = 0;
       __exit = 0;
     end
-    else
+    else if (!USE_TICK || tick)
     begin
       __exit = debug_tick(
         __debug_req_valid,
@@ -0,0 +1,70 @@
+// See LICENSE for license details.
+
+import "DPI-C" function longint sparse_mem_read
+(
+  input int     mem_id,
+  input longint addr,
+  input int     size,
+  input int     is_signed,
+  input int     epoch
+);
+
+import "DPI-C" function int sparse_mem_epoch
+(
+  input int     mem_id
+);
+
+import "DPI-C" function void sparse_mem_write
+(
+  input int     mem_id,
+  input longint addr,
+  input longint data,
+  input int     size
+);
+
+module SimSparseMemPort #(
+  parameter SYNC_READ = 0
+)(
+  input         clock,
+  input  [31:0] mem_id,
+  input  [31:0] epoch,
+
+  input  [63:0] addr,
+  input  [ 1:0] size,
+  input         is_signed,
+  input         wen,
+  input  [63:0] wdata,
+  output [63:0] rdata
+);
+
+  reg [63:0] __rdata;
+  reg [31:0] __mem_epoch;
+
+  initial __mem_epoch = 0;
+
+  // The epoch argument is unused by the C++ side; it only makes the
+  // combinational read sensitive to writes from any port of this memory
+  // (epoch) and to the memory being cleared and reloaded from outside the
+  // design by the batch runner (__mem_epoch, sampled every cycle).
+  generate
+    if (SYNC_READ) begin
+      always @(posedge clock)
+        __rdata <= sparse_mem_read(mem_id, addr, {30'b0, size}, {31'b0, is_signed}, epoch);
+    end
+    else begin
+      always @(posedge clock)
+        __mem_epoch <= sparse_mem_epoch(mem_id);
+
+      always @(*)
+        __rdata = sparse_mem_read(mem_id, addr, {30'b0, size}, {31'b0, is_signed}, epoch + __mem_epoch);
+    end
+  endgenerate
+
+  always @(posedge clock)
+  begin
+    if (wen)
+      sparse_mem_write(mem_id, addr, wdata, {30'b0, size});
+  end
+
+  assign rdata = __rdata;
+endmodule
@@ -0,0 +1,121 @@
+// See LICENSE for license details.
+
+import "DPI-C" function int bbv_init
+(
+  input string  path,
+  input int     hartid,
+  input string  sample
+);
+
+import "DPI-C" function void bbv_block
+(
+  input int     id,
+  input int     pc,
+  input longint count
+);
+
+import "DPI-C" function int bbv_interval
+(
+  input int     id,
+  input longint insts,
+  input longint cycles
+);
+
+import "DPI-C" function void bbv_finish
+(
+  input int     id,
+  input longint insts,
+  input longint cycles
+);
+
+module SodorBBV (
+  input         clock,
+  input         reset,
+  input  [31:0] hartid,
+  input         retire,
+  input  [31:0] pc
+);
+
+  // Profiling only runs when the emulator is given +bbv=<file>
+  //   +bbv_interval=<n>   instructions per interval (default 100000)
+  //   +bbv_start=<hex>    pc of the first profiled instruction (default 80000000)
+  //   +bbv_sample=<file>  sampled run: only measure the intervals listed in
+  //                       this .simpts file and stop after the last of them
+  string path, sample;
+  longint interval;
+  reg [31:0] start_pc;
+  reg enabled;
+  reg sampled;
+  reg started;
+  reg running;
+  int id;
+
+  // Basic blocks are tracked here, so the profiler is only called when a
+  // block or an interval ends rather than on every cycle
+  reg [31:0] last_pc, block;
+  longint count, insts, cycles;
+
+  initial begin
+    enabled = $value$plusargs("bbv=%s", path);
+    if (!$value$plusargs("bbv_interval=%d", interval))
+      interval = 100000;
+    if (!$value$plusargs("bbv_start=%h", start_pc))
+      start_pc = 32'h80000000;
+    sampled = $value$plusargs("bbv_sample=%s", sample);
+    if (!sampled)
+      sample = "";
+    started = 0;
+    running = 0;
+    last_pc = 0;
+    block = 0;
+    count = 0;
+    insts = 0;
+    cycles = 0;
+  end
+
+  // The hart id is only valid once the design is out of reset
+  always @(posedge clock) begin
+    if (enabled && !reset) begin
+      if (!started) begin
+        id = bbv_init(path, hartid, sample);
+        started = 1;
+      end
+      // Profiling starts at the first retire at the start pc, so the boot ROM
+      // is not included
+      if (!running && retire && pc == start_pc)
+        running = 1;
+      if (running) begin
+        cycles = cycles + 1;
+        if (retire) begin
+          // Any retire that does not follow the previous one starts a block
+          if (pc != last_pc + 32'd4) begin
+            if (count != 0 && !sampled)
+              bbv_block(id, block, count);
+            block = pc;
+            count = 0;
+          end
+          last_pc = pc;
+          count = count + 1;
+          insts = insts + 1;
+          if (insts == interval) begin
+            if (!sampled)
+              bbv_block(id, block, count);
+            count = 0;
+            if (bbv_interval(id, insts, cycles) != 0)
+              $finish;
+            insts = 0;
+            cycles = 0;
+          end
+        end
+      end
+    end
+  end
+
+  final begin
+    if (started) begin
+      if (count != 0 && !sampled)
+        bbv_block(id, block, count);
+      bbv_finish(id, insts, cycles);
+    end
+  end
+endmodule
@@ -0,0 +1,70 @@
+// See LICENSE for license details.
+
+import "DPI-C" function void cosim_init
+(
+  input string  elf
+);
+
+import "DPI-C" function int cosim_commit
+(
+  input int     hartid,
+  input int     pc,
+  input int     inst,
+  input int     wen,
+  input int     rd,
+  input int     wdata
+);
+
+import "DPI-C" function int cosim_trap
+(
+  input int     hartid,
+  input int     interrupt,
+  input int     target
+);
+
+import "DPI-C" function void cosim_finish();
+
+module SodorCosim (
+  input         clock,
+  input         reset,
+  input  [31:0] hartid,
+
+  input         commit_valid,
+  input  [31:0] commit_pc,
+  input  [31:0] commit_inst,
+  input         commit_wen,
+  input  [ 4:0] commit_rd,
+  input  [31:0] commit_wdata,
+
+  input         trap_valid,
+  input         trap_interrupt,
+  input  [31:0] trap_target
+);
+
+  // Co-simulation only runs when the emulator is given +cosim=<elf>
+  string elf;
+  reg enabled;
+
+  initial begin
+    enabled = $value$plusargs("cosim=%s", elf);
+    if (enabled)
+      cosim_init(elf);
+  end
+
+  // A retire is checked before a trap taken in the same cycle, which always
+  // belongs to a younger instruction
+  always @(posedge clock) begin
+    if (enabled && !reset) begin
+      if (commit_valid && cosim_commit(hartid, commit_pc, commit_inst, {31'b0, commit_wen},
+                                       {27'b0, commit_rd}, commit_wdata) != 0)
+        $fatal(1, "cosim: core diverged from the reference model");
+      if (trap_valid && cosim_trap(hartid, {31'b0, trap_interrupt}, trap_target) != 0)
+        $fatal(1, "cosim: core diverged from the reference model");
+    end
+  end
+
+  final begin
+    if (enabled)
+      cosim_finish();
+  end
+endmodule
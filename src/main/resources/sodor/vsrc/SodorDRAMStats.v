@@ -0,0 +1,39 @@
+// See LICENSE for license details.
+
+// Prints the statistics of a DRAM timing model (see dram_model.scala) on
+// stderr when the emulator exits.
+module SodorDRAMStats #(
+  parameter NAME = "dram"
+)(
+  input         clock,
+  input         reset,
+  input  [63:0] reads,
+  input  [63:0] writes,
+  input  [63:0] bytes,
+  input  [63:0] row_hits,
+  input  [63:0] row_empty,
+  input  [63:0] row_conflicts,
+  input  [63:0] queue_cycles,
+  input  [63:0] max_queue,
+  input  [63:0] latency_cycles,
+  input  [63:0] full_cycles,
+  input  [63:0] busy_cycles,
+  input  [63:0] cycles
+);
+
+  function real ratio(input [63:0] num, input [63:0] den);
+    ratio = den == 0 ? 0.0 : $itor(num) / $itor(den);
+  endfunction
+
+  final begin
+    $fwrite(32'h80000002, "[%0s] %0d reads, %0d writes, %0d bytes in %0d cycles\n",
+            NAME, reads, writes, bytes, cycles);
+    $fwrite(32'h80000002, "[%0s] row buffer: %0.1f%% hits, %0.1f%% closed, %0.1f%% conflicts\n",
+            NAME, 100.0 * ratio(row_hits, reads + writes), 100.0 * ratio(row_empty, reads + writes),
+            100.0 * ratio(row_conflicts, reads + writes));
+    $fwrite(32'h80000002, "[%0s] latency: %0.1f cycles average, queueing %0.1f average / %0d max, %0d cycles stalled on a full queue\n",
+            NAME, ratio(latency_cycles, reads + writes), ratio(queue_cycles, reads + writes), max_queue, full_cycles);
+    $fwrite(32'h80000002, "[%0s] bandwidth: %0.3f bytes/cycle, data bus %0.1f%% busy\n",
+            NAME, ratio(bytes, cycles), 100.0 * ratio(busy_cycles, cycles));
+  end
+endmodule
@@ -0,0 +1,28 @@
+// See LICENSE for license details.
+
+// Prints the accuracy and coverage of the stride prefetcher (see
+// prefetcher.scala) on stderr when the emulator exits.
+module SodorPrefetchStats (
+  input         clock,
+  input         reset,
+  input  [63:0] loads,
+  input  [63:0] hits,
+  input  [63:0] late,
+  input  [63:0] issued,
+  input  [63:0] useful,
+  input  [63:0] dropped
+);
+
+  function real percent(input [63:0] num, input [63:0] den);
+    percent = den == 0 ? 0.0 : 100.0 * $itor(num) / $itor(den);
+  endfunction
+
+  final begin
+    $fwrite(32'h80000002, "[prefetch] %0d loads: %0d buffer hits, %0d late (waited on the prefetch)\n",
+            loads, hits, late);
+    $fwrite(32'h80000002, "[prefetch] %0d issued, %0d useful, %0d dropped by stores\n",
+            issued, useful, dropped);
+    $fwrite(32'h80000002, "[prefetch] accuracy %0.1f%%, coverage %0.1f%%\n",
+            percent(useful, issued), percent(hits + late, loads));
+  end
+endmodule
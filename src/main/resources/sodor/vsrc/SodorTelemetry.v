@@ -0,0 +1,81 @@
+// See LICENSE for license details.
+
+import "DPI-C" function int telemetry_init
+(
+  input string  path,
+  input int     hartid
+);
+
+import "DPI-C" function void telemetry_update
+(
+  input int     id,
+  input longint cycles,
+  input longint instret,
+  input longint stall_cycles,
+  input longint kill_cycles,
+  input longint pc,
+  input int     finished
+);
+
+module SodorTelemetry (
+  input         clock,
+  input         reset,
+  input  [31:0] hartid,
+  input         retire,
+  input  [63:0] pc,
+  input         stall,
+  input         kill
+);
+
+  // Telemetry only runs when the emulator is given +telemetry=<file>
+  //   +telemetry_interval=<n>   cycles between updates (default 100000)
+  string path;
+  longint interval;
+  reg enabled;
+  reg started;
+  int id;
+  longint cycles, instret, stall_cycles, kill_cycles, countdown;
+  reg [63:0] last_pc;
+
+  initial begin
+    enabled = $value$plusargs("telemetry=%s", path);
+    if (!$value$plusargs("telemetry_interval=%d", interval))
+      interval = 100000;
+    started = 0;
+    cycles = 0;
+    instret = 0;
+    stall_cycles = 0;
+    kill_cycles = 0;
+    countdown = interval;
+    last_pc = 0;
+  end
+
+  // The hart id is only valid once the design is out of reset
+  always @(posedge clock) begin
+    if (enabled && !reset) begin
+      if (!started) begin
+        id = telemetry_init(path, hartid);
+        started = 1;
+      end
+      cycles = cycles + 1;
+      if (retire) begin
+        instret = instret + 1;
+        last_pc = pc;
+      end
+      if (stall)
+        stall_cycles = stall_cycles + 1;
+      if (kill)
+        kill_cycles = kill_cycles + 1;
+      countdown = countdown - 1;
+      if (countdown == 0) begin
+        telemetry_update(id, cycles, instret, stall_cycles, kill_cycles, last_pc, 0);
+        countdown = interval;
+      end
+    end
+  end
+
+  final begin
+    if (started)
+      telemetry_update(id, cycles, instret, stall_cycles, kill_cycles, last_pc, 1);
+  end
+endmodule
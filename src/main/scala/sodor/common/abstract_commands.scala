@@ -56,6 +56,59 @@ class ACCESS_REGISTERFields extends Bundle {
 
 }
 
+class ACCESS_MEMORYFields extends Bundle {
+
+  /* This is 2 to indicate Access Memory Command.
+  */
+  val cmdtype = UInt(8.W)
+
+  /* An implementation does not have to implement both virtual and
+            physical accesses, but it must fail accesses that it doesn't
+            support.
+
+            0: Addresses are physical (to the hart they are performed on).
+
+            1: Addresses are virtual, and translated the way they would be from
+            M-mode, with \Fmprv set.
+  */
+  val aamvirtual = Bool()
+
+  /* 0: Access the lowest 8 bits of the memory location.
+
+            1: Access the lowest 16 bits of the memory location.
+
+            2: Access the lowest 32 bits of the memory location.
+
+            3: Access the lowest 64 bits of the memory location.
+
+            4: Access the lowest 128 bits of the memory location.
+  */
+  val aamsize = UInt(3.W)
+
+  /* After a memory access has completed, if this bit is 1, increment
+            {\tt arg1} (which contains the address used) by the number of bytes
+            encoded in \Faamsize.
+  */
+  val aampostincrement = Bool()
+
+  val reserved0 = UInt(2.W)
+
+  /* 0: Copy data from the memory location specified in {\tt arg1} into
+               {\tt arg0} portion of {\tt data}.
+
+            1: Copy data from {\tt arg0} portion of {\tt data} into the
+               memory location specified in {\tt arg1}.
+  */
+  val write = Bool()
+
+  /* These bits are reserved for target-specific uses.
+  */
+  val target_specific = UInt(2.W)
+
+  val reserved1 = UInt(14.W)
+
+}
+
 class QUICK_ACCESSFields extends Bundle {
 
   /* This is 1 to indicate Quick Access command.
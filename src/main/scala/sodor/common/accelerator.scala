@@ -0,0 +1,148 @@
+//**************************************************************************
+// Custom-instruction accelerator interface
+//--------------------------------------------------------------------------
+//
+// A RoCC-like port for the 5-stage and 3-stage cores. Instructions on the
+// custom-0 and custom-1 opcodes are sent to the attached accelerator with the
+// values of rs1 and rs2; funct7 and funct3 are free for the accelerator to
+// decode, except that funct3 holds the xd/xs1/xs2 bits as in RoCC. Commands
+// are issued from the last stage before writeback, where nothing older can
+// still kill them. The instruction holds the pipeline there until the
+// command is accepted and, if xd is set, until the response arrives, which
+// is then written to rd. Accelerators must not respond to commands without
+// xd. FENCE waits for the accelerator to go idle (busy low).
+
+package sodor.common
+
+import chisel3._
+import chisel3.util._
+
+class SodorAccelInst extends Bundle {
+  val funct7 = UInt(7.W)
+  val rs2 = UInt(5.W)
+  val rs1 = UInt(5.W)
+  val xd = Bool()
+  val xs1 = Bool()
+  val xs2 = Bool()
+  val rd = UInt(5.W)
+  val opcode = UInt(7.W)
+}
+
+class SodorAccelCmd(implicit val conf: SodorCoreParams) extends Bundle {
+  val inst = new SodorAccelInst
+  val rs1 = UInt(conf.xprlen.W)
+  val rs2 = UInt(conf.xprlen.W)
+}
+
+class SodorAccelResp(implicit val conf: SodorCoreParams) extends Bundle {
+  val data = UInt(conf.xprlen.W)
+}
+
+// Core side
+class SodorAccelIo(implicit val conf: SodorCoreParams) extends Bundle {
+  val cmd = Decoupled(new SodorAccelCmd)
+  val resp = Flipped(Decoupled(new SodorAccelResp))
+  val busy = Input(Bool())
+}
+
+abstract class SodorAccelerator(implicit val conf: SodorCoreParams) extends Module {
+  val io = IO(Flipped(new SodorAccelIo))
+}
+
+trait SodorAccelFactory {
+  def instantiate(implicit conf: SodorCoreParams): SodorAccelerator
+}
+
+object SodorAccel {
+  def isCmd(inst: UInt): Bool = inst(6, 0) === "b0001011".U || inst(6, 0) === "b0101011".U // custom-0, custom-1
+
+  // Decode table rows of the custom-0/1 instructions: given whether rd is
+  // written and rs1/rs2 are read, the row for that instruction
+  def decode(row: (Boolean, Boolean, Boolean) => List[UInt]): Array[(BitPat, List[UInt])] = {
+    import Instructions._
+    Array(
+      CUSTOM0            -> row(false, false, false),
+      CUSTOM0_RS1        -> row(false, true,  false),
+      CUSTOM0_RS1_RS2    -> row(false, true,  true),
+      CUSTOM0_RD         -> row(true,  false, false),
+      CUSTOM0_RD_RS1     -> row(true,  true,  false),
+      CUSTOM0_RD_RS1_RS2 -> row(true,  true,  true),
+      CUSTOM1            -> row(false, false, false),
+      CUSTOM1_RS1        -> row(false, true,  false),
+      CUSTOM1_RS1_RS2    -> row(false, true,  true),
+      CUSTOM1_RD         -> row(true,  false, false),
+      CUSTOM1_RD_RS1     -> row(true,  true,  false),
+      CUSTOM1_RD_RS1_RS2 -> row(true,  true,  true))
+  }
+
+  // The core's port when no accelerator is attached (the opcodes then decode
+  // as illegal instructions)
+  def tieOff(port: SodorAccelIo): Unit = {
+    port.cmd.ready := false.B
+    port.resp.valid := false.B
+    port.resp.bits := DontCare
+    port.busy := false.B
+  }
+
+  def attach(port: SodorAccelIo)(implicit conf: SodorCoreParams): Unit = conf.accel match {
+    case Some(factory) =>
+      val accel = Module(factory.instantiate)
+      accel.io <> port
+    case None => tieOff(port)
+  }
+}
+
+//**************************************************************************
+// Example: CRC-32 (IEEE 802.3, reflected, polynomial 0xEDB88320)
+//
+//   funct7 0, custom-0: rd = crc32_update(rs1, the 4 bytes of rs2, LSB first)
+//   funct7 1, custom-0: rd = crc32_update(rs1, the low byte of rs2)
+//
+// The initial and final inversions are left to software. The unit shifts in
+// bitsPerCycle bits a cycle, so a word takes 32 / bitsPerCycle cycles.
+
+class SodorCRC32Accel(bitsPerCycle: Int = 8)(implicit conf: SodorCoreParams) extends SodorAccelerator {
+  require(bitsPerCycle > 0 && 8 % bitsPerCycle == 0)
+  val poly = "hEDB88320".U(32.W)
+
+  val s_idle :: s_busy :: s_resp :: Nil = Enum(3)
+  val state = RegInit(s_idle)
+  val crc = Reg(UInt(32.W))
+  val data = Reg(UInt(32.W))
+  val left = Reg(UInt(6.W)) // bits still to shift in
+  val xd = Reg(Bool())
+
+  io.cmd.ready := state === s_idle
+  when (io.cmd.fire) {
+    crc := io.cmd.bits.rs1(31, 0)
+    data := io.cmd.bits.rs2(31, 0)
+    left := Mux(io.cmd.bits.inst.funct7(0), 8.U, 32.U)
+    xd := io.cmd.bits.inst.xd
+    state := s_busy
+  }
+
+  when (state === s_busy) {
+    val next = (0 until bitsPerCycle).foldLeft(crc) { case (c, i) =>
+      val c1 = c ^ data(i)
+      (c1 >> 1) ^ Mux(c1(0), poly, 0.U)
+    }
+    crc := next
+    data := data >> bitsPerCycle
+    left := left - bitsPerCycle.U
+    when (left === bitsPerCycle.U) {
+      state := Mux(xd, s_resp, s_idle)
+    }
+  }
+
+  io.resp.valid := state === s_resp
+  io.resp.bits.data := crc
+  when (io.resp.fire) {
+    state := s_idle
+  }
+
+  io.busy := state =/= s_idle
+}
+
+case class SodorCRC32AccelFactory(bitsPerCycle: Int = 8) extends SodorAccelFactory {
+  def instantiate(implicit conf: SodorCoreParams) = new SodorCRC32Accel(bitsPerCycle)
+}
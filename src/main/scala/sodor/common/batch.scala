@@ -0,0 +1,92 @@
+//**************************************************************************
+// Batch mode
+//--------------------------------------------------------------------------
+//
+// Runs a list of programs back to back in one emulator process instead of
+// paying for elaboration, start-up and boot once per program (see
+// SimBatch.cc). The emulator is started on the first program of the
+// +batch=<list> file as usual. When a program writes tohost, its result is
+// recorded and, instead of passing the write on to the host, the scratchpad
+// is cleared, the next program is loaded straight into it and the core is
+// reset to the program's entry point. Only the last program's write reaches
+// the host, with the exit code of the whole batch (0 when every program
+// passed, otherwise the number of failures). Reloading bumps the memory's
+// epoch on the C side, so that asynchronous read ports look at the new
+// program even when their address has not changed (see SimSparseMem.v).
+//
+// Needs the sparse DPI scratchpad (useSimMemory). Programs can only exit
+// through tohost: the host never sees the other requests (e.g. syscalls), so
+// these end the program as a failure. The core and its CSRs are reset between
+// programs; the rest of the system (CLINT, DMA engine, DRAM model statistics)
+// is not.
+
+package sodor.common
+
+import chisel3._
+import chisel3.util._
+
+import Constants._
+
+class SimBatch extends BlackBox with HasBlackBoxResource {
+  val io = IO(new Bundle {
+    val clock = Input(Clock())
+    val reset = Input(Bool())
+    val fetch_valid = Input(Bool())
+    val fetch_pc = Input(UInt(64.W))
+    val store_valid = Input(Bool())
+    val store_addr = Input(UInt(64.W))
+    val store_data = Input(UInt(64.W))
+    val mem_id = Input(UInt(32.W)) // the scratchpad's sparse DPI table
+    val active = Output(Bool()) // tohost writes are being taken over
+    val boot = Output(Bool()) // still on the first program, started through the boot ROM
+    val core_reset = Output(Bool())
+    val reset_vector = Output(UInt(64.W))
+    val tohost = Output(UInt(64.W))
+    val exit_value = Output(UInt(64.W))
+  })
+  addResource("/sodor/vsrc/SimBatch.v")
+  addResource("/sodor/csrc/SimBatch.cc")
+}
+
+// Sits on the core's data port. Core requests pass through, except that the
+// data of a store to tohost is replaced by what the host should see.
+class SodorBatch(implicit val conf: SodorCoreParams) extends Module {
+  val io = IO(new Bundle {
+    val core = Flipped(new MemPortIo(data_width = conf.xprlen))
+    val mem = new MemPortIo(data_width = conf.xprlen)
+    val fetch = Input(Valid(UInt(conf.xprlen.W)))
+    val core_reset = Output(Bool())
+    val boot = Output(Bool())
+    val reset_vector = Output(UInt(conf.xprlen.W))
+    val mem_id = Input(UInt(32.W)) // the scratchpad's sparse DPI table
+  })
+
+  val ctrl = Module(new SimBatch)
+  ctrl.io.clock := clock
+  ctrl.io.reset := reset.asBool
+  ctrl.io.fetch_valid := io.fetch.valid
+  ctrl.io.fetch_pc := io.fetch.bits
+  ctrl.io.store_valid := io.core.req.fire && io.core.req.bits.fcn === M_XWR
+  ctrl.io.store_addr := io.core.req.bits.addr
+  ctrl.io.store_data := io.core.req.bits.data
+  ctrl.io.mem_id := io.mem_id
+
+  io.core_reset := ctrl.io.core_reset
+  io.boot := ctrl.io.boot
+  io.reset_vector := ctrl.io.reset_vector
+
+  io.mem <> io.core
+  when (ctrl.io.active && io.core.req.bits.addr === ctrl.io.tohost) {
+    io.mem.req.bits.data := ctrl.io.exit_value
+  }
+}
+
+object SodorBatch {
+  // Returns the data port to connect in place of the core's
+  def apply(batch: SodorBatch, dmem: MemPortIo, imem: MemPortIo): MemPortIo = {
+    batch.io.core <> dmem
+    batch.io.fetch.valid := imem.req.valid
+    batch.io.fetch.bits := imem.req.bits.addr
+    batch.io.mem
+  }
+}
@@ -0,0 +1,32 @@
+package sodor.common
+
+import chisel3._
+import chisel3.util._
+
+// Basic-block vector profiling from the commit path (see SodorBBV.cc and
+// scripts/simpoint.py). Built in with WithSodorBBV and enabled at run time
+// with +bbv=<file>; harts other than 0 write to <file>.<hartid>. With
+// +bbv_sample=<simpts> it only measures the chosen intervals instead.
+class SodorBBV extends BlackBox with HasBlackBoxResource {
+  val io = IO(new Bundle {
+    val clock = Input(Clock())
+    val reset = Input(Bool())
+    val hartid = Input(UInt(32.W))
+    val retire = Input(Bool())
+    val pc = Input(UInt(32.W))
+  })
+  addResource("/sodor/vsrc/SodorBBV.v")
+  addResource("/sodor/csrc/SodorBBV.cc")
+}
+
+object SodorBBV {
+  def apply(hartid: UInt, retire: Bool, pc: UInt): SodorBBV = {
+    val bbv = Module(new SodorBBV)
+    bbv.io.clock := Module.clock
+    bbv.io.reset := Module.reset.asBool
+    bbv.io.hartid := hartid
+    bbv.io.retire := retire
+    bbv.io.pc := pc
+    bbv
+  }
+}
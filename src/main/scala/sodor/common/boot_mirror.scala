@@ -0,0 +1,83 @@
+//**************************************************************************
+// Boot image mirror
+//--------------------------------------------------------------------------
+//
+// With several tiles (WithNSodorCores), every hart runs out of its own
+// scratchpad: the cores of the other tiles see theirs at the boot address,
+// where the first tile's scratchpad is (see SodorRequestRouter). The host only
+// loads the program into the first tile's scratchpad, so this adapter sits in
+// front of it and copies every beat written to it over the bus to the same
+// offset of the other tiles' scratchpads, until the first hart starts using
+// its scratchpad. Each beat goes out as a single-beat PutPartial and is only
+// passed on to the scratchpad once all copies have been acknowledged. Later
+// writes are not copied, so the scratchpads can be used as private memories.
+
+package sodor.common
+
+import chisel3._
+import chisel3.util._
+
+import org.chipsalliance.cde.config._
+import freechips.rocketchip.diplomacy._
+import freechips.rocketchip.tilelink._
+
+class SodorBootMirror(base: BigInt, targets: Seq[BigInt])(implicit p: Parameters) extends LazyModule {
+  require(targets.nonEmpty, "The boot mirror needs scratchpads to copy to.")
+
+  // In front of the scratchpad adapter
+  val node = TLAdapterNode()
+  // Onto the tile's master crossbar, one copy in flight
+  val masterNode = TLClientNode(Seq(TLMasterPortParameters.v1(
+    clients = Seq(TLMasterParameters.v1(
+      name = "sodor-boot-mirror",
+      sourceId = IdRange(0, 1)
+    ))
+  )))
+
+  lazy val module = new LazyModuleImp(this) {
+    val io = IO(new Bundle {
+      val active = Input(Bool()) // the program is still being loaded
+    })
+
+    val (in, edgeIn) = node.in(0)
+    val (out, _) = node.out(0)
+    val (tl, edge) = masterNode.out(0)
+    val beatBytes = edgeIn.manager.beatBytes
+    val lgBeatBytes = log2Ceil(beatBytes)
+    require(edge.manager.beatBytes == beatBytes, "The boot mirror copies whole bus beats.")
+
+    out <> in
+
+    // Address of the beat, as an offset into the scratchpad
+    val (_, _, _, beat) = edgeIn.count(in.a)
+    val beat_addr = (in.a.bits.address >> lgBeatBytes << lgBeatBytes) | (beat << lgBeatBytes)
+    val offset = beat_addr - base.U
+
+    val put = in.a.bits.opcode === TLMessages.PutFullData || in.a.bits.opcode === TLMessages.PutPartialData
+    val copy = io.active && in.a.valid && put && in.a.bits.mask =/= 0.U
+    val target = RegInit(0.U(log2Ceil(targets.size + 1).W))
+    val sent = RegInit(false.B)
+    val copied = !copy || target === targets.size.U
+
+    out.a.valid := in.a.valid && copied
+    in.a.ready := out.a.ready && copied
+    when (in.a.fire) { target := 0.U }
+
+    val address = VecInit(targets.map(_.U(edge.bundle.addressBits.W)))(target) + offset
+    val (legal, put_bundle) = edge.Put(0.U, address, lgBeatBytes.U, in.a.bits.data, in.a.bits.mask)
+    tl.a.valid := !copied && !sent
+    tl.a.bits := put_bundle
+    tl.d.ready := true.B
+    when (tl.a.fire) { sent := true.B }
+    when (tl.d.fire) {
+      sent := false.B
+      target := target + 1.U
+    }
+    assert(legal || !tl.a.valid, "Boot mirror copy is not a legal PutPartial")
+    assert(!tl.d.valid || !tl.d.bits.denied, "Boot mirror copy was denied")
+
+    tl.b.ready := true.B
+    tl.c.valid := false.B
+    tl.e.valid := false.B
+  }
+}
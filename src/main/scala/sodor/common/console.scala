@@ -0,0 +1,54 @@
+package sodor.common
+
+import chisel3._
+import chisel3.util._
+
+import org.chipsalliance.cde.config._
+import freechips.rocketchip.diplomacy._
+import freechips.rocketchip.regmapper._
+import freechips.rocketchip.tilelink._
+
+// Simulation console sink. Every byte written to it is handed to the
+// emulator through DPI and printed on its stdout (see SimConsole.cc).
+class SimConsole extends BlackBox with HasBlackBoxResource {
+  val io = IO(new Bundle {
+    val clock = Input(Clock())
+    val reset = Input(Bool())
+    val valid = Input(Bool())
+    val data = Input(UInt(8.W))
+  })
+  addResource("/sodor/vsrc/SimConsole.v")
+  addResource("/sodor/csrc/SimConsole.cc")
+}
+
+object SodorConsoleConsts {
+  val txdata = 0x0 // write: emit the low byte; read: always 0 (never full)
+  val size = 0x1000
+}
+
+// Memory-mapped console on the tile slave crossbar. Programs store a byte to
+// `address` instead of going through the tohost/fromhost handshake, so the
+// host does not need to poll the system bus to get output out of the target.
+class SodorConsole(address: BigInt, beatBytes: Int)(implicit p: Parameters) extends LazyModule {
+  val device = new SimpleDevice("console", Seq("ucb-bar,sodor-console"))
+  val node = TLRegisterNode(
+    address = Seq(AddressSet(address, SodorConsoleConsts.size - 1)),
+    device = device,
+    beatBytes = beatBytes)
+
+  lazy val module = new LazyModuleImp(this) {
+    val sink = Module(new SimConsole)
+    sink.io.clock := clock
+    sink.io.reset := reset.asBool
+    sink.io.valid := false.B
+    sink.io.data := 0.U
+
+    node.regmap(
+      SodorConsoleConsts.txdata -> Seq(RegField.w(8, RegWriteFn((valid, data) => {
+        sink.io.valid := valid
+        sink.io.data := data
+        true.B
+      }), RegFieldDesc("txdata", "Console transmit byte")))
+    )
+  }
+}
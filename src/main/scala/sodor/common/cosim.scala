@@ -0,0 +1,43 @@
+package sodor.common
+
+import chisel3._
+import chisel3.util._
+
+// Lockstep co-simulation against the RV32I reference model in SodorCosim.cc.
+// Built in with WithSodorCosim and enabled at run time with +cosim=<elf>;
+// every retired instruction is checked as it retires and the emulator stops
+// at the first divergence.
+class SodorCosim extends BlackBox with HasBlackBoxResource {
+  val io = IO(new Bundle {
+    val clock = Input(Clock())
+    val reset = Input(Bool())
+    val hartid = Input(UInt(32.W))
+
+    // An instruction retired, writing wdata to rd if wen
+    val commit_valid = Input(Bool())
+    val commit_pc = Input(UInt(32.W))
+    val commit_inst = Input(UInt(32.W))
+    val commit_wen = Input(Bool())
+    val commit_rd = Input(UInt(5.W))
+    val commit_wdata = Input(UInt(32.W))
+
+    // An exception or interrupt redirected the core to target without
+    // retiring the oldest unretired instruction. ecall, ebreak and mret
+    // retire normally and are not reported here.
+    val trap_valid = Input(Bool())
+    val trap_interrupt = Input(Bool())
+    val trap_target = Input(UInt(32.W))
+  })
+  addResource("/sodor/vsrc/SodorCosim.v")
+  addResource("/sodor/csrc/SodorCosim.cc")
+}
+
+object SodorCosim {
+  def apply(hartid: UInt): SodorCosim = {
+    val cosim = Module(new SodorCosim)
+    cosim.io.clock := Module.clock
+    cosim.io.reset := Module.reset.asBool
+    cosim.io.hartid := hartid
+    cosim
+  }
+}
@@ -2,6 +2,8 @@ package sodor.common
 
 import chisel3._
 import chisel3.util._
+import chisel3.experimental._
+import freechips.rocketchip.util.PlusArg
 import sodor.common.Util._
 import Util._
 import Constants._
@@ -26,8 +28,11 @@ object DMConsts{
 
   def dmi_haltStatusAddr   = 0x40
   def nProgBuf = 4
-  def nDataCount = 1
+  def nDataCount = 2
   def hartInfo = "h111bc0".U
+
+  def cmd_ACCESS_REGISTER = 0.U
+  def cmd_ACCESS_MEMORY   = 2.U
 }
 
 
@@ -59,19 +64,38 @@ class DMIIO(implicit val conf: SodorCoreParams) extends Bundle {
   *
   */
 
-class SimDTM(implicit val conf: SodorCoreParams) extends BlackBox {
+// pollInterval > 0 (or +dtm_poll_interval=N) selects the event-driven DTM:
+// once the host's queued DMI commands are drained it stops calling debug_tick
+// until `wake` is asserted or the poll interval has passed (see SimDTMPoll).
+// Nothing in this tree instantiates SimDTM: a test harness that does should
+// call connect with a wake built by SimDTM.wake from the tile's data port, so
+// that the host sees tohost writes and debug requests right away. Without a
+// wake the host only sees them once the poll interval has passed. Harnesses
+// that instantiate SimDTM.v themselves and leave USE_TICK at 0 keep calling
+// debug_tick every cycle.
+class SimDTM(val pollInterval: Int = 0)(implicit val conf: SodorCoreParams) extends BlackBox(Map("USE_TICK" -> IntParam(1))) {
   val io = IO(new Bundle {
       val clk = Input(Clock())
       val reset = Input(Bool())
+      val tick = Input(Bool())
       val debug = new DMIIO()
       val exit = Output(UInt(32.W))
     })
 
-  def connect(tbclk: Clock, tbreset: Bool, dutio: DMIIO, tbsuccess: Bool) = {
+  def connect(tbclk: Clock, tbreset: Bool, dutio: DMIIO, tbsuccess: Bool, wake: Bool) = {
     io.clk := tbclk
     io.reset := tbreset
     dutio <> io.debug
 
+    val poll = withClockAndReset(tbclk, tbreset) { Module(new SimDTMPoll) }
+    poll.io.interval := PlusArg("dtm_poll_interval", default = pollInterval,
+      docstring = "Cycles the idle DTM waits before it asks the host again (0: every cycle)")
+    poll.io.req_valid := io.debug.req.valid
+    poll.io.req_fire := io.debug.req.fire
+    poll.io.resp_fire := io.debug.resp.fire
+    poll.io.wake := wake
+    io.tick := poll.io.tick
+
     tbsuccess := io.exit === 1.U
     when (io.exit >= 2.U) {
       printf("*** FAILED *** (exit code = %d)\n", io.exit >> 1.U)
@@ -80,13 +104,54 @@ class SimDTM(implicit val conf: SodorCoreParams) extends BlackBox {
   }
 }
 
+object SimDTM {
+  // A store to tohost, which the host reads over DMI, or a debug request
+  def wake(dmem: MemPortIo, tohost: UInt, debugReq: Bool): Bool =
+    (dmem.req.fire && dmem.req.bits.fcn === M_XWR && dmem.req.bits.addr === tohost) || debugReq
+}
+
+// Decides on which cycles SimDTM calls into the host. With a non-zero
+// interval, it keeps ticking while a DMI request is queued or in flight; after
+// idleTicks idle ticks it goes dormant until `wake` or until interval cycles
+// have passed, then gives the host idleTicks more ticks to start a request. A
+// zero interval ticks every cycle. SimDTM.v holds a request between ticks, so
+// a request the host started in the tick that went dormant ticks it again:
+// the request can only be taken on a tick, when the host sees it accepted.
+class SimDTMPoll(idleTicks: Int = 16) extends Module {
+  val io = IO(new Bundle {
+    val interval = Input(UInt(32.W))
+    val req_valid = Input(Bool())
+    val req_fire = Input(Bool())
+    val resp_fire = Input(Bool())
+    val wake = Input(Bool())
+    val tick = Output(Bool())
+  })
+
+  val outstanding = RegInit(false.B)
+  val idle = RegInit(0.U(log2Ceil(idleTicks + 1).W))
+  val sleep = RegInit(0.U(32.W))
+
+  when (io.req_fire) { outstanding := true.B }
+  when (io.resp_fire) { outstanding := false.B }
+
+  io.tick := sleep === 0.U || io.wake || io.req_valid
+  when (io.tick) {
+    // What the host requests in this tick only shows up in the next one
+    val next_idle = Mux(io.req_valid || outstanding || idle === idleTicks.U, 0.U, idle + 1.U)
+    idle := next_idle
+    sleep := Mux(io.interval =/= 0.U && next_idle === idleTicks.U, io.interval, 0.U)
+  } .otherwise {
+    sleep := sleep - 1.U
+  }
+}
+
 class DebugDPath(implicit val conf: SodorCoreParams) extends Bundle
 {
   // REG access
   val addr = Output(UInt(5.W))
-  val wdata = Output(UInt(32.W))
+  val wdata = Output(UInt(conf.xprlen.W))
   val validreq = Output(Bool())
-  val rdata = Input(UInt(32.W))
+  val rdata = Input(UInt(conf.xprlen.W))
   val resetpc = Output(Bool())
 }
 
@@ -108,7 +173,6 @@ class DebugModule(implicit val conf: SodorCoreParams) extends Module {
   val io = IO(new DebugIo())
   io := DontCare
 
-  io.dmi.req.ready := io.dmi.req.valid
   val dmireq = io.dmi.req.valid
   io.dmi.resp.bits.resp := DMConsts.dmi_RESP_SUCCESS
   val dmstatusReset  = Wire(new DMSTATUSFields())
@@ -128,8 +192,15 @@ class DebugModule(implicit val conf: SodorCoreParams) extends Module {
   abstractcsReset := DontCare
   abstractcsReset.datacount := DMConsts.nDataCount.U
   abstractcsReset.progsize := DMConsts.nProgBuf.U
+  abstractcsReset.busy := false.B
+  abstractcsReset.cmderr := 0.U
   val abstractcs = RegInit(abstractcsReset)
   val command = Reg(new ACCESS_REGISTERFields())
+  val memcommand = Reg(new ACCESS_MEMORYFields())
+  val cmdtype = RegInit(0.U(8.W))
+  val abstractauto = RegInit(0.U.asTypeOf(new ABSTRACTAUTOFields()))
+  val aaminflight = RegInit(false.B)
+  val regreq = RegInit(false.B) // an Access Register command is to run
   val dmcontrol = Reg(new DMCONTROLFields())
   val progbuf = Reg(Vec(DMConsts.nProgBuf, UInt(conf.xprlen.W)))
   val data0 = Reg(UInt(conf.xprlen.W))  //arg0
@@ -144,9 +215,9 @@ class DebugModule(implicit val conf: SodorCoreParams) extends Module {
     DMI_RegAddrs.DMI_ABSTRACTCS -> abstractcs.asUInt,
     DMI_RegAddrs.DMI_DMCONTROL -> dmcontrol.asUInt,
     DMI_RegAddrs.DMI_DMSTATUS  -> dmstatus.asUInt,
-    DMI_RegAddrs.DMI_COMMAND -> command.asUInt,
+    DMI_RegAddrs.DMI_COMMAND -> Mux(cmdtype === DMConsts.cmd_ACCESS_MEMORY, memcommand.asUInt, command.asUInt),
     DMI_RegAddrs.DMI_HARTINFO -> DMConsts.hartInfo,
-    DMI_RegAddrs.DMI_ABSTRACTAUTO -> 0.U,
+    DMI_RegAddrs.DMI_ABSTRACTAUTO -> abstractauto.asUInt,
     DMI_RegAddrs.DMI_CFGSTRADDR0 -> 0.U,
     DMI_RegAddrs.DMI_DATA0 -> data0,
     (DMI_RegAddrs.DMI_DATA0 + 1) -> data1,
@@ -161,6 +232,16 @@ class DebugModule(implicit val conf: SodorCoreParams) extends Module {
     DMI_RegAddrs.DMI_SBADDRESS0 -> sbaddr,
     DMI_RegAddrs.DMI_SBDATA0 -> sbdata)
   val decoded_addr = read_map map { case (k, v) => k -> (io.dmi.req.bits.addr === k) }
+
+  // The debug memory port is shared by system bus accesses (SBDATA0) and
+  // Access Memory commands. A system bus access waits (the DMI request is
+  // not ready) while a command's access is in flight; a command waits while a
+  // system bus access uses the port or its response is due.
+  val sbwait = decoded_addr(DMI_RegAddrs.DMI_SBDATA0) && aaminflight
+  val sbreq = WireDefault(false.B)
+  val sbinflight = RegNext(sbreq, false.B)
+  val aamreq = Wire(Bool())
+  io.dmi.req.ready := io.dmi.req.valid && !sbwait
   io.dmi.resp.bits.data := Mux1H(for ((k, v) <- read_map) yield decoded_addr(k) -> v)
   val wdata = io.dmi.req.bits.data
   dmstatus.allhalted := dmcontrol.haltreq
@@ -169,20 +250,42 @@ class DebugModule(implicit val conf: SodorCoreParams) extends Module {
   when (io.dmi.req.bits.op === DMConsts.dmi_OP_WRITE){
     when((decoded_addr(DMI_RegAddrs.DMI_ABSTRACTCS)) && io.dmi.req.valid) {
       val tempabstractcs = wdata.asTypeOf(new ABSTRACTCSFields())
-      abstractcs.cmderr := tempabstractcs.cmderr
+      // cmderr is write-1-to-clear
+      abstractcs.cmderr := abstractcs.cmderr & ~tempabstractcs.cmderr
     }
-    when(decoded_addr(DMI_RegAddrs.DMI_COMMAND)) {
+    when(decoded_addr(DMI_RegAddrs.DMI_COMMAND) && io.dmi.req.valid) {
       val tempcommand = wdata.asTypeOf(new ACCESS_REGISTERFields())
-      when(tempcommand.size === 2.U){
+      val tempmemcommand = wdata.asTypeOf(new ACCESS_MEMORYFields())
+      when(abstractcs.busy) {
+        abstractcs.cmderr := 1.U
+      } .elsewhen(abstractcs.cmderr =/= 0.U) {
+        // commands are ignored until the debugger clears the error
+      } .elsewhen(tempcommand.cmdtype === DMConsts.cmd_ACCESS_MEMORY) {
+        // physical accesses of up to 32 bits, the width of the debug memory port
+        when(!tempmemcommand.aamvirtual && tempmemcommand.aamsize <= 2.U) {
+          memcommand := tempmemcommand
+          cmdtype := DMConsts.cmd_ACCESS_MEMORY
+          abstractcs.busy := true.B
+        } .otherwise {
+          abstractcs.cmderr := 2.U
+        }
+      } .elsewhen(tempcommand.cmdtype === DMConsts.cmd_ACCESS_REGISTER && tempcommand.size === 2.U){
         command.postexec := tempcommand.postexec
         command.regno := tempcommand.regno
         command.transfer := tempcommand.transfer
         command.write := tempcommand.write
-        abstractcs.cmderr := 1.U
+        cmdtype := DMConsts.cmd_ACCESS_REGISTER
+        abstractcs.busy := true.B
+        regreq := true.B
       } .otherwise {
         abstractcs.cmderr := 2.U
       }
     }
+    when(decoded_addr(DMI_RegAddrs.DMI_ABSTRACTAUTO)) {
+      val tempabstractauto = wdata.asTypeOf(new ABSTRACTAUTOFields())
+      // only data0 can trigger a command
+      abstractauto.autoexecdata := tempabstractauto.autoexecdata & 1.U
+    }
     when(decoded_addr(DMI_RegAddrs.DMI_DMCONTROL)) {
       val tempcontrol = wdata.asTypeOf(new DMCONTROLFields())
       dmcontrol.haltreq := tempcontrol.haltreq
@@ -203,29 +306,45 @@ class DebugModule(implicit val conf: SodorCoreParams) extends Module {
     when(decoded_addr(DMI_RegAddrs.DMI_SBDATA0)) {
       sbdata := wdata
       io.debugmem.req.bits.addr := sbaddr
-      io.debugmem.req.bits.data := sbdata
+      io.debugmem.req.bits.data := wdata
       io.debugmem.req.bits.fcn :=  M_XWR
-      io.debugmem.req.valid := io.dmi.req.valid
-      when(sbcs.sbautoincrement && io.dmi.req.valid)
+      io.debugmem.req.bits.typ := MT_WU
+      io.debugmem.req.valid := io.dmi.req.fire
+      sbreq := io.dmi.req.fire
+      when(sbcs.sbautoincrement && io.dmi.req.fire)
       {
         sbaddr := sbaddr + 4.U
       }
     }
-    when(decoded_addr(DMI_RegAddrs.DMI_DATA0)) ( data0 := wdata )
-    when(decoded_addr(DMI_RegAddrs.DMI_DATA0+1)) ( data1 := wdata )
+    when(decoded_addr(DMI_RegAddrs.DMI_DATA0) && !abstractcs.busy) ( data0 := wdata )
+    when(decoded_addr(DMI_RegAddrs.DMI_DATA0+1) && !abstractcs.busy) ( data1 := wdata )
     when(decoded_addr(DMI_RegAddrs.DMI_DATA0+2)) ( data2 := wdata )
   }
 
+  /// abstractauto: reading or writing data0 runs the last command again
+  val dataaccess = (decoded_addr(DMI_RegAddrs.DMI_DATA0) || decoded_addr(DMI_RegAddrs.DMI_DATA0+1)) &&
+    io.dmi.req.valid && io.dmi.req.bits.op =/= DMConsts.dmi_OP_NONE
+  when(dataaccess && abstractcs.busy) {
+    abstractcs.cmderr := 1.U
+  } .elsewhen(dataaccess && decoded_addr(DMI_RegAddrs.DMI_DATA0) && abstractauto.autoexecdata(0) && abstractcs.cmderr === 0.U) {
+    abstractcs.busy := true.B
+    regreq := cmdtype === DMConsts.cmd_ACCESS_REGISTER
+  }
+
   /// abstract cs command regfile access
   io.ddpath.addr := command.regno & "hfff".U
-  when(command.transfer && abstractcs.cmderr =/= 0.U){
-    when(command.write){
-      io.ddpath.wdata := data0
-      io.ddpath.validreq := true.B
-    } .otherwise {
-      data0 := io.ddpath.rdata
+  // runs in the cycle after the command is accepted
+  when(regreq){
+    when(command.transfer){
+      when(command.write){
+        io.ddpath.wdata := data0
+        io.ddpath.validreq := true.B
+      } .otherwise {
+        data0 := io.ddpath.rdata
+      }
     }
-    abstractcs.cmderr := 0.U
+    regreq := false.B
+    abstractcs.busy := false.B
   }
 
   when(!(decoded_addr(DMI_RegAddrs.DMI_SBDATA0) && io.dmi.req.bits.op === DMConsts.dmi_OP_WRITE)){
@@ -235,12 +354,17 @@ class DebugModule(implicit val conf: SodorCoreParams) extends Module {
 
   val firstreaddone = Reg(Bool())
 
-  io.dmi.resp.valid := Mux(firstreaddone, RegNext(io.debugmem.resp.valid), io.dmi.req.valid)
+  // responses on the port that belong to system bus accesses
+  val sbresp = io.debugmem.resp.valid && !aamreq && !aaminflight
 
-  when ((decoded_addr(DMI_RegAddrs.DMI_SBDATA0) && (io.dmi.req.bits.op === DMConsts.dmi_OP_READ)) || (sbcs.sbautoread && firstreaddone)){
+  io.dmi.resp.valid := Mux(firstreaddone, RegNext(sbresp), io.dmi.req.fire)
+
+  when (!sbwait && ((decoded_addr(DMI_RegAddrs.DMI_SBDATA0) && (io.dmi.req.bits.op === DMConsts.dmi_OP_READ)) || (sbcs.sbautoread && firstreaddone))){
     io.debugmem.req.bits.addr :=  sbaddr
     io.debugmem.req.bits.fcn := M_XRD
-    io.debugmem.req.valid := io.dmi.req.valid
+    io.debugmem.req.bits.typ := MT_WU
+    io.debugmem.req.valid := io.dmi.req.fire
+    sbreq := io.dmi.req.fire
     // for async data readily available
     // so capture it in reg
     when(io.debugmem.resp.valid){
@@ -250,7 +374,7 @@ class DebugModule(implicit val conf: SodorCoreParams) extends Module {
     firstreaddone := true.B
   }
 
-  when(memreadfire && io.debugmem.resp.valid)
+  when(memreadfire && sbresp)
   {  // following is for sync data available in
     // next cycle memreadfire a reg allows
     // entering this reg only in next
@@ -266,6 +390,31 @@ class DebugModule(implicit val conf: SodorCoreParams) extends Module {
     firstreaddone := false.B
   }
 
+  /// abstract cs command memory access
+  // arg0 (data0) holds the data and arg1 (data1) the address. With
+  // aampostincrement and autoexecdata a debugger streams memory with one DMI
+  // access of data0 per word, without involving the core.
+  aamreq := abstractcs.busy && cmdtype === DMConsts.cmd_ACCESS_MEMORY && !aaminflight && !sbreq && !sbinflight
+  when(aamreq) {
+    io.debugmem.req.valid := true.B
+    io.debugmem.req.bits.addr := data1
+    io.debugmem.req.bits.data := data0
+    io.debugmem.req.bits.fcn := Mux(memcommand.write, M_XWR, M_XRD)
+    io.debugmem.req.bits.setType(false.B, memcommand.aamsize(1, 0))
+    aaminflight := io.debugmem.req.ready
+  }
+  // the response comes in the same cycle from an async memory, in the next from a sync one
+  when((aamreq || aaminflight) && io.debugmem.resp.valid) {
+    when(!memcommand.write) {
+      data0 := io.debugmem.resp.bits.data
+    }
+    when(memcommand.aampostincrement) {
+      data1 := data1 + (1.U << memcommand.aamsize(1, 0))
+    }
+    abstractcs.busy := false.B
+    aaminflight := false.B
+  }
+
   io.resetcore := coreresetval
 
   when((io.dmi.req.bits.addr === "h44".U) && io.dmi.req.valid){
@@ -0,0 +1,230 @@
+//**************************************************************************
+// Tile-local DMA engine
+//--------------------------------------------------------------------------
+//
+// Copies blocks of memory between the tile-local scratchpad and off-tile
+// memory (or within either of them). Software writes a descriptor (source,
+// destination and length) into the control registers and pushes it into a
+// small descriptor queue; completion is observed by polling the status and
+// done-count registers or through an interrupt. A descriptor whose addresses
+// or length are not word aligned is skipped without copying anything: it
+// still counts as done, but sets the error bit of the status register.
+//
+// Scratchpad accesses go straight to the scratchpad port, arbitrated with the
+// external scratchpad adapter; everything else goes out on a TileLink master
+// port, as cache-block bursts whenever both addresses are block aligned.
+
+package sodor.common
+
+import chisel3._
+import chisel3.util._
+
+import org.chipsalliance.cde.config._
+import freechips.rocketchip.diplomacy._
+import freechips.rocketchip.interrupts._
+import freechips.rocketchip.regmapper._
+import freechips.rocketchip.subsystem._
+import freechips.rocketchip.tilelink._
+
+import Constants._
+
+object SodorDMAConsts {
+  val src    = 0x00 // source address
+  val dst    = 0x04 // destination address
+  val len    = 0x08 // length in bytes, a multiple of 4
+  val push   = 0x0c // write: enqueue {src, dst, len}; bit 0 requests an interrupt on completion
+  val status = 0x10 // read: {error, irq pending, queue full, busy}
+  val done   = 0x14 // read: number of completed descriptors
+  val ack    = 0x18 // write: bit 0 clears the pending interrupt, bit 1 the error
+  val size   = 0x1000
+}
+
+class SodorDMADescriptor extends Bundle {
+  val src = UInt(32.W)
+  val dst = UInt(32.W)
+  val len = UInt(32.W)
+  val irq = Bool()
+}
+
+class SodorDMA(address: BigInt, scratchpad: Seq[AddressSet], beatBytes: Int, nDescriptors: Int = 4)
+  (implicit p: Parameters, val conf: SodorCoreParams) extends LazyModule
+{
+  val blockBytes = p(CacheBlockBytes)
+
+  val device = new SimpleDevice("dma", Seq("ucb-bar,sodor-dma"))
+  val node = TLRegisterNode(
+    address = Seq(AddressSet(address, SodorDMAConsts.size - 1)),
+    device = device,
+    beatBytes = beatBytes)
+  val intnode = IntSourceNode(IntSourcePortSimple(num = 1, resources = device.int))
+  val masterNode = TLClientNode(Seq(TLMasterPortParameters.v1(
+    clients = Seq(TLMasterParameters.v1(
+      name = "sodor-dma",
+      sourceId = IdRange(0, 1)
+    ))
+  )))
+
+  lazy val module = new SodorDMAImp(this, scratchpad, nDescriptors)
+}
+
+class SodorDMAImp(outer: SodorDMA, scratchpad: Seq[AddressSet], nDescriptors: Int) extends LazyModuleImp(outer) {
+  implicit val conf = outer.conf
+  val io = IO(new Bundle {
+    val spad = new MemPortIo(data_width = 32)
+  })
+
+  val (tl, edge) = outer.masterNode.out(0)
+  val (int_out, _) = outer.intnode.out(0)
+
+  val beatBytes = edge.manager.beatBytes
+  val blockBytes = outer.blockBytes
+  val lgBlockBytes = log2Ceil(blockBytes)
+  val wordsPerBeat = beatBytes / 4
+  val blockWords = blockBytes / 4
+  require(blockBytes >= beatBytes, "DMA block must be at least one bus beat")
+
+  def inScratchpad(addr: UInt) = scratchpad.map(_.contains(addr)).reduce(_ || _)
+
+  // ===================
+  // Control registers
+  val src_reg = RegInit(0.U(32.W))
+  val dst_reg = RegInit(0.U(32.W))
+  val len_reg = RegInit(0.U(32.W))
+  val done_count = RegInit(0.U(32.W))
+  val irq_pending = RegInit(false.B)
+  val error = RegInit(false.B) // a descriptor was skipped as misaligned
+
+  val desc_q = Module(new Queue(new SodorDMADescriptor, nDescriptors))
+  desc_q.io.enq.valid := false.B
+  desc_q.io.enq.bits.src := src_reg
+  desc_q.io.enq.bits.dst := dst_reg
+  desc_q.io.enq.bits.len := len_reg
+  desc_q.io.enq.bits.irq := false.B
+
+  val s_idle :: s_read :: s_write :: s_ack :: Nil = Enum(4)
+  val state = RegInit(s_idle)
+  val busy = state =/= s_idle || desc_q.io.deq.valid
+
+  outer.node.regmap(
+    SodorDMAConsts.src -> Seq(RegField(32, src_reg, RegFieldDesc("src", "Source address"))),
+    SodorDMAConsts.dst -> Seq(RegField(32, dst_reg, RegFieldDesc("dst", "Destination address"))),
+    SodorDMAConsts.len -> Seq(RegField(32, len_reg, RegFieldDesc("len", "Length in bytes"))),
+    SodorDMAConsts.push -> Seq(RegField.w(32, RegWriteFn((valid, data) => {
+      desc_q.io.enq.valid := valid
+      desc_q.io.enq.bits.irq := data(0)
+      desc_q.io.enq.ready
+    }), RegFieldDesc("push", "Enqueue the descriptor in src/dst/len"))),
+    SodorDMAConsts.status -> Seq(RegField.r(4, Cat(error, irq_pending, !desc_q.io.enq.ready, busy),
+      RegFieldDesc("status", "{error, irq pending, queue full, busy}", volatile = true))),
+    SodorDMAConsts.done -> Seq(RegField.r(32, done_count,
+      RegFieldDesc("done", "Completed descriptors", volatile = true))),
+    SodorDMAConsts.ack -> Seq(RegField.w(2, RegWriteFn((valid, data) => {
+      when (valid && data(0)) { irq_pending := false.B }
+      when (valid && data(1)) { error := false.B }
+      true.B
+    }), RegFieldDesc("ack", "Clear the pending interrupt (bit 0) or the error (bit 1)")))
+  )
+  int_out(0) := irq_pending
+
+  // ===================
+  // Copy engine
+  // Each descriptor is processed as a sequence of chunks: a whole cache block
+  // when both addresses are block aligned and enough bytes are left, otherwise
+  // a single word. A chunk is read into the buffer, then written out.
+  val cur = Reg(new SodorDMADescriptor)
+  val buffer = Reg(Vec(blockWords, UInt(32.W)))
+  val chunk_block = Reg(Bool())
+  val chunk_words = Mux(chunk_block, blockWords.U, 1.U)
+  val chunk_size = Mux(chunk_block, lgBlockBytes.U, 2.U)
+  val req_count = RegInit(0.U(log2Ceil(blockWords + 1).W))
+  val resp_count = RegInit(0.U(log2Ceil(blockWords + 1).W))
+  val a_sent = RegInit(false.B)
+
+  def nextChunkIsBlock(src: UInt, dst: UInt, len: UInt) =
+    (src | dst)(lgBlockBytes - 1, 0) === 0.U && len >= blockBytes.U
+
+  desc_q.io.deq.ready := state === s_idle
+  val desc_misaligned = (desc_q.io.deq.bits.len | desc_q.io.deq.bits.src | desc_q.io.deq.bits.dst)(1, 0) =/= 0.U
+  when (desc_q.io.deq.fire) {
+    cur := desc_q.io.deq.bits
+    chunk_block := nextChunkIsBlock(desc_q.io.deq.bits.src, desc_q.io.deq.bits.dst, desc_q.io.deq.bits.len)
+    state := Mux(desc_q.io.deq.bits.len === 0.U || desc_misaligned, s_ack, s_read)
+    when (desc_misaligned) { error := true.B }
+  }
+
+  val src_local = inScratchpad(cur.src)
+  val dst_local = inScratchpad(cur.dst)
+
+  // Scratchpad side: one word per request, responses come back in order
+  val spad_read = state === s_read && src_local
+  val spad_write = state === s_write && dst_local
+  io.spad.req.valid := (spad_read || spad_write) && req_count < chunk_words
+  io.spad.req.bits.addr := Mux(spad_read, cur.src, cur.dst) + (req_count << 2)
+  io.spad.req.bits.data := buffer(req_count)
+  io.spad.req.bits.fcn := Mux(spad_read, M_XRD, M_XWR)
+  io.spad.req.bits.typ := MT_WU
+  when (io.spad.req.fire) { req_count := req_count + 1.U }
+  when (io.spad.resp.valid) {
+    when (spad_read) { buffer(resp_count) := io.spad.resp.bits.data }
+    resp_count := resp_count + 1.U
+  }
+  val spad_done = (spad_read || spad_write) && resp_count === chunk_words
+
+  // Bus side: one Get or one Put burst per chunk
+  val bus_read = state === s_read && !src_local
+  val bus_write = state === s_write && !dst_local
+  val (_, _, a_done, a_beat) = edge.count(tl.a)
+  val (_, _, d_done, d_beat) = edge.count(tl.d)
+  def wordLane(addr: UInt) = if (wordsPerBeat > 1) addr(log2Ceil(beatBytes) - 1, 2) else 0.U
+  val put_data = Mux(chunk_block,
+    VecInit((0 until blockWords by wordsPerBeat).map(i => Cat(buffer.slice(i, i + wordsPerBeat).reverse)))(a_beat),
+    (buffer(0) << (wordLane(cur.dst) << 5))(beatBytes * 8 - 1, 0))
+  val (_, get_bundle) = edge.Get(0.U, cur.src, chunk_size)
+  val (_, put_bundle) = edge.Put(0.U, cur.dst, chunk_size, put_data)
+  tl.a.valid := (bus_read || bus_write) && !a_sent
+  tl.a.bits := Mux(bus_read, get_bundle, put_bundle)
+  tl.d.ready := true.B
+  when (tl.a.fire && a_done) { a_sent := true.B }
+
+  when (tl.d.fire && edge.hasData(tl.d.bits)) {
+    val words = (0 until wordsPerBeat).map(i => tl.d.bits.data(32 * i + 31, 32 * i))
+    when (chunk_block) {
+      for (i <- 0 until wordsPerBeat) { buffer((d_beat << log2Ceil(wordsPerBeat)) + i.U) := words(i) }
+    } .otherwise {
+      buffer(0) := VecInit(words)(wordLane(cur.src))
+    }
+  }
+  val bus_done = (bus_read || bus_write) && tl.d.fire && d_done
+
+  // Advance
+  when (state === s_read && (spad_done || bus_done)) {
+    state := s_write
+    req_count := 0.U
+    resp_count := 0.U
+    a_sent := false.B
+  }
+  when (state === s_write && (spad_done || bus_done)) {
+    val bytes = chunk_words << 2
+    val next_src = cur.src + bytes
+    val next_dst = cur.dst + bytes
+    val next_len = cur.len - bytes
+    cur.src := next_src
+    cur.dst := next_dst
+    cur.len := next_len
+    chunk_block := nextChunkIsBlock(next_src, next_dst, next_len)
+    state := Mux(next_len === 0.U, s_ack, s_read)
+    req_count := 0.U
+    resp_count := 0.U
+    a_sent := false.B
+  }
+  when (state === s_ack) {
+    done_count := done_count + 1.U
+    when (cur.irq) { irq_pending := true.B }
+    state := s_idle
+  }
+
+  // Tie off unused channels
+  tl.b.ready := true.B
+  tl.c.valid := false.B
+  tl.e.valid := false.B
+}
@@ -0,0 +1,178 @@
+//**************************************************************************
+// DRAM timing model
+//--------------------------------------------------------------------------
+//
+// Sits on the tile's master path and times every access to off-chip memory
+// (the ExtMem region) as a simple DRAM channel would: the address picks a bank
+// and a row (rows are interleaved across the banks), each bank keeps its last
+// row open, and an access costs tCAS on a row hit, tRCD + tCAS on a closed
+// bank and tRP + tRCD + tCAS on a row conflict. Data then moves over a bus
+// shared by all banks at bytesPerCycle. Requests are served in arrival order;
+// at most queueDepth are in flight and further ones wait on the A channel.
+//
+// The requests themselves still go to the backing memory right away; the
+// model only holds back the response until the modeled access is done, so the
+// latency seen is the larger of the two. Pair it with a fast backing memory.
+// Accesses elsewhere (MMIO) pass through untimed. Simulation only: queueing,
+// row-buffer and bus statistics are printed when the emulator exits (see
+// SodorDRAMStats.v).
+
+package sodor.common
+
+import chisel3._
+import chisel3.util._
+import chisel3.experimental._
+
+import org.chipsalliance.cde.config._
+import freechips.rocketchip.diplomacy._
+import freechips.rocketchip.tilelink._
+
+case class SodorDRAMParams(
+  nBanks: Int = 8,
+  rowBytes: Int = 2048,
+  tCAS: Int = 14, // cycles from column command to data on a row hit
+  tRCD: Int = 14, // cycles to open a row
+  tRP: Int = 14, // cycles to close (precharge) the open row
+  bytesPerCycle: Int = 8, // peak bandwidth of the data bus
+  queueDepth: Int = 8 // requests in flight
+) {
+  require(isPow2(nBanks) && isPow2(rowBytes) && isPow2(bytesPerCycle), "DRAM geometry must be powers of two.")
+  require(queueDepth > 0)
+}
+
+class SodorDRAMStats(name: String) extends BlackBox(Map("NAME" -> StringParam(name))) with HasBlackBoxResource {
+  val io = IO(new Bundle {
+    val clock = Input(Clock())
+    val reset = Input(Bool())
+    val reads = Input(UInt(64.W))
+    val writes = Input(UInt(64.W))
+    val bytes = Input(UInt(64.W))
+    val row_hits = Input(UInt(64.W))
+    val row_empty = Input(UInt(64.W))
+    val row_conflicts = Input(UInt(64.W))
+    val queue_cycles = Input(UInt(64.W)) // summed over requests: cycles waiting for a bank or the bus
+    val max_queue = Input(UInt(64.W))
+    val latency_cycles = Input(UInt(64.W)) // summed over requests: arrival to end of the data transfer
+    val full_cycles = Input(UInt(64.W)) // cycles a request waited because queueDepth were in flight
+    val busy_cycles = Input(UInt(64.W)) // cycles the data bus was transferring
+    val cycles = Input(UInt(64.W))
+  })
+  addResource("/sodor/vsrc/SodorDRAMStats.v")
+}
+
+class SodorDRAMModel(params: SodorDRAMParams, dram: Seq[AddressSet], name: String)(implicit p: Parameters) extends LazyModule {
+  val node = TLAdapterNode()
+
+  lazy val module = new LazyModuleImp(this) {
+    require(node.in.size == 1, "The DRAM model times a single master port.")
+    val (in, edgeIn) = node.in(0)
+    val (out, _) = node.out(0)
+    out <> in
+
+    val base = dram.map(_.base).min
+    val colBits = log2Ceil(params.rowBytes)
+    val bankBits = log2Ceil(params.nBanks)
+
+    val now = RegInit(0.U(64.W))
+    now := now + 1.U
+
+    // Requests in flight, found again by their source when the response comes back
+    class Entry extends Bundle {
+      val source = UInt(edgeIn.bundle.sourceBits.W)
+      val done = UInt(64.W)
+    }
+    val entries = Reg(Vec(params.queueDepth, new Entry))
+    val valid = RegInit(VecInit(Seq.fill(params.queueDepth)(false.B)))
+    val free = PriorityEncoder(valid.map(!_))
+    val full = valid.asUInt.andR
+
+    // Bank state
+    val open = RegInit(VecInit(Seq.fill(params.nBanks)(false.B)))
+    val openRow = Reg(Vec(params.nBanks, UInt(64.W)))
+    val bankFree = RegInit(VecInit(Seq.fill(params.nBanks)(0.U(64.W))))
+    val busFree = RegInit(0.U(64.W))
+
+    // A: time the first beat of each DRAM access when it is accepted
+    val a_timed = dram.map(_.contains(in.a.bits.address)).reduce(_ || _) && edgeIn.first(in.a)
+    val a_stall = a_timed && full
+    out.a.valid := in.a.valid && !a_stall
+    in.a.ready := out.a.ready && !a_stall
+
+    val offset = in.a.bits.address - base.U
+    val bank = if (bankBits == 0) 0.U else (offset >> colBits)(bankBits - 1, 0)
+    val row = offset >> (colBits + bankBits)
+    val hit = open(bank) && openRow(bank) === row
+    val access = Mux(hit, params.tCAS.U,
+                 Mux(open(bank), (params.tRP + params.tRCD + params.tCAS).U,
+                                 (params.tRCD + params.tCAS).U))
+    val bytes = 1.U(64.W) << in.a.bits.size
+    val xfer = ((bytes + (params.bytesPerCycle - 1).U) >> log2Ceil(params.bytesPerCycle)).asUInt
+    val start = Mux(bankFree(bank) > now, bankFree(bank), now)
+    val ready = start + access
+    val dataStart = Mux(busFree > ready, busFree, ready)
+    val done = dataStart + xfer
+
+    val a_fire = in.a.fire && a_timed
+    when (a_fire) {
+      valid(free) := true.B
+      entries(free).source := in.a.bits.source
+      entries(free).done := done
+      open(bank) := true.B
+      openRow(bank) := row
+      bankFree(bank) := ready
+      busFree := done
+    }
+
+    // D: hold the response until its access is done
+    val d_match = valid.zip(entries).map { case (v, e) => v && e.source === out.d.bits.source }
+    val d_wait = Mux1H(d_match, entries.map(_.done)) > now && d_match.reduce(_ || _)
+    in.d.valid := out.d.valid && !d_wait
+    out.d.ready := in.d.ready && !d_wait
+    when (in.d.fire && edgeIn.last(in.d)) {
+      d_match.zipWithIndex.foreach { case (m, i) => when (m) { valid(i) := false.B } }
+    }
+
+    // Statistics
+    val reads = RegInit(0.U(64.W))
+    val writes = RegInit(0.U(64.W))
+    val total_bytes = RegInit(0.U(64.W))
+    val row_hits = RegInit(0.U(64.W))
+    val row_empty = RegInit(0.U(64.W))
+    val row_conflicts = RegInit(0.U(64.W))
+    val queue_cycles = RegInit(0.U(64.W))
+    val max_queue = RegInit(0.U(64.W))
+    val latency_cycles = RegInit(0.U(64.W))
+    val full_cycles = RegInit(0.U(64.W))
+    val busy_cycles = RegInit(0.U(64.W))
+
+    val queued = (start - now) + (dataStart - ready)
+    when (a_fire) {
+      when (edgeIn.hasData(in.a.bits)) { writes := writes + 1.U } .otherwise { reads := reads + 1.U }
+      total_bytes := total_bytes + bytes
+      when (hit) { row_hits := row_hits + 1.U }
+      .elsewhen (open(bank)) { row_conflicts := row_conflicts + 1.U }
+      .otherwise { row_empty := row_empty + 1.U }
+      queue_cycles := queue_cycles + queued
+      when (queued > max_queue) { max_queue := queued }
+      latency_cycles := latency_cycles + (done - now)
+      busy_cycles := busy_cycles + xfer
+    }
+    when (in.a.valid && a_stall) { full_cycles := full_cycles + 1.U }
+
+    val stats = Module(new SodorDRAMStats(name))
+    stats.io.clock := clock
+    stats.io.reset := reset.asBool
+    stats.io.reads := reads
+    stats.io.writes := writes
+    stats.io.bytes := total_bytes
+    stats.io.row_hits := row_hits
+    stats.io.row_empty := row_empty
+    stats.io.row_conflicts := row_conflicts
+    stats.io.queue_cycles := queue_cycles
+    stats.io.max_queue := max_queue
+    stats.io.latency_cycles := latency_cycles
+    stats.io.full_cycles := full_cycles
+    stats.io.busy_cycles := busy_cycles
+    stats.io.cycles := now
+  }
+}
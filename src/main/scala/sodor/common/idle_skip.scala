@@ -0,0 +1,118 @@
+//**************************************************************************
+// Idle fast-forward
+//--------------------------------------------------------------------------
+//
+// While the hart sleeps in WFI nothing happens until an interrupt arrives, and
+// in firmware that waits on the timer the emulator spends most of its time
+// ticking through such idle cycles. Instead, once the hart has been asleep for
+// a few cycles, this unit reads the hart's mtimecmp and mtime from the CLINT
+// and, if the timer is armed, sets mtime to mtimecmp: the CLINT raises the
+// timer interrupt right away and the hart wakes up as if it had slept until
+// then. Software, external and debug interrupts wake the hart as usual.
+//
+// The unit sits on the core's data port and uses it while the hart sleeps;
+// otherwise the core's requests pass through untouched. mtime is written low
+// word first (0, high, low) so that no carry gets in between the writes. The
+// skipped time is not counted in mcycle. Simulation only: the time the hart
+// sees jumps forward. mtime is shared by all harts, so this only works with a
+// single hart (WithSodorIdleSkip checks that there is one Sodor tile).
+
+package sodor.common
+
+import chisel3._
+import chisel3.util._
+
+import org.chipsalliance.cde.config._
+import freechips.rocketchip.devices.tilelink.{CLINTConsts, CLINTKey}
+
+import Constants._
+
+class SodorIdleSkip(clintBase: BigInt, settleCycles: Int = 16)(implicit val conf: SodorCoreParams) extends Module {
+  val io = IO(new Bundle {
+    val core = Flipped(new MemPortIo(data_width = conf.xprlen))
+    val mem = new MemPortIo(data_width = conf.xprlen)
+    val asleep = Input(Bool())
+    val hartid = Input(UInt())
+  })
+
+  val s_awake :: s_cmp_lo :: s_cmp_hi :: s_time_lo :: s_time_hi :: s_check :: s_zero_lo :: s_set_hi :: s_set_lo :: s_asleep :: Nil = Enum(10)
+  val state = RegInit(s_awake)
+  val waiting = RegInit(false.B)
+  val settle = RegInit(0.U(log2Ceil(settleCycles + 1).W))
+  val cmp = Reg(Vec(2, UInt(32.W)))
+  val time = Reg(Vec(2, UInt(32.W)))
+
+  val timecmp_addr = clintBase.U + CLINTConsts.timecmpOffset(0).U + (io.hartid << 3)
+  val time_addr = (clintBase + CLINTConsts.timeOffset).U
+
+  // The accesses of each state
+  val addr = MuxLookup(state, time_addr)(Seq(
+    s_cmp_lo -> timecmp_addr,
+    s_cmp_hi -> (timecmp_addr + 4.U),
+    s_time_hi -> (time_addr + 4.U),
+    s_set_hi -> (time_addr + 4.U)))
+  val data = MuxLookup(state, 0.U)(Seq(
+    s_set_hi -> cmp(1),
+    s_set_lo -> cmp(0)))
+  val write = state === s_zero_lo || state === s_set_hi || state === s_set_lo
+  val access = !(state === s_awake || state === s_check || state === s_asleep)
+
+  val req = Wire(new MemReq(conf.xprlen))
+  req.addr := addr
+  req.data := data
+  req.fcn := Mux(write, M_XWR, M_XRD)
+  req.typ := Mux(write, MT_W, MT_WU)
+
+  // The core has the port unless an access is under way
+  val busy = state =/= s_awake && state =/= s_asleep
+  io.mem.req.valid := Mux(busy, access && !waiting, io.core.req.valid)
+  io.mem.req.bits := Mux(busy, req, io.core.req.bits)
+  io.core.req.ready := !busy && io.mem.req.ready
+  io.core.resp.valid := !busy && io.mem.resp.valid
+  io.core.resp.bits := io.mem.resp.bits
+
+  when (access && io.mem.req.fire) {
+    waiting := true.B
+  }
+  val done = access && (waiting || io.mem.req.fire) && io.mem.resp.valid
+  when (done) {
+    waiting := false.B
+    state := state + 1.U
+  }
+  val rdata = io.mem.resp.bits.data(31, 0)
+  when (done && state === s_cmp_lo)  { cmp(0) := rdata }
+  when (done && state === s_cmp_hi)  { cmp(1) := rdata }
+  when (done && state === s_time_lo) { time(0) := rdata }
+  when (done && state === s_time_hi) { time(1) := rdata }
+
+  // Jump only forward, to an armed timer (all ones disarms it), and only if
+  // the hart is still asleep: after the first write the sequence completes.
+  when (state === s_check) {
+    val later = cmp.asUInt > time.asUInt && !cmp.asUInt.andR
+    state := Mux(later && io.asleep, s_zero_lo, s_asleep)
+  }
+
+  when (state === s_awake) {
+    settle := Mux(io.asleep, settle + (settle =/= settleCycles.U), 0.U)
+    when (io.asleep && settle === settleCycles.U) {
+      state := s_cmp_lo
+    }
+  }
+  when (state === s_asleep && !io.asleep) {
+    state := s_awake
+    settle := 0.U
+  }
+}
+
+object SodorIdleSkip {
+  // Returns the data port to connect in place of the core's
+  def apply(dmem: MemPortIo, asleep: Bool, hartid: UInt)(implicit p: Parameters, conf: SodorCoreParams): MemPortIo = {
+    val clint = p(CLINTKey)
+    require(clint.isDefined, "Idle fast-forward needs a CLINT")
+    val skip = Module(new SodorIdleSkip(clint.get.baseAddress))
+    skip.io.core <> dmem
+    skip.io.asleep := asleep
+    skip.io.hartid := hartid
+    skip.io.mem
+  }
+}
@@ -19,12 +19,12 @@ object Instructions {
   def LUI                = BitPat("b?????????????????????????0110111")
   def AUIPC              = BitPat("b?????????????????????????0010111")
   def ADDI               = BitPat("b?????????????????000?????0010011")
-  //def SLLI               = BitPat("b000000???????????001?????0010011")
+  def SLLI               = BitPat("b000000???????????001?????0010011")
   def SLTI               = BitPat("b?????????????????010?????0010011")
   def SLTIU              = BitPat("b?????????????????011?????0010011")
   def XORI               = BitPat("b?????????????????100?????0010011")
-  //def SRLI               = BitPat("b000000???????????101?????0010011")
-  //def SRAI               = BitPat("b010000???????????101?????0010011")
+  def SRLI               = BitPat("b000000???????????101?????0010011")
+  def SRAI               = BitPat("b010000???????????101?????0010011")
   def ORI                = BitPat("b?????????????????110?????0010011")
   def ANDI               = BitPat("b?????????????????111?????0010011")
   def ADD                = BitPat("b0000000??????????000?????0110011")
@@ -76,6 +76,8 @@ object Instructions {
   def SC_W               = BitPat("b00011????????????010?????0101111")
   def LR_D               = BitPat("b00010??00000?????011?????0101111")
   def SC_D               = BitPat("b00011????????????011?????0101111")
+  def CZERO_EQZ          = BitPat("b0000111??????????101?????0110011")
+  def CZERO_NEZ          = BitPat("b0000111??????????111?????0110011")
   def ECALL              = BitPat("b00000000000000000000000001110011")
   def EBREAK             = BitPat("b00000000000100000000000001110011")
   def URET               = BitPat("b00000000001000000000000001110011")
@@ -16,7 +16,7 @@ import freechips.rocketchip.util._
 import freechips.rocketchip.tile._
 import freechips.rocketchip.amba.axi4._
 
-class SodorMasterAdapter(implicit p: Parameters, val conf: SodorCoreParams) extends LazyModule {
+class SodorMasterAdapter(writeCombine: Option[Int] = None)(implicit p: Parameters, val conf: SodorCoreParams) extends LazyModule {
   // The node exposed to the crossbar
   val node = TLIdentityNode()
 
@@ -32,21 +32,24 @@ class SodorMasterAdapter(implicit p: Parameters, val conf: SodorCoreParams) exte
   // Connect nodes
   (node := TLBuffer() := masterNode)
 
-  lazy val module = new SodorMasterAdapterImp(this)
+  lazy val module = new SodorMasterAdapterImp(this, writeCombine)
 }
 
-class SodorMasterAdapterImp(outer: SodorMasterAdapter) extends LazyModuleImp(outer) {
+class SodorMasterAdapterImp(outer: SodorMasterAdapter, writeCombine: Option[Int]) extends LazyModuleImp(outer) {
   implicit val conf = outer.conf
 
   val io = IO(new Bundle() {
     val dport = Flipped(new MemPortIo(data_width = conf.xprlen))
+    val fence = Input(Bool()) // the core is executing a FENCE or FENCE.I
+    val fence_busy = Output(Bool()) // draining the write-combining buffer for it
   })
+  io.fence_busy := false.B
 
   val (tl_out, edge) = outer.masterNode.out(0)
 
   // Register
   // State
-  val s_ready :: s_active :: s_inflight :: Nil = Enum(3)
+  val s_ready :: s_active :: s_inflight :: s_ack :: s_flush :: Nil = Enum(5)
   val state = RegInit(s_ready)
   // Address and signedness of the request to be used by LoadGen
   val a_address_reg = Reg(UInt(io.dport.req.bits.addr.getWidth.W))
@@ -55,16 +58,25 @@ class SodorMasterAdapterImp(outer: SodorMasterAdapter) extends LazyModuleImp(out
   val req_address_reg = Reg(UInt(io.dport.req.bits.addr.getWidth.W))
   val req_size_reg = Reg(UInt(2.W))
   val req_data_reg = Reg(UInt(io.dport.req.bits.data.getWidth.W))
+  val req_signed_reg = Reg(Bool())
+  val req_fcn_reg = Reg(UInt(M_X.getWidth.W))
   // Sign and size
   val a_signed = io.dport.req.bits.getTLSigned
   val a_size = io.dport.req.bits.getTLSize
 
+  // Write combining (see below): the request is a store merged into the
+  // buffer, or must wait until the buffer has been written out
+  val wc_merge = WireDefault(false.B)
+  val wc_flush = WireDefault(false.B)
+
   // State logic
-  when (state === s_ready && io.dport.req.valid) {
-    state := s_active
+  when (state === s_ready && io.dport.req.valid && !wc_flush) {
+    state := Mux(wc_merge, s_ack, s_active)
     req_address_reg := io.dport.req.bits.addr
     req_size_reg := a_size
     req_data_reg := io.dport.req.bits.data
+    req_signed_reg := a_signed
+    req_fcn_reg := io.dport.req.bits.fcn
   }
   when (state === s_active && tl_out.a.fire) {
     state := s_inflight
@@ -72,35 +84,124 @@ class SodorMasterAdapterImp(outer: SodorMasterAdapter) extends LazyModuleImp(out
   when (state === s_inflight && tl_out.d.fire) {
     state := s_ready
   }
+  when (state === s_ack) {
+    state := s_ready
+  }
   tl_out.a.valid := state === s_active
   tl_out.d.ready := true.B
-  io.dport.req.ready := state === s_ready
-  io.dport.resp.valid := tl_out.d.valid
+  io.dport.req.ready := state === s_ready && !wc_flush
+  io.dport.resp.valid := (state === s_inflight && tl_out.d.valid) || state === s_ack
 
   // Bookkeeping
   when (tl_out.a.fire) {
-    a_address_reg := io.dport.req.bits.addr
-    a_signed_reg := a_size
+    a_address_reg := req_address_reg
+    a_signed_reg := req_signed_reg
   }
 
   // Build "Get" message
   val (legal_get, get_bundle) = edge.Get(0.U, req_address_reg, req_size_reg)
   // Build "Put" message
-  val (legal_put, put_bundle) = edge.Put(0.U, req_address_reg, req_size_reg, req_data_reg)
+  // The bus may be wider than the core: replicate the store data over every byte lane
+  val put_data = new StoreGen(req_size_reg, req_address_reg, req_data_reg, edge.manager.beatBytes).data
+  val (legal_put, put_bundle) = edge.Put(0.U, req_address_reg, req_size_reg, put_data)
 
   // Connect Channel A bundle
-  tl_out.a.bits := Mux(io.dport.req.bits.fcn === M_XRD, get_bundle, put_bundle)
+  tl_out.a.bits := Mux(req_fcn_reg === M_XRD, get_bundle, put_bundle)
 
   // Connect Channel D bundle (read result)
-  io.dport.resp.bits.data := new LoadGen(tl_out.d.bits.size, a_signed_reg, a_address_reg, tl_out.d.bits.data, false.B, conf.xprlen / 8).data
+  // Select the requested bytes out of the (possibly wider) bus beat
+  io.dport.resp.bits.data := new LoadGen(tl_out.d.bits.size, a_signed_reg, a_address_reg, tl_out.d.bits.data, false.B, edge.manager.beatBytes).data(conf.xprlen - 1, 0)
 
   // Handle error
-  val legal_op = Mux(io.dport.req.bits.fcn === M_XRD, legal_get, legal_put)
+  val legal_op = Mux(req_fcn_reg === M_XRD, legal_get, legal_put)
   val resp_xp = tl_out.d.bits.corrupt | tl_out.d.bits.denied
   // Since the core doesn't have an external exception port, we have to kill it
-  assert(legal_op | !tl_out.a.valid, "Illegal operation")
+  assert(legal_op | state =/= s_active, "Illegal operation")
   assert(!resp_xp | !tl_out.d.valid, "Responds exception")
 
+  // Write-combining buffer
+  // Stores to off-chip memory are acknowledged right away and merged into a
+  // one-line buffer, which is written out as a masked PutPartial burst of the
+  // whole line. The buffer drains after `timeout` cycles without a store, and
+  // before a store to another line, a load of the buffered line or any MMIO
+  // access, so that the hart sees its own stores in order and MMIO stays
+  // ordered behind them. Loads of other lines pass it, as RVWMO allows.
+  // A FENCE or FENCE.I drains it too, and the tile holds the core's later
+  // requests (fetches included) until the line has been written.
+  writeCombine.foreach { timeout =>
+    val blockBytes = p(CacheBlockBytes)
+    val beatBytes = edge.manager.beatBytes
+    val nBeats = blockBytes / beatBytes
+    val lgBlock = log2Ceil(blockBytes)
+    val mem = p(ExtMem)
+    require(mem.isDefined, "Write combining needs an off-chip memory (ExtMem).")
+    val memory = AddressSet.misaligned(mem.get.master.base, mem.get.master.size)
+
+    val wc_valid = RegInit(false.B)
+    val wc_line = Reg(UInt(conf.xprlen.W))
+    val wc_data = Reg(Vec(blockBytes, UInt(8.W)))
+    val wc_mask = RegInit(VecInit(Seq.fill(blockBytes)(false.B)))
+    val wc_idle = RegInit(0.U(log2Ceil(timeout + 1).W))
+    val wc_fence = RegInit(false.B)
+
+    val req = io.dport.req.bits
+    val combinable = memory.map(_.contains(req.addr)).reduce(_ || _)
+    val same_line = wc_valid && (req.addr >> lgBlock) === wc_line
+    val wc_store = req.fcn === M_XWR && combinable
+    wc_merge := wc_store
+    wc_flush := wc_valid && Mux(wc_store, !same_line, !combinable || same_line)
+
+    val gen = new StoreGen(a_size, req.addr, req.data.pad(8 * blockBytes), blockBytes)
+    when (state === s_ready && io.dport.req.valid && !wc_flush && wc_store) {
+      wc_valid := true.B
+      wc_line := req.addr >> lgBlock
+      for (i <- 0 until blockBytes) {
+        when (gen.mask(i)) {
+          wc_data(i) := gen.data(8 * i + 7, 8 * i)
+          wc_mask(i) := true.B
+        }
+      }
+      wc_idle := 0.U
+    } .elsewhen (wc_valid && wc_idle =/= timeout.U) {
+      wc_idle := wc_idle + 1.U
+    }
+
+    // A fence is signalled while it executes; its later requests are held
+    // from the next cycle on, for as long as the buffer is not empty
+    wc_fence := (wc_fence || io.fence) && wc_valid
+    io.fence_busy := wc_fence
+
+    when (state === s_ready && wc_valid && Mux(io.dport.req.valid, wc_flush, wc_idle === timeout.U || io.fence || wc_fence)) {
+      state := s_flush
+    }
+
+    // Flush: all beats of the line, then wait for the ack (which may come
+    // before the last beat)
+    val beat = RegInit(0.U(log2Ceil(nBeats).max(1).W))
+    val sent = RegInit(false.B)
+    val acked = RegInit(false.B)
+    val beat_data = VecInit((0 until nBeats).map(i => VecInit(wc_data.slice(i * beatBytes, (i + 1) * beatBytes)).asUInt))
+    val beat_mask = VecInit((0 until nBeats).map(i => VecInit(wc_mask.slice(i * beatBytes, (i + 1) * beatBytes)).asUInt))
+    val (legal_flush, flush_bundle) = edge.Put(0.U, wc_line << lgBlock, lgBlock.U, beat_data(beat), beat_mask(beat))
+    assert(legal_flush | state =/= s_flush, "Write-combining flush is not a legal PutPartial")
+
+    when (state === s_flush) {
+      tl_out.a.valid := !sent
+      tl_out.a.bits := flush_bundle
+      val last = tl_out.a.fire && beat === (nBeats - 1).U
+      when (tl_out.a.fire) { beat := Mux(last, 0.U, beat + 1.U) }
+      when (last) { sent := true.B }
+      when (tl_out.d.fire) { acked := true.B }
+      when ((sent || last) && (acked || tl_out.d.fire)) {
+        state := s_ready
+        wc_valid := false.B
+        wc_mask.foreach(_ := false.B)
+        sent := false.B
+        acked := false.B
+      }
+    }
+  }
+
   // Tie off unused channels
   tl_out.b.valid := false.B
   tl_out.c.ready := true.B
@@ -117,3 +218,29 @@ class SameCycleRequestBuffer(implicit val conf: SodorCoreParams) extends Module
   io.out.req <> io.in.req
   io.in.resp := Pipe(io.out.resp)
 }
+
+// Holds the core's new requests while the master port drains the
+// write-combining buffer for a fence. Requests already taken still get their
+// responses.
+class SodorFenceHold(implicit val conf: SodorCoreParams) extends Module {
+  val io = IO(new Bundle() {
+    val core = Flipped(new MemPortIo(data_width = conf.xprlen))
+    val mem = new MemPortIo(data_width = conf.xprlen)
+    val busy = Input(Bool())
+  })
+
+  io.mem.req.valid := io.core.req.valid && !io.busy
+  io.mem.req.bits := io.core.req.bits
+  io.core.req.ready := io.mem.req.ready && !io.busy
+  io.core.resp := io.mem.resp
+}
+
+object SodorFenceHold {
+  // Returns the port to connect in place of the core's
+  def apply(port: MemPortIo, busy: Bool)(implicit conf: SodorCoreParams): MemPortIo = {
+    val hold = Module(new SodorFenceHold)
+    hold.io.core <> port
+    hold.io.busy := busy
+    hold.io.mem
+  }
+}
@@ -67,21 +67,34 @@ class MemResp(data_width: Int) extends Bundle
    val data = Output(UInt(data_width.W))
 }
 
+// Common interface of the storage behind the scratchpad
+// Note: All `size` field in this trait are base 2 logarithm
+trait MemoryBackend {
+   def read(addr: UInt, size: UInt, signed: Bool): UInt
+   def write(addr: UInt, data: UInt, size: UInt, en: Bool): Unit
+   def apply(addr: UInt, size: UInt, signed: Bool) = read(addr, size, signed)
+}
+
 // Note: All `size` field in this class are base 2 logarithm
-class MemoryModule(numBytes: Int, useAsync: Boolean) {
+// The array is made of wordBytes-wide words: 4 for RV32, 8 for RV64.
+class MemoryModule(numBytes: Int, useAsync: Boolean, wordBytes: Int = 4) extends MemoryBackend {
+   require(isPow2(wordBytes) && wordBytes >= 4, "Scratchpad words must be 4 or more bytes (power of 2)")
    val addrWidth = log2Ceil(numBytes)
-   val mem = if (useAsync) Mem(numBytes / 4, Vec(4, UInt(8.W))) else SyncReadMem(numBytes / 4, Vec(4, UInt(8.W)))
+   val offsetWidth = log2Ceil(wordBytes)
+   val wordWidth = wordBytes * 8
+   val mem = if (useAsync) Mem(numBytes / wordBytes, Vec(wordBytes, UInt(8.W))) else SyncReadMem(numBytes / wordBytes, Vec(wordBytes, UInt(8.W)))
 
    // Convert size exponent to actual number of bytes - 1
-   private def sizeToBytes(size: UInt) = MuxLookup(size, 3.U)(List(0.U -> 0.U, 1.U -> 1.U, 2.U -> 3.U))
+   private def sizeToBytes(size: UInt) = MuxLookup(size, (wordBytes - 1).U)(
+      (0 until offsetWidth).map(i => i.U -> ((1 << i) - 1).U))
 
    private def getMask(bytes: UInt, storeOffset: UInt = 0.U) = {
-      val mask = ("b00011111".U(8.W) << bytes).apply(7, 4)
-      val maskWithOffset = (mask << storeOffset).apply(3, 0)
+      val mask = (Fill(wordBytes + 1, 1.U) << bytes).apply(2 * wordBytes - 1, wordBytes)
+      val maskWithOffset = (mask << storeOffset).apply(wordBytes - 1, 0)
       maskWithOffset.asBools.reverse
    }
 
-   private def splitWord(data: UInt) = VecInit(((data(31, 0).asBools.reverse grouped 8) map (bools => Cat(bools))).toSeq)
+   private def splitWord(data: UInt) = VecInit(((data(wordWidth - 1, 0).asBools.reverse grouped 8) map (bools => Cat(bools))).toSeq)
 
    // Read function
    def read(addr: UInt, size: UInt, signed: Bool) = {
@@ -91,24 +104,24 @@ class MemoryModule(numBytes: Int, useAsync: Boolean) {
             val addr = Input(UInt(addrWidth.W))
             val size = Input(UInt(2.W))
             val signed = Input(Bool())
-            val data = Output(UInt(32.W))
+            val data = Output(UInt(wordWidth.W))
 
-            val mem_addr = Output(UInt((addrWidth - 2).W))
-            val mem_data = Input(Vec(4, UInt(8.W)))
+            val mem_addr = Output(UInt((addrWidth - offsetWidth).W))
+            val mem_data = Input(Vec(wordBytes, UInt(8.W)))
          })
          // Sync argument if needed
-         val s_offset = if (useAsync) io.addr(1, 0) else RegNext(io.addr(1, 0))
+         val s_offset = if (useAsync) io.addr(offsetWidth - 1, 0) else RegNext(io.addr(offsetWidth - 1, 0))
          val s_size = if (useAsync) io.size else RegNext(io.size)
          val s_signed = if (useAsync) io.signed else RegNext(io.signed)
 
          // Read data from the banks and align
-         io.mem_addr := io.addr(addrWidth - 1, 2)
+         io.mem_addr := io.addr(addrWidth - 1, offsetWidth)
          val readVec = io.mem_data
          val shiftedVec = splitWord(Cat(readVec) >> (s_offset << 3))
 
          // Mask data according to the size
          val bytes = sizeToBytes(s_size)
-         val sign = shiftedVec(3.U - bytes).apply(7)
+         val sign = shiftedVec((wordBytes - 1).U - bytes).apply(7)
          val masks = getMask(bytes)
          val maskedVec = (shiftedVec zip masks) map ({ case (byte, mask) =>
             Mux(sign && s_signed, byte | ~Fill(8, mask), byte & Fill(8, mask))
@@ -125,30 +138,29 @@ class MemoryModule(numBytes: Int, useAsync: Boolean) {
 
       memreader.io.data
    }
-   def apply(addr: UInt, size: UInt, signed: Bool) = read(addr, size, signed)
 
    // Write function
-   def write(addr: UInt, data: UInt, size: UInt, en: Bool) = {
+   def write(addr: UInt, data: UInt, size: UInt, en: Bool): Unit = {
       // Create a module to show signal inside
       class MemWriter extends Module {
          val io = IO(new Bundle {
             val addr = Input(UInt(addrWidth.W))
-            val data = Input(UInt(32.W))
+            val data = Input(UInt(wordWidth.W))
             val size = Input(UInt(2.W))
             val en = Input(Bool())
 
-            val mem_addr = Output(UInt((addrWidth - 2).W))
-            val mem_data = Output(Vec(4, UInt(8.W)))
-            val mem_masks = Output(Vec(4, Bool()))
+            val mem_addr = Output(UInt((addrWidth - offsetWidth).W))
+            val mem_data = Output(Vec(wordBytes, UInt(8.W)))
+            val mem_masks = Output(Vec(wordBytes, Bool()))
          })
 
          // Align data and mask
-         val offset = io.addr(1, 0)
+         val offset = io.addr(offsetWidth - 1, 0)
          val shiftedVec = splitWord(io.data << (offset << 3))
          val masks = getMask(sizeToBytes(io.size), offset)
 
          // Write
-         io.mem_addr := io.addr(addrWidth - 1, 2)
+         io.mem_addr := io.addr(addrWidth - 1, offsetWidth)
          io.mem_data := shiftedVec
          io.mem_masks := VecInit(masks map (mask => mask && io.en))
       }
@@ -165,6 +177,58 @@ class MemoryModule(numBytes: Int, useAsync: Boolean) {
    }
 }
 
+// Simulation-only backend: the bytes live in a sparse, page-allocated table
+// inside the emulator (see SimSparseMem.cc) instead of in the generated model.
+// Pages are only allocated when first written, so the address is not wrapped
+// to num_bytes and untouched memory costs nothing. Each memory has its own
+// table, selected by mem_id at run time.
+class SimSparseMemPort(syncRead: Boolean) extends BlackBox(Map(
+   "SYNC_READ" -> IntParam(if (syncRead) 1 else 0))) with HasBlackBoxResource
+{
+   val io = IO(new Bundle {
+      val clock = Input(Clock())
+      val mem_id = Input(UInt(32.W))
+      val epoch = Input(UInt(32.W))
+      val addr = Input(UInt(64.W))
+      val size = Input(UInt(2.W))
+      val is_signed = Input(Bool())
+      val wen = Input(Bool())
+      val wdata = Input(UInt(64.W))
+      val rdata = Output(UInt(64.W))
+   })
+   addResource("/sodor/vsrc/SimSparseMem.v")
+   addResource("/sodor/csrc/SimSparseMem.cc")
+}
+
+class SimMemoryModule(useAsync: Boolean, memId: UInt, wordBytes: Int = 4) extends MemoryBackend {
+   // Bumped on every write so that asynchronous read ports observe stores
+   // even when their own address has not changed (writes from outside the
+   // design, e.g. a batch reload, bump the table's own epoch on the C side)
+   private val epoch = RegInit(0.U(32.W))
+   private val written = WireDefault(false.B)
+   when (written) { epoch := epoch + 1.U }
+
+   private def port(addr: UInt, size: UInt, signed: Bool, wen: Bool, wdata: UInt) = {
+      val p = Module(new SimSparseMemPort(!useAsync))
+      p.io.clock := Module.clock
+      p.io.mem_id := memId
+      p.io.epoch := epoch
+      p.io.addr := addr
+      p.io.size := size
+      p.io.is_signed := signed
+      p.io.wen := wen
+      p.io.wdata := wdata
+      p.io.rdata(wordBytes * 8 - 1, 0)
+   }
+
+   def read(addr: UInt, size: UInt, signed: Bool) = port(addr, size, signed, false.B, 0.U)
+
+   def write(addr: UInt, data: UInt, size: UInt, en: Bool): Unit = {
+      port(addr, size, false.B, en, data(wordBytes * 8 - 1, 0))
+      when (en) { written := true.B }
+   }
+}
+
 // NOTE: the default is enormous (and may crash your computer), but is bound by
 // what the fesvr expects the smallest memory size to be.  A proper fix would
 // be to modify the fesvr to expect smaller sizes.
@@ -174,12 +238,18 @@ class ScratchPadMemoryBase(num_core_ports: Int, num_bytes: Int = (1 << 21), useA
    val io = IO(new Bundle
    {
       val core_ports = Vec(num_core_ports, Flipped(new MemPortIo(data_width = conf.xprlen)) )
-      val debug_port = Flipped(new MemPortIo(data_width = 32))
+      val debug_port = Flipped(new MemPortIo(data_width = conf.xprlen))
+      val mem_id = Input(UInt(32.W)) // sparse DPI table (useSimMemory), unique per scratchpad
    })
    val num_bytes_per_line = 8
    val num_lines = num_bytes / num_bytes_per_line
-   println("\n    Sodor Tile: creating Asynchronous Scratchpad Memory of size " + num_lines*num_bytes_per_line/1024 + " kB\n")
-   val async_data = new MemoryModule(num_bytes, useAsync)
+   val async_data: MemoryBackend = if (conf.useSimMemory) {
+      println("\n    Sodor Tile: creating sparse DPI Scratchpad Memory (simulation only)\n")
+      new SimMemoryModule(useAsync, io.mem_id, conf.xprlen / 8)
+   } else {
+      println("\n    Sodor Tile: creating Asynchronous Scratchpad Memory of size " + num_lines*num_bytes_per_line/1024 + " kB\n")
+      new MemoryModule(num_bytes, useAsync, conf.xprlen / 8)
+   }
    for (i <- 0 until num_core_ports)
    {
       io.core_ports(i).resp.valid := (if (useAsync) io.core_ports(i).req.valid else RegNext(io.core_ports(i).req.valid, false.B))
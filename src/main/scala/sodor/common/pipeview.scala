@@ -0,0 +1,87 @@
+//**************************************************************************
+// Pipeline view trace
+//--------------------------------------------------------------------------
+//
+// Per-instruction lifecycle records in gem5's O3PipeView format, which can be
+// loaded into Konata or gem5's util/o3-pipeview.py. Grep the emulator output
+// for "O3PipeView:" to separate them from the per-cycle trace.
+//
+// Each record is printed once, when the instruction leaves the pipeline. The
+// Sodor stages map onto the O3 ones as
+//
+//    fetch   -> fetch
+//    decode  -> decode, rename
+//    execute -> dispatch, issue
+//    memory  -> complete
+//    retire  -> retire
+//
+// A stage the instruction never reached is printed as 0, and a squashed
+// instruction has a retire tick of 0. The text field holds the disassembly,
+// the cycles spent stalled on hazards (S=) and on memory (F=), and, for
+// squashed instructions, the reason:
+//
+//    B  killed by a redirect (branch, jump, fence.i) behind it
+//    K  killed by a pipeline flush (exception, mret)
+//    X  raised an exception itself
+//    I  replaced by an interrupt taken on it
+
+package sodor.common
+
+import chisel3._
+import chisel3.util._
+
+class PipeViewStamps extends Bundle
+{
+   val seq      = UInt(32.W)
+   val fetch    = UInt(32.W)
+   val decode   = UInt(32.W)
+   val execute  = UInt(32.W)
+   val memory   = UInt(32.W)
+   val hazard   = UInt(16.W)   // cycles stalled on hazards
+   val mem_wait = UInt(16.W)   // cycles stalled waiting for memory
+}
+
+object PipeView
+{
+   // Free-running cycle count. Every module that keeps one is reset together,
+   // so they all agree.
+   def cycle(): UInt =
+   {
+      val c = RegInit(0.U(32.W))
+      c := c + 1.U
+      c
+   }
+
+   def stamps(seq: UInt, fetch: UInt): PipeViewStamps =
+   {
+      val s = Wire(new PipeViewStamps)
+      s := 0.U.asTypeOf(new PipeViewStamps)
+      s.seq := seq
+      s.fetch := fetch
+      s
+   }
+
+   // Records are only printed while `enable` is set (e.g. while measuring, see
+   // triggers.scala)
+   def retire(s: PipeViewStamps, pc: UInt, inst: UInt, cycle: UInt, enable: Bool = true.B): Unit =
+      emit(s, pc, inst, cycle, Str(' '), enable)
+
+   def squash(s: PipeViewStamps, pc: UInt, inst: UInt, reason: UInt, enable: Bool = true.B): Unit =
+      emit(s, pc, inst, 0.U, reason, enable)
+
+   private def emit(s: PipeViewStamps, pc: UInt, inst: UInt, retire: UInt, reason: UInt, enable: Bool): Unit =
+   {
+      when (enable)
+      {
+         printf("O3PipeView:fetch:%d:0x%x:0:%d:DASM(%x) S=%d F=%d %c\n" +
+                "O3PipeView:decode:%d\nO3PipeView:rename:%d\n" +
+                "O3PipeView:dispatch:%d\nO3PipeView:issue:%d\n" +
+                "O3PipeView:complete:%d\nO3PipeView:retire:%d:store:0\n",
+            s.fetch, pc, s.seq, inst, s.hazard, s.mem_wait, reason,
+            s.decode, s.decode,
+            s.execute, s.execute,
+            s.memory,
+            retire)
+      }
+   }
+}
@@ -0,0 +1,235 @@
+//**************************************************************************
+// Stride prefetcher
+//--------------------------------------------------------------------------
+//
+// Sits between the data port's request router and the master port, so it
+// only sees accesses outside the scratchpad. A reference prediction table,
+// indexed by the pc of the load, remembers each load's last address and
+// stride; once a load repeats its stride, the word `distance` strides ahead
+// is fetched with a Get while the master port is idle and kept in a small
+// FIFO prefetch buffer. Loads that hit in the buffer are answered from it in
+// the next cycle; a load of the word being prefetched waits for that Get
+// instead of sending its own. Stores go out as usual and drop the buffered and
+// pending prefetches of the word they write.
+//
+// Only the off-chip memory region (ExtMem) is prefetched, never MMIO. The
+// buffer is not kept coherent with other masters (e.g. the DMA engine).
+// Cores that do not give the pc of their data requests share one table entry.
+// Accuracy and coverage are printed when the emulator exits (see
+// SodorPrefetchStats.v).
+
+package sodor.common
+
+import chisel3._
+import chisel3.util._
+
+import org.chipsalliance.cde.config._
+import freechips.rocketchip.diplomacy._
+import freechips.rocketchip.rocket.LoadGen
+import freechips.rocketchip.subsystem.ExtMem
+
+import Constants._
+
+case class SodorPrefetchParams(
+  nEntries: Int = 16, // reference prediction table entries
+  nBuffer: Int = 4, // prefetched words
+  distance: Int = 1 // strides ahead of the load
+) {
+  require(isPow2(nEntries) && nBuffer > 0 && distance > 0)
+}
+
+class SodorPrefetchStats extends BlackBox with HasBlackBoxResource {
+  val io = IO(new Bundle {
+    val clock = Input(Clock())
+    val reset = Input(Bool())
+    val loads = Input(UInt(64.W)) // loads of prefetchable memory
+    val hits = Input(UInt(64.W)) // answered from the buffer
+    val late = Input(UInt(64.W)) // waited for the prefetch of their word
+    val issued = Input(UInt(64.W))
+    val useful = Input(UInt(64.W)) // prefetches used by a load
+    val dropped = Input(UInt(64.W)) // prefetches dropped by a store
+  })
+  addResource("/sodor/vsrc/SodorPrefetchStats.v")
+}
+
+class SodorPrefetcher(params: SodorPrefetchParams, memory: Seq[AddressSet])(implicit val conf: SodorCoreParams) extends Module {
+  val io = IO(new Bundle {
+    val core = Flipped(new MemPortIo(data_width = conf.xprlen))
+    val mem = new MemPortIo(data_width = conf.xprlen)
+    val pc = Input(UInt(conf.xprlen.W))
+  })
+
+  val wordBytes = conf.xprlen / 8
+  val wordType = if (conf.xprlen == 64) MT_D else MT_W
+  def word(addr: UInt) = addr >> log2Ceil(wordBytes)
+  def prefetchable(addr: UInt) = memory.map(_.contains(addr)).reduce(_ || _)
+  def loadData(data: UInt, req: MemReq) =
+    new LoadGen(req.getTLSize, req.getTLSigned, req.addr, data, false.B, wordBytes).data(conf.xprlen - 1, 0)
+
+  // Reference prediction table
+  class RPTEntry extends Bundle {
+    val tag = UInt(conf.xprlen.W)
+    val last = UInt(conf.xprlen.W)
+    val stride = UInt(conf.xprlen.W)
+    val confidence = UInt(2.W)
+  }
+  val rpt = Reg(Vec(params.nEntries, new RPTEntry))
+  val rpt_valid = RegInit(VecInit(Seq.fill(params.nEntries)(false.B)))
+
+  // Prefetch buffer
+  class BufferEntry extends Bundle {
+    val addr = UInt(conf.xprlen.W) // word address
+    val data = UInt(conf.xprlen.W)
+    val used = Bool()
+  }
+  val buffer = Reg(Vec(params.nBuffer, new BufferEntry))
+  val buffer_valid = RegInit(VecInit(Seq.fill(params.nBuffer)(false.B)))
+  val buffer_next = RegInit(0.U(log2Ceil(params.nBuffer).max(1).W))
+  def buffered(addr: UInt) = (buffer_valid zip buffer).map { case (v, b) => v && b.addr === addr }.reduce(_ || _)
+
+  val pf_pending = RegInit(false.B)
+  val pf_addr = Reg(UInt(conf.xprlen.W)) // word address
+
+  // The master port takes one request at a time, which must be held until it
+  // has been sent on the bus
+  val m_idle :: m_demand :: m_prefetch :: Nil = Enum(3)
+  val m_state = RegInit(m_idle)
+  val m_bits = Reg(new MemReq(conf.xprlen))
+
+  // The core's request, until it is answered
+  val s_ready :: s_hit :: s_wait :: s_demand :: Nil = Enum(4)
+  val s_state = RegInit(s_ready)
+  val s_bits = Reg(new MemReq(conf.xprlen))
+  val hit_data = Reg(UInt(conf.xprlen.W))
+
+  val req = io.core.req.bits
+  val is_load = req.fcn === M_XRD
+  val req_word = word(req.addr)
+  val buffer_hits = (buffer_valid zip buffer).map { case (v, b) => v && b.addr === req_word }
+  val buffer_hit = is_load && buffer_hits.reduce(_ || _)
+  val pf_match = is_load && m_state === m_prefetch && word(m_bits.addr) === req_word
+  val demand = s_state === s_ready && io.core.req.valid && !buffer_hit && !pf_match
+
+  io.core.req.ready := s_state === s_ready && (buffer_hit || pf_match || (m_state === m_idle && io.mem.req.ready))
+
+  // Master port: demand requests first, prefetches while it is otherwise idle
+  val issue_demand = demand && m_state === m_idle
+  val issue_pf = !demand && m_state === m_idle && pf_pending && !buffered(pf_addr)
+  val pf_req = Wire(new MemReq(conf.xprlen))
+  pf_req.addr := pf_addr << log2Ceil(wordBytes)
+  pf_req.data := 0.U
+  pf_req.fcn := M_XRD
+  pf_req.typ := wordType
+  io.mem.req.valid := issue_demand || issue_pf
+  io.mem.req.bits := Mux(m_state =/= m_idle, m_bits, Mux(issue_demand, req, pf_req))
+
+  when (io.mem.req.fire) {
+    m_bits := io.mem.req.bits
+    m_state := Mux(issue_demand, m_demand, m_prefetch)
+  }
+  when (m_state === m_idle && pf_pending && (issue_pf || buffered(pf_addr) || (issue_demand && req_word === pf_addr))) {
+    pf_pending := false.B
+  }
+  when (io.mem.resp.valid) {
+    m_state := m_idle
+    when (m_state === m_prefetch) {
+      buffer_valid(buffer_next) := true.B
+      buffer(buffer_next).addr := word(m_bits.addr)
+      buffer(buffer_next).data := io.mem.resp.bits.data
+      buffer(buffer_next).used := s_state === s_wait
+      buffer_next := Mux(buffer_next === (params.nBuffer - 1).U, 0.U, buffer_next + 1.U)
+    }
+  }
+
+  // Core port
+  when (io.core.req.fire) {
+    s_bits := req
+    s_state := Mux(buffer_hit, s_hit, Mux(pf_match, s_wait, s_demand))
+    hit_data := loadData(Mux1H(buffer_hits, buffer.map(_.data)), req)
+    when (buffer_hit) {
+      buffer_hits.zip(buffer).foreach { case (h, b) => when (h) { b.used := true.B } }
+    }
+  }
+  io.core.resp.valid := MuxLookup(s_state, false.B)(Seq(
+    s_hit -> true.B,
+    s_wait -> (io.mem.resp.valid && m_state === m_prefetch),
+    s_demand -> (io.mem.resp.valid && m_state === m_demand)))
+  io.core.resp.bits.data := MuxLookup(s_state, io.mem.resp.bits.data)(Seq(
+    s_hit -> hit_data,
+    s_wait -> loadData(io.mem.resp.bits.data, s_bits)))
+  when (s_state =/= s_ready && io.core.resp.valid) {
+    s_state := s_ready
+  }
+
+  // Stores drop the prefetches of their word
+  val store = io.core.req.fire && !is_load
+  val pf_store = store && pf_pending && pf_addr === req_word
+  when (store) {
+    buffer_hits.zip(buffer_valid).foreach { case (h, v) => when (h) { v := false.B } }
+    when (pf_store) { pf_pending := false.B }
+  }
+
+  // Training: a load that repeats its stride prefetches `distance` strides ahead
+  val train = io.core.req.fire && is_load && prefetchable(req.addr)
+  val idx = if (params.nEntries == 1) 0.U else io.pc(log2Ceil(params.nEntries) + 1, 2)
+  val entry = rpt(idx)
+  val tag_hit = rpt_valid(idx) && entry.tag === io.pc
+  val stride = req.addr - entry.last
+  val steady = tag_hit && stride === entry.stride && stride =/= 0.U
+  val target = (req.addr + stride * params.distance.U)(conf.xprlen - 1, 0)
+  when (train) {
+    rpt_valid(idx) := true.B
+    entry.tag := io.pc
+    entry.last := req.addr
+    when (!tag_hit) {
+      entry.stride := 0.U
+      entry.confidence := 0.U
+    } .elsewhen (steady) {
+      entry.confidence := entry.confidence + (entry.confidence =/= 3.U)
+    } .otherwise {
+      entry.confidence := entry.confidence - (entry.confidence =/= 0.U)
+      when (entry.confidence <= 1.U) { entry.stride := stride }
+    }
+    when (steady && entry.confidence =/= 0.U && prefetchable(target) && word(target) =/= req_word) {
+      pf_pending := true.B
+      pf_addr := word(target)
+    }
+  }
+
+  // Statistics
+  val loads = RegInit(0.U(64.W))
+  val hits = RegInit(0.U(64.W))
+  val late = RegInit(0.U(64.W))
+  val issued = RegInit(0.U(64.W))
+  val useful = RegInit(0.U(64.W))
+  val dropped = RegInit(0.U(64.W))
+  val first_use = buffer_hit && !Mux1H(buffer_hits, buffer.map(_.used))
+  when (train) { loads := loads + 1.U }
+  when (io.core.req.fire && buffer_hit) { hits := hits + 1.U }
+  when (io.core.req.fire && pf_match) { late := late + 1.U }
+  when (io.mem.req.fire && issue_pf) { issued := issued + 1.U }
+  when (io.core.req.fire && (first_use || pf_match)) { useful := useful + 1.U }
+  when (store) { dropped := dropped + PopCount(buffer_hits) + pf_store }
+
+  val stats = Module(new SodorPrefetchStats)
+  stats.io.clock := clock
+  stats.io.reset := reset.asBool
+  stats.io.loads := loads
+  stats.io.hits := hits
+  stats.io.late := late
+  stats.io.issued := issued
+  stats.io.useful := useful
+  stats.io.dropped := dropped
+}
+
+object SodorPrefetcher {
+  // Returns the data port to connect to the master port in place of `port`
+  def apply(port: MemPortIo, pc: UInt)(implicit p: Parameters, conf: SodorCoreParams): MemPortIo = {
+    val mem = p(ExtMem)
+    require(mem.isDefined, "The prefetcher needs an off-chip memory (ExtMem).")
+    val pf = Module(new SodorPrefetcher(conf.prefetch.get, AddressSet.misaligned(mem.get.master.base, mem.get.master.size)))
+    pf.io.core <> port
+    pf.io.pc := pc
+    pf.io.mem
+  }
+}
@@ -13,66 +13,134 @@ import freechips.rocketchip.tile._
 import freechips.rocketchip.tilelink._
 import freechips.rocketchip.util._
 
-class SodorScratchpadAdapter(implicit p: Parameters, implicit val sodorConf: SodorCoreParams) extends CoreModule {
-  val io = IO(new Bundle() {
-    val slavePort = Flipped(new HellaCacheIO())
-    val memPort = new MemPortIo(data_width = coreDataBits)
-  })
-
-  // ===================
-  // Slave port signals
-  val slave_req_ready = io.slavePort.req.ready
-  val s2_slave_resp_valid = io.slavePort.resp.valid
-  val slave_req_valid = io.slavePort.req.valid
-
-  val slave_cmd = io.slavePort.req.bits.cmd
-  val slave_req = io.slavePort.req.bits
-
-  // All request are delayed for one cycle to avoid being killed
-  val s1_slave_write_kill = io.slavePort.s1_kill
-  val s1_slave_write_data = io.slavePort.s1_data.data
-  val s1_slave_write_mask = io.slavePort.s1_data.mask
+// TileLink manager for the tile-local scratchpad, driving the scratchpad's
+// MemPortIo debug port directly. One memory request is issued per cycle, so
+// external masters can stream into the scratchpad: every Put beat and every
+// beat of a multi-beat Get becomes one MemPortIo access (a Put beat with a
+// sparse mask one per byte). Responses are kept in order; a request is only
+// accepted if its response is guaranteed a slot in the D channel queue, which
+// provides the backpressure.
+// The bus side may be wider than the scratchpad port (busBytes > beatBytes):
+// wide beats are then split into port-width beats before reaching the adapter
+// and Get responses are packed back into full bus beats.
+class SodorScratchpadAdapter(address: Seq[AddressSet], val beatBytes: Int, maxTransfer: Int, busBytes: Int = 0, val queueDepth: Int = 4)
+  (implicit p: Parameters, val conf: SodorCoreParams) extends LazyModule
+{
+  val xBytes = if (busBytes == 0) beatBytes else busBytes
+  require(xBytes >= beatBytes, "Scratchpad adapter bus must be at least as wide as the scratchpad port")
+  require(isPow2(maxTransfer) && maxTransfer >= beatBytes, "Scratchpad max transfer must be a power of 2 of at least one beat")
+  require(queueDepth >= 2, "Scratchpad adapter needs at least 2 queue entries to sustain one beat per cycle")
+
+  val device = new SimpleDevice("dtim", Seq("sifive,dtim0"))
+  val manager = TLManagerNode(Seq(TLSlavePortParameters.v1(
+    managers = Seq(TLSlaveParameters.v1(
+      address = address,
+      resources = device.reg("mem"),
+      regionType = RegionType.IDEMPOTENT,
+      executable = true,
+      supportsGet = TransferSizes(1, maxTransfer),
+      supportsPutFull = TransferSizes(1, maxTransfer),
+      supportsPutPartial = TransferSizes(1, maxTransfer),
+      fifoId = Some(0))), // requests are handled in order
+    beatBytes = beatBytes,
+    minLatency = 1)))
+
+  // Bus-facing node
+  val node = TLIdentityNode()
+  if (xBytes == beatBytes) manager := node else manager := TLWidthWidget(xBytes) := node
+
+  lazy val module = new SodorScratchpadAdapterImp(this)
+}
 
-  val s1_slave_req_valid = RegNext(slave_req_valid, false.B)
-  val s1_slave_cmd = RegNext(slave_cmd)
-  val s1_slave_req = RegNext(slave_req)
+class SodorScratchpadAdapterImp(outer: SodorScratchpadAdapter) extends LazyModuleImp(outer) {
+  implicit val conf = outer.conf
+  val beatBytes = outer.beatBytes
+  val lgBeatBytes = log2Ceil(beatBytes)
+  val io = IO(new Bundle {
+    val memPort = new MemPortIo(data_width = beatBytes * 8)
+  })
 
-  // Note that ScratchpadSlavePort requires 2-cycle delay, or it won't even send the response
-  val s2_slave_read_data = io.slavePort.resp.bits.data_raw
-  val s2_slave_read_mask = io.slavePort.resp.bits.mask
+  val (tl, edge) = outer.manager.in(0)
+  val a = tl.a.bits
+  val a_isGet = a.opcode === TLMessages.Get
 
-  val s2_nack = io.slavePort.s2_nack
+  // ===================
+  // Bookkeeping of requests issued to the scratchpad, in order
+  class ScratchpadReqMeta extends Bundle {
+    val read   = Bool()
+    val ack    = Bool() // generates a D beat (every Get beat, last access of a Put)
+    val source = UInt(edge.bundle.sourceBits.W)
+    val size   = UInt(edge.bundle.sizeBits.W)
+  }
+  val meta = Module(new Queue(new ScratchpadReqMeta, outer.queueDepth, flow = true))
+  val resp = Module(new Queue(new TLBundleD(edge.bundle), outer.queueDepth))
+  val has_credit = (meta.io.count +& resp.io.count) < outer.queueDepth.U
 
-  // Tie anything not defined below to DontCare
-  io.slavePort := DontCare
+  // ===================
+  // A channel: split bursts into beats
+  // A Get is held in the channel while its response beats are read out;
+  // Puts already arrive as one A beat per data beat.
+  val maxBeats1 = (1 << (log2Ceil(edge.manager.maxTransfer) - lgBeatBytes)) - 1
+  val get_beat = RegInit(0.U(log2Ceil(maxBeats1 + 1).max(1).W))
+  val get_beats1 = (UIntToOH1(a.size, log2Ceil(edge.manager.maxTransfer)) >> lgBeatBytes)
+  val get_last = get_beat === get_beats1
+  val (_, put_last, _, put_beat) = edge.count(tl.a)
+  val beat = Mux(a_isGet, get_beat, put_beat)
+  val beat_addr = a.address | (beat << lgBeatBytes)
+  val beat_base = beat_addr & ~((beatBytes - 1).U(beat_addr.getWidth.W))
+
+  // MemPortIo has no byte mask: a Put beat is written as one access if its
+  // mask is a naturally aligned power-of-2 run of bytes, which covers every
+  // PutFull and the usual sub-word PutPartial. Any other mask is written one
+  // byte per access, holding the beat in the A channel until it is done.
+  val put_written = RegInit(0.U(beatBytes.W)) // bytes of the current Put beat already written
+  val put_mask = a.mask & ~put_written
+  val put_empty = a.mask === 0.U
+  val put_offset = PriorityEncoder(put_mask)
+  val run_bytes = PopCount(put_mask)
+  val put_run = PopCount(run_bytes) === 1.U && (put_offset & (run_bytes - 1.U)) === 0.U &&
+    put_mask === (((1.U << run_bytes) - 1.U) << put_offset)(beatBytes - 1, 0)
+  val put_bytes = Mux(put_run, run_bytes, 1.U)
+  val put_this = Mux(put_run, put_mask, UIntToOH(put_offset, beatBytes))
+  val put_beat_done = put_empty || (put_mask & ~put_this) === 0.U
+
+  io.memPort.req.valid := tl.a.valid && has_credit
+  tl.a.ready := has_credit && io.memPort.req.ready && Mux(a_isGet, get_last, put_beat_done)
+  val req_fire = io.memPort.req.valid && io.memPort.req.ready
+  when (req_fire && a_isGet) { get_beat := Mux(get_last, 0.U, get_beat + 1.U) }
+  when (req_fire && !a_isGet) { put_written := Mux(put_beat_done, 0.U, put_written | put_this) }
+
+  // Gets always read the full, aligned beat, which leaves every byte in its
+  // own lane; the master picks out the lanes it asked for
+  val read = a_isGet || put_empty
+  io.memPort.req.bits.addr := Mux(read, beat_base, beat_base | put_offset)
+  io.memPort.req.bits.data := a.data >> (put_offset << 3)
+  io.memPort.req.bits.fcn := Mux(read, M_XRD, M_XWR)
+  io.memPort.req.bits.setType(false.B, Mux(read, lgBeatBytes.U, Log2(put_bytes)))
+
+  meta.io.enq.valid := req_fire
+  meta.io.enq.bits.read := a_isGet
+  meta.io.enq.bits.ack := a_isGet || (put_last && put_beat_done)
+  meta.io.enq.bits.source := a.source
+  meta.io.enq.bits.size := a.size
+  assert(!req_fire || meta.io.enq.ready, "Scratchpad adapter issued a request without a free slot")
 
   // ===================
-  // HellaCacheIO to MemPortIo logic
-  // Connect valid & ready bits
-  slave_req_ready := io.memPort.req.ready
-  io.memPort.req.valid := s1_slave_req_valid & (s1_slave_cmd === M_XRD || !s1_slave_write_kill)
-  s2_slave_resp_valid := RegNext(io.memPort.resp.valid, false.B)
-
-  // Connect read info
-  s2_slave_read_mask := RegNext(new StoreGen(s1_slave_req.size, s1_slave_req.addr, 0.U, coreDataBytes).mask)
-  s2_slave_read_data := RegNext(io.memPort.resp.bits.data)
-
-  // Connect write info
-  io.memPort.req.bits.addr := s1_slave_req.addr
-  io.memPort.req.bits.data := s1_slave_write_data
-
-  // Other connections
-  s2_nack := false.B
-  io.memPort.req.bits.fcn := Mux(s1_slave_cmd === M_XRD, M_XRD, M_XWR)
-  // Since we don't have dword here (the bus only has 32 bits), s1_slave_req.size <= 2.
-  // The expression below convert TileLink size and signedness to Sodor type.
-  require(io.slavePort.req.bits.addr.getWidth == 32, "Slave port only support 32 bit address")
-  assert (s1_slave_req.size <= 2.U, "Slave port received a bus request with unsupported size: %d", s1_slave_req.size)
-  io.memPort.req.bits.setType(s1_slave_req.signed, s1_slave_req.size)
+  // D channel
+  meta.io.deq.ready := io.memPort.resp.valid
+  assert(!io.memPort.resp.valid || meta.io.deq.valid, "Scratchpad adapter got a response without a request")
+  val m = meta.io.deq.bits
+  resp.io.enq.valid := io.memPort.resp.valid && m.ack
+  resp.io.enq.bits := Mux(m.read,
+    edge.AccessAck(m.source, m.size, io.memPort.resp.bits.data),
+    edge.AccessAck(m.source, m.size))
+  tl.d <> resp.io.deq
 }
 
 // This class simply route all memory request that doesn't belong to the scratchpad
-class SodorRequestRouter(cacheAddress: AddressSet)(implicit val conf: SodorCoreParams) extends Module {
+// Requests to `alias`, a window of the scratchpad's size, go to the scratchpad
+// too, moved into its range (see SodorCoreParams.bootAlias)
+class SodorRequestRouter(cacheAddress: AddressSet, alias: Option[BigInt] = None)(implicit val conf: SodorCoreParams) extends Module {
   val io = IO(new Bundle() {
     val masterPort = new MemPortIo(data_width = conf.xprlen)
     val scratchPort = new MemPortIo(data_width = conf.xprlen)
@@ -80,11 +148,17 @@ class SodorRequestRouter(cacheAddress: AddressSet)(implicit val conf: SodorCoreP
     val respAddress = Input(UInt(conf.xprlen.W))
   })
 
-  val in_range = cacheAddress.contains(io.corePort.req.bits.addr)
+  val aliasAddress = alias.map(AddressSet(_, cacheAddress.mask))
+  def inAlias(addr: UInt) = aliasAddress.map(_.contains(addr)).getOrElse(false.B)
+  val in_alias = inAlias(io.corePort.req.bits.addr)
+  val in_range = cacheAddress.contains(io.corePort.req.bits.addr) || in_alias
 
   // Connect other signals
   io.masterPort.req.bits <> io.corePort.req.bits
   io.scratchPort.req.bits <> io.corePort.req.bits
+  when (in_alias) {
+    io.scratchPort.req.bits.addr := (io.corePort.req.bits.addr & cacheAddress.mask.U) | cacheAddress.base.U
+  }
 
   // Connect valid signal 
   io.masterPort.req.valid := io.corePort.req.valid & !in_range
@@ -93,7 +167,34 @@ class SodorRequestRouter(cacheAddress: AddressSet)(implicit val conf: SodorCoreP
   // Mux ready and request signal
   io.corePort.req.ready := Mux(in_range, io.scratchPort.req.ready, io.masterPort.req.ready)
   // Use respAddress to route response
-  val resp_in_range = cacheAddress.contains(io.respAddress)
+  val resp_in_range = cacheAddress.contains(io.respAddress) || inAlias(io.respAddress)
   io.corePort.resp.bits := Mux(resp_in_range, io.scratchPort.resp.bits, io.masterPort.resp.bits)
   io.corePort.resp.valid := Mux(resp_in_range, io.scratchPort.resp.valid, io.masterPort.resp.valid)
 }
+
+// Round-robin arbiter sharing one MemPortIo between several requesters.
+// The memory answers in request order, so the winner of each request is
+// queued and used to route the response, whatever the memory latency.
+class SodorMemPortArbiter(n: Int, data_width: Int, maxInflight: Int = 2)(implicit val conf: SodorCoreParams) extends Module {
+  val io = IO(new Bundle() {
+    val in = Flipped(Vec(n, new MemPortIo(data_width)))
+    val out = new MemPortIo(data_width)
+  })
+
+  val arbiter = Module(new RRArbiter(new MemReq(data_width), n))
+  val order = Module(new Queue(UInt(log2Ceil(n).max(1).W), maxInflight, flow = true))
+
+  (arbiter.io.in zip io.in).foreach { case (arb_in, in) => arb_in <> in.req }
+  io.out.req.valid := arbiter.io.out.valid && order.io.enq.ready
+  io.out.req.bits := arbiter.io.out.bits
+  arbiter.io.out.ready := io.out.req.ready && order.io.enq.ready
+
+  order.io.enq.valid := io.out.req.fire
+  order.io.enq.bits := arbiter.io.chosen
+  order.io.deq.ready := io.out.resp.valid
+
+  io.in.zipWithIndex.foreach { case (in, i) =>
+    in.resp.valid := io.out.resp.valid && order.io.deq.bits === i.U
+    in.resp.bits := io.out.resp.bits
+  }
+}
@@ -25,11 +25,18 @@ object CSREvents {
 // Abstract core and tile base class for all cores
 abstract class AbstractCore extends Module {
   val mem_ports: Seq[MemPortIo]
+  val wfi: Bool // asleep in WFI
+  val dmem_pc: Option[UInt] = None // pc of the data request, for the prefetcher
+  val fence: Bool // executing a FENCE or FENCE.I, for the write-combining buffer
   val interrupt: CoreInterrupts
   val hartid: UInt
   val reset_vector: UInt
   val io: Data
 }
+object AbstractCore {
+  def isFence(inst: UInt): Bool = Instructions.FENCE === inst || Instructions.FENCE_I === inst
+}
+
 abstract class AbstractInternalTile(ports: Int)(implicit val p: Parameters, val conf: SodorCoreParams) extends Module {
   val io = IO(new Bundle {
     val debug_port = Flipped(new MemPortIo(data_width = conf.xprlen))
@@ -37,7 +44,41 @@ abstract class AbstractInternalTile(ports: Int)(implicit val p: Parameters, val
     val interrupt = Input(new CoreInterrupts(false))
     val hartid = Input(UInt())
     val reset_vector = Input(UInt())
+    val fence = Output(Bool())
+    val fence_busy = Input(Bool()) // the master port is draining for a fence
+    val booted = Output(Bool()) // the core has used its scratchpad, see boot_mirror.scala
   })
+  val booted = RegInit(false.B)
+  io.booted := booted
+
+  // Batch mode (see batch.scala): the core is reset to each program's entry
+  // point in turn. Cores are built with coreReset and started at resetVector.
+  val batch = if (conf.useBatch) Some(Module(new SodorBatch)) else None
+  batch.foreach(_.io.mem_id := io.hartid)
+  def coreReset: Bool = reset.asBool || batch.map(_.io.core_reset).getOrElse(false.B)
+  def resetVector: UInt = batch.map(b => Mux(b.io.boot, io.reset_vector, b.io.reset_vector)).getOrElse(io.reset_vector)
+
+  // Triggered waveform window (see wavedump.scala)
+  def attachWaveDump(core: AbstractCore): Unit =
+    if (conf.waveScopes.nonEmpty) SodorWaveDump(conf.waveScopes, core.mem_ports.last, core.mem_ports.head)
+
+  // The core's memory ports as seen by the tile, the data port through the
+  // batch runner and the idle fast-forward (see idle_skip.scala). After a
+  // fence, new requests wait until the write-combining buffer has drained
+  // (see master_adapter.scala).
+  def corePorts(core: AbstractCore): Seq[MemPortIo] = {
+    io.fence := core.fence
+    val ports = core.mem_ports.map(SodorFenceHold(_, io.fence_busy))
+    val dmem = batch.map(SodorBatch(_, ports.head, ports.last)).getOrElse(ports.head)
+    if (conf.idleSkip) SodorIdleSkip(dmem, core.wfi, io.hartid) +: ports.tail
+    else dmem +: ports.tail
+  }
+
+  // The data port's way to the master port, through the stride prefetcher
+  // (see prefetcher.scala) if there is one
+  def masterPath(port: MemPortIo, core: AbstractCore, i: Int): MemPortIo =
+    if (conf.prefetch.isDefined && i == Constants.DPORT) SodorPrefetcher(port, core.dmem_pc.getOrElse(0.U))
+    else port
 }
 
 // Cores and internal tiles constructors
@@ -57,11 +98,10 @@ class SodorInternalTileStage3(range: AddressSet, ports: Int)(implicit p: Paramet
   extends AbstractInternalTile(ports)
 {
   // Core memory port
-  val core   = Module(new sodor.stage3.Core())
+  val core   = withReset(coreReset) { Module(new sodor.stage3.Core()) }
   core.io := DontCare
   val core_ports = Wire(Vec(2, new MemPortIo(data_width = conf.xprlen)))
-  core.io.imem <> core_ports(1)
-  core.io.dmem <> core_ports(0)
+  (corePorts(core) zip core_ports).foreach { case (port, core_port) => port <> core_port }
 
   // scratchpad memory port
   val memory = Module(new SyncScratchPadMemory(num_core_ports = ports))
@@ -70,11 +110,12 @@ class SodorInternalTileStage3(range: AddressSet, ports: Int)(implicit p: Paramet
   val master_ports = Wire(Vec(2, new MemPortIo(data_width = conf.xprlen)))
 
   // Connect ports
-  ((mem_ports zip core_ports) zip master_ports).foreach({ case ((mem_port, core_port), master_port) => {
-    val router = Module(new SodorRequestRouter(range))
+  ((mem_ports zip core_ports) zip master_ports).zipWithIndex.foreach({ case (((mem_port, core_port), master_port), i) => {
+    val router = Module(new SodorRequestRouter(range, conf.bootAlias))
     router.io.corePort <> core_port
     router.io.scratchPort <> mem_port
-    router.io.masterPort <> master_port
+    when (router.io.scratchPort.req.fire) { booted := true.B }
+    masterPath(router.io.masterPort, core, i) <> master_port
     // For sync memory, use the request address from the previous cycle
     val reg_resp_address = Reg(UInt(conf.xprlen.W))
     when (core_port.req.fire) { reg_resp_address := core_port.req.bits.addr }
@@ -107,35 +148,42 @@ class SodorInternalTileStage3(range: AddressSet, ports: Int)(implicit p: Paramet
   }
 
   memory.io.debug_port <> io.debug_port
+  memory.io.mem_id := io.hartid
 
   core.interrupt <> io.interrupt
   core.hartid := io.hartid
-  core.reset_vector := io.reset_vector
+  core.reset_vector := resetVector
+
+  attachWaveDump(core)
 }
 
 // The general Sodor tile for all cores other than 3-stage
 class SodorInternalTile(range: AddressSet, coreCtor: SodorCoreFactory)(implicit p: Parameters, conf: SodorCoreParams)
   extends AbstractInternalTile(coreCtor.nMemPorts)
 {
-  val core   = Module(coreCtor.instantiate)
+  val core   = withReset(coreReset) { Module(coreCtor.instantiate) }
   core.io := DontCare
   val memory = Module(new AsyncScratchPadMemory(num_core_ports = coreCtor.nMemPorts))
 
   val nMemPorts = coreCtor.nMemPorts
-  ((memory.io.core_ports zip core.mem_ports) zip io.master_port).foreach({ case ((mem_port, core_port), master_port) => {
-    val router = Module(new SodorRequestRouter(range))
+  ((memory.io.core_ports zip corePorts(core)) zip io.master_port).zipWithIndex.foreach({ case (((mem_port, core_port), master_port), i) => {
+    val router = Module(new SodorRequestRouter(range, conf.bootAlias))
     router.io.corePort <> core_port
     router.io.scratchPort <> mem_port
-    router.io.masterPort <> master_port
+    when (router.io.scratchPort.req.fire) { booted := true.B }
+    masterPath(router.io.masterPort, core, i) <> master_port
     // For async memory, simply use the current request address
     router.io.respAddress := core_port.req.bits.addr
   }})
 
   io.debug_port <> memory.io.debug_port
+  memory.io.mem_id := io.hartid
 
   core.interrupt <> io.interrupt
   core.hartid := io.hartid
-  core.reset_vector := io.reset_vector
+  core.reset_vector := resetVector
+
+  attachWaveDump(core)
 }
 
 // Tile constructor
@@ -23,8 +23,31 @@ case class SodorCoreParams(
   bootFreqHz: BigInt = BigInt(1700000000),
   ports: Int = 2,
   xprlen: Int = 32,
-  internalTile: SodorInternalTileFactory = Stage5Factory
+  internalTile: SodorInternalTileFactory = Stage5Factory,
+  useSimMemory: Boolean = false, // Back the scratchpad with the sparse DPI memory (emulator only)
+  useCosim: Boolean = false, // Check every retired instruction against the DPI reference model (emulator only)
+  useBBV: Boolean = false, // Profile basic-block vectors from the commit path (emulator only)
+  useTelemetry: Boolean = false, // Publish live run statistics for an outside monitor (emulator only)
+  useBatch: Boolean = false, // Run a list of programs back to back in one process (emulator only)
+  waveScopes: Seq[String] = Nil, // Hierarchy dumped by the triggered waveform window (emulator-debug only)
+  idleSkip: Boolean = false, // Jump mtime to mtimecmp while the hart sleeps in WFI (emulator only)
+  useConditionalZero: Boolean = true, // Zicond: czero.eqz and czero.nez
+  accel: Option[SodorAccelFactory] = None, // Accelerator on the custom-0/1 opcodes (5-stage and 3-stage)
+  prefetch: Option[SodorPrefetchParams] = None, // Stride prefetcher on the off-tile data path
+  writeCombine: Option[Int] = None, // Write-combining buffer on the data master port, drained after this many idle cycles
+  nBreakpoints: Int = 0, // Match triggers in tselect/tdata (5-stage only, see triggers.scala)
+  roiOnly: Boolean = false, // Count uarch events and print traces only between start and stop triggers
+  bootAlias: Option[BigInt] = None // Boot address the core sees its own scratchpad at, in place of the first tile's
 ) extends CoreParams {
+  require(xprlen == 32 || xprlen == 64, "Sodor cores are either RV32I or RV64I.")
+  require(xprlen == 32 || !useCosim, "The co-simulation reference model is RV32I only.")
+  require(accel.isEmpty || internalTile == Stage5Factory || internalTile.isInstanceOf[Stage3Factory],
+    "Only the 5-stage and 3-stage cores have the accelerator interface.")
+  require(accel.isEmpty || !useCosim, "The co-simulation reference model does not know the accelerator.")
+  require(writeCombine.forall(_ > 0), "The write-combining timeout must be at least one cycle.")
+  require(nBreakpoints == 0 || internalTile == Stage5Factory, "Only the 5-stage core checks triggers.")
+  require(!roiOnly || nBreakpoints > 0, "Measuring the region of interest needs triggers to start it.")
+  require(!useBatch || useSimMemory, "Batch mode loads programs into the sparse DPI scratchpad.")
   val xLen = xprlen
   val pgLevels = 2
   val useVM: Boolean = false
@@ -44,11 +67,11 @@ case class SodorCoreParams(
   val useNMI: Boolean = false
   val nPMPs: Int = 0 // TODO: Check
   val pmpGranularity: Int = 4 // copied from Rocket
-  val nBreakpoints: Int = 0 // TODO: Check
-  val useBPWatch: Boolean = false
+  val useBPWatch: Boolean = nBreakpoints > 0 // trigger actions beyond breakpoint and debug mode
+  // mhpmcounters for the uarch events the core has (the 5-stage's are listed in its consts.scala)
+  val nPerfCounters: Int = if (internalTile == Stage5Factory) sodor.stage5.Constants.HPM_COUNTERS(nBreakpoints > 0) else 0
   val mcontextWidth: Int = 0 // TODO: Check
   val scontextWidth: Int = 0 // TODO: Check
-  val nPerfCounters: Int = 0
   val haveBasicCounters: Boolean = true
   val haveFSDirty: Boolean = false
   val misaWritable: Boolean = false
@@ -64,7 +87,6 @@ case class SodorCoreParams(
   val retireWidth: Int = 1
   val nPTECacheEntries: Int = 0
   val traceHasWdata: Boolean = false
-  val useConditionalZero: Boolean = false
   val useZba: Boolean = false
   val useZbb: Boolean = false
   val useZbs: Boolean = false
@@ -85,7 +107,12 @@ case class SodorTileParams(
   tileId: Int = 0,
   trace: Boolean = false,
   val core: SodorCoreParams = SodorCoreParams(),
-  val scratchpad: DCacheParams = DCacheParams()
+  val scratchpad: DCacheParams = DCacheParams(),
+  val console: Option[BigInt] = None, // Base address of the MMIO console, if any
+  val dma: Option[BigInt] = None, // Base address of the DMA engine registers, if any
+  val dram: Option[SodorDRAMParams] = None, // Timing model of off-chip memory on the master path, if any
+  val partitioned: Boolean = false, // Register every TileLink signal crossing the tile boundary (see WithSodorParallelSim)
+  val bootMirror: Seq[BigInt] = Nil // Scratchpads of the other tiles that the program loaded into this one is copied to
 ) extends InstantiableTileParams[SodorTile]
 {
   val beuAddr: Option[BigInt] = None
@@ -116,13 +143,23 @@ class SodorTile(
     this(params, crossing.crossingType, lookup, p)
 
   // Require TileLink nodes
-  val intOutwardNode = None
+  val intOutwardNode = sodorParams.dma.map(_ => IntIdentityNode())
   val masterNode = visibilityNode
   val slaveNode = TLIdentityNode()
 
   // Connect node to crossbar switches (bus)
   tlOtherMastersNode := tlMasterXbar.node
-  masterNode :=* tlOtherMastersNode
+
+  // DRAM timing model (see dram_model.scala) between the tile and the bus
+  val dram_model = sodorParams.dram.map { d =>
+    val mem = p(ExtMem)
+    require(mem.isDefined, "The DRAM timing model needs an off-chip memory (ExtMem).")
+    LazyModule(new SodorDRAMModel(d, AddressSet.misaligned(mem.get.master.base, mem.get.master.size), sodorParams.uniqueName))
+  }
+  dram_model match {
+    case Some(m) => masterNode :=* m.node :=* tlOtherMastersNode
+    case None => masterNode :=* tlOtherMastersNode
+  }
   DisableMonitors { implicit p => tlSlaveXbar.node :*= slaveNode }
 
   // Slave port adapter
@@ -134,17 +171,43 @@ class SodorTile(
     AddressSet.misaligned(s, d.dataScratchpadBytes)
   }}
   val dtim_adapter = dtim_address.map { addr =>
-    LazyModule(new ScratchpadSlavePort(addr, coreParams.coreDataBytes, false))
+    LazyModule(new SodorScratchpadAdapter(addr, coreParams.coreDataBytes, p(CacheBlockBytes), p(SystemBusKey).beatBytes)(p, sodorParams.core))
   }
-  dtim_adapter.foreach(lm => connectTLSlave(lm.node, lm.node.portParams.head.beatBytes))
+  // Copies the program loaded into the first tile to the others (see boot_mirror.scala)
+  val boot_mirror = if (sodorParams.bootMirror.isEmpty) None else dtim_address.map { addr =>
+    LazyModule(new SodorBootMirror(addr.head.base, sodorParams.bootMirror))
+  }
+  boot_mirror.foreach(m => tlMasterXbar.node := m.masterNode)
+  // Connected without a fragmenter: the adapter handles multi-beat bursts itself
+  dtim_adapter.foreach(lm => DisableMonitors { implicit p => boot_mirror match {
+    case Some(m) => lm.node := m.node := tlSlaveXbar.node
+    case None => lm.node := tlSlaveXbar.node
+  }})
 
   val dtimProperty = dtim_adapter.map(d => Map(
     "ucb-bar,dtim" -> d.device.asProperty)).getOrElse(Nil)
 
+  // MMIO console
+  val console = sodorParams.console.map { addr =>
+    LazyModule(new SodorConsole(addr, coreParams.coreDataBytes))
+  }
+  console.foreach(c => connectTLSlave(c.node, coreParams.coreDataBytes))
+
+  // DMA engine: registers on the slave crossbar, bus traffic on the master crossbar,
+  // completion interrupt routed out of the tile
+  val dma = sodorParams.dma.map { addr =>
+    LazyModule(new SodorDMA(addr, dtim_address.get, coreParams.coreDataBytes)(p, sodorParams.core))
+  }
+  dma.foreach { d =>
+    connectTLSlave(d.node, coreParams.coreDataBytes)
+    tlMasterXbar.node := d.masterNode
+    intOutwardNode.get := d.intnode
+  }
+
   // Sodor master port adapter
   val imaster_adapter = if (sodorParams.core.ports == 2) Some(LazyModule(new SodorMasterAdapter()(p, sodorParams.core))) else None
   if (sodorParams.core.ports == 2) tlMasterXbar.node := imaster_adapter.get.node
-  val dmaster_adapter = LazyModule(new SodorMasterAdapter()(p, sodorParams.core))
+  val dmaster_adapter = LazyModule(new SodorMasterAdapter(sodorParams.core.writeCombine)(p, sodorParams.core))
   tlMasterXbar.node := dmaster_adapter.node
 
   // Implementation class (See below)
@@ -167,13 +230,17 @@ class SodorTile(
     Resource(cpuDevice, "reg").bind(ResourceAddress(tileId))
   }
 
+  // A partitioned tile only sees the rest of the system through registers:
+  // two-entry queues, no flow-through, on every channel in both directions
   override def makeMasterBoundaryBuffers(crossing: ClockCrossingType)(implicit p: Parameters) = {
-    if (!sodorParams.boundaryBuffers) super.makeMasterBoundaryBuffers(crossing)
+    if (sodorParams.partitioned) TLBuffer(BufferParams.default)
+    else if (!sodorParams.boundaryBuffers) super.makeMasterBoundaryBuffers(crossing)
     else TLBuffer(BufferParams.none, BufferParams.flow, BufferParams.none, BufferParams.flow, BufferParams(1))
   }
 
   override def makeSlaveBoundaryBuffers(crossing: ClockCrossingType)(implicit p: Parameters) = {
-    if (!sodorParams.boundaryBuffers) super.makeSlaveBoundaryBuffers(crossing)
+    if (sodorParams.partitioned) TLBuffer(BufferParams.default)
+    else if (!sodorParams.boundaryBuffers) super.makeSlaveBoundaryBuffers(crossing)
     else TLBuffer(BufferParams.flow, BufferParams.none, BufferParams.none, BufferParams.none, BufferParams.none)
   }
 
@@ -190,14 +257,24 @@ class SodorTileModuleImp(outer: SodorTile) extends BaseTileModuleImp(outer){
   // Tile
   val tile = Module(outer.sodorParams.core.internalTile.instantiate(outer.dtim_address.get.apply(0)))
 
-  // Add scratchpad adapter
-  val scratchpadAdapter = Module(new SodorScratchpadAdapter()(outer.p, conf))
-  scratchpadAdapter.io.slavePort <> outer.dtim_adapter.get.module.io.dmem
-
   // Connect tile
-  tile.io.debug_port <> scratchpadAdapter.io.memPort
+  // The DMA engine shares the scratchpad port with the scratchpad adapter
+  outer.dma match {
+    case Some(dma) =>
+      val spadArbiter = Module(new SodorMemPortArbiter(2, conf.xprlen))
+      spadArbiter.io.in(0) <> outer.dtim_adapter.get.module.io.memPort
+      spadArbiter.io.in(1) <> dma.module.io.spad
+      tile.io.debug_port <> spadArbiter.io.out
+    case None =>
+      tile.io.debug_port <> outer.dtim_adapter.get.module.io.memPort
+  }
   tile.io.master_port(0) <> outer.dmaster_adapter.module.io.dport
   if (outer.sodorParams.core.ports == 2) tile.io.master_port(1) <> outer.imaster_adapter.get.module.io.dport
+  // Fences drain the data adapter's write-combining buffer
+  outer.dmaster_adapter.module.io.fence := tile.io.fence
+  outer.imaster_adapter.foreach(_.module.io.fence := false.B)
+  tile.io.fence_busy := outer.dmaster_adapter.module.io.fence_busy
+  outer.boot_mirror.foreach(_.module.io.active := !tile.io.booted)
 
   // Connect interrupts
   outer.decodeCoreInterrupts(tile.io.interrupt)
@@ -207,38 +284,238 @@ class SodorTileModuleImp(outer: SodorTile) extends BaseTileModuleImp(outer){
   tile.io.reset_vector := outer.resetVectorSinkNode.bundle
 }
 
+object SodorTileConsts {
+  val deviceStride = 0x2000 // between the console and DMA registers of neighbouring tiles
+}
+
+// Every tile has its own scratchpad, tile i's at 0x80000000 + i * its size
+// (nSets * blockBytes, 256 KiB). All harts boot into 0x80000000, and each
+// runs the program out of its own scratchpad: the cores of the other tiles
+// see theirs there instead of tile 0's, which they cannot reach, and the
+// program the host loads into tile 0 is copied into theirs (see
+// boot_mirror.scala).
 class WithNSodorCores(
   n: Int = 1,
-  internalTile: SodorInternalTileFactory = Stage3Factory()
+  internalTile: SodorInternalTileFactory = Stage3Factory(),
+  busBytes: Int = 4
 ) extends Config((site, here, up) => {
   case TilesLocated(InSubsystem) => {
     // Calculate the next available hart ID (since hart ID cannot be duplicated)
     val prev = up(TilesLocated(InSubsystem), site)
-    require(prev.length == 0, "Sodor doesn't support multiple core.")
+    require(prev.length == 0, "Sodor tiles cannot be mixed with other tiles.")
     val idOffset = up(NumTiles)
+    val scratchpad = DCacheParams(
+      nSets = 4096, // Very large so we have enough SPAD for bmark tests
+      nWays = 1,
+      nMSHRs = 0,
+      scratch = Some(0x80000000L)
+    )
+    val base = scratchpad.scratch.get
+    def scratchBase(i: Int) = base + i * scratchpad.dataScratchpadBytes
     // Create TileAttachParams for every core to be instantiated
     (0 until n).map { i =>
       SodorTileAttachParams(
         tileParams = SodorTileParams(
           tileId = i + idOffset,
-          scratchpad = DCacheParams(
-            nSets = 4096, // Very large so we have enough SPAD for bmark tests
-            nWays = 1,
-            nMSHRs = 0,
-            scratch = Some(0x80000000L)
-          ),
+          scratchpad = scratchpad.copy(scratch = Some(scratchBase(i))),
           core = SodorCoreParams(
             ports = internalTile.nMemPorts,
-            internalTile = internalTile
-          )
+            internalTile = internalTile,
+            bootAlias = if (i == 0) None else Some(base)
+          ),
+          bootMirror = if (i == 0) (1 until n).map(scratchBase) else Nil
         ),
         crossingParams = RocketCrossingParams()
       )
     } ++ prev
   }
-  // Configurate # of bytes in one memory / IO transaction. For RV64, one load/store instruction can transfer 8 bytes at most.
-  case SystemBusKey => up(SystemBusKey, site).copy(beatBytes = 4)
+  // Configurate # of bytes in one bus beat. The core datapath stays 32-bit; the scratchpad and
+  // master adapters convert between the core width and wider (8 or 16 byte) system bus beats.
+  case SystemBusKey => up(SystemBusKey, site).copy(beatBytes = busBytes)
   case NumTiles => up(NumTiles) + n
 }) {
-  require(n == 1, "Sodor doesn't support multiple core.")
+  require(n >= 1, "Sodor needs at least one core.")
+  require(Seq(4, 8, 16).contains(busBytes), "Sodor system bus must be 4, 8 or 16 bytes wide.")
 }
+
+// Build the cores as RV64I (1-stage and 5-stage only). The scratchpad words and
+// core memory ports become 64-bit; the system bus is widened to at least 8 bytes
+// so that doubleword accesses through the scratchpad and master adapters are
+// single beats.
+class WithSodorRV64 extends Config((site, here, up) => {
+  case TilesLocated(InSubsystem) => up(TilesLocated(InSubsystem), site) map {
+    case tp: SodorTileAttachParams => tp.copy(tileParams = tp.tileParams.copy(
+      core = tp.tileParams.core.copy(xprlen = 64)))
+    case other => other
+  }
+  case SystemBusKey => {
+    val sbus = up(SystemBusKey, site)
+    sbus.copy(beatBytes = sbus.beatBytes max 8)
+  }
+})
+
+// Replace the RTL scratchpad array with the sparse, page-allocated DPI memory.
+// Simulation only: the resulting design cannot be synthesized.
+class WithSodorSimMemory extends Config((site, here, up) => {
+  case TilesLocated(InSubsystem) => up(TilesLocated(InSubsystem), site) map {
+    case tp: SodorTileAttachParams => tp.copy(tileParams = tp.tileParams.copy(
+      core = tp.tileParams.core.copy(useSimMemory = true)))
+    case other => other
+  }
+})
+
+// Build in lockstep co-simulation against the reference model (see cosim.scala).
+// It only runs when the emulator is given +cosim=<elf>. Simulation only.
+class WithSodorCosim extends Config((site, here, up) => {
+  case TilesLocated(InSubsystem) => up(TilesLocated(InSubsystem), site) map {
+    case tp: SodorTileAttachParams => tp.copy(tileParams = tp.tileParams.copy(
+      core = tp.tileParams.core.copy(useCosim = true)))
+    case other => other
+  }
+})
+
+// Build in basic-block vector profiling (see bbv.scala). It only runs when the
+// emulator is given +bbv=<file>. Simulation only.
+class WithSodorBBV extends Config((site, here, up) => {
+  case TilesLocated(InSubsystem) => up(TilesLocated(InSubsystem), site) map {
+    case tp: SodorTileAttachParams => tp.copy(tileParams = tp.tileParams.copy(
+      core = tp.tileParams.core.copy(useBBV = true)))
+    case other => other
+  }
+})
+
+// Build in live telemetry (see telemetry.scala). It only runs when the
+// emulator is given +telemetry=<file>. Simulation only.
+class WithSodorTelemetry extends Config((site, here, up) => {
+  case TilesLocated(InSubsystem) => up(TilesLocated(InSubsystem), site) map {
+    case tp: SodorTileAttachParams => tp.copy(tileParams = tp.tileParams.copy(
+      core = tp.tileParams.core.copy(useTelemetry = true)))
+    case other => other
+  }
+})
+
+// Build in batch mode (see batch.scala), on the sparse DPI scratchpad it loads
+// programs into. It only runs when the emulator is given +batch=<list>.
+// Simulation only.
+class WithSodorBatch extends Config((site, here, up) => {
+  case TilesLocated(InSubsystem) =>
+    val tiles = up(TilesLocated(InSubsystem), site)
+    require(tiles.count(_.isInstanceOf[SodorTileAttachParams]) == 1, "Batch mode runs on a single Sodor tile.")
+    tiles map {
+      case tp: SodorTileAttachParams => tp.copy(tileParams = tp.tileParams.copy(
+        core = tp.tileParams.core.copy(useBatch = true, useSimMemory = true)))
+      case other => other
+    }
+})
+
+// Build in triggered, windowed waveform dumping of the given scopes (see
+// wavedump.scala). It only runs when the debug emulator is given +wave=<file>.
+class WithSodorWaveDump(scopes: Seq[String] = Seq("core")) extends Config((site, here, up) => {
+  case TilesLocated(InSubsystem) => up(TilesLocated(InSubsystem), site) map {
+    case tp: SodorTileAttachParams => tp.copy(tileParams = tp.tileParams.copy(
+      core = tp.tileParams.core.copy(waveScopes = scopes)))
+    case other => other
+  }
+})
+
+// Fast-forward the idle time of a hart sleeping in WFI to its next timer
+// interrupt (see idle_skip.scala). Simulation only.
+class WithSodorIdleSkip extends Config((site, here, up) => {
+  case TilesLocated(InSubsystem) =>
+    val tiles = up(TilesLocated(InSubsystem), site)
+    // mtime is shared: moving it for one sleeping hart would move it under the others
+    require(tiles.count(_.isInstanceOf[SodorTileAttachParams]) == 1, "Idle skipping runs on a single Sodor tile.")
+    tiles map {
+      case tp: SodorTileAttachParams => tp.copy(tileParams = tp.tileParams.copy(
+        core = tp.tileParams.core.copy(idleSkip = true)))
+      case other => other
+    }
+})
+
+// Attach an accelerator to the custom-0/1 opcodes of the 5-stage or 3-stage
+// core (see accelerator.scala)
+class WithSodorAccel(factory: SodorAccelFactory = SodorCRC32AccelFactory()) extends Config((site, here, up) => {
+  case TilesLocated(InSubsystem) => up(TilesLocated(InSubsystem), site) map {
+    case tp: SodorTileAttachParams => tp.copy(tileParams = tp.tileParams.copy(
+      core = tp.tileParams.core.copy(accel = Some(factory))))
+    case other => other
+  }
+})
+
+// Prefetch strided loads from off-chip memory (see prefetcher.scala). The
+// 5-stage and 3-stage index the prefetcher by the pc of the load; the other
+// cores train a single entry.
+class WithSodorPrefetcher(params: SodorPrefetchParams = SodorPrefetchParams()) extends Config((site, here, up) => {
+  case TilesLocated(InSubsystem) => up(TilesLocated(InSubsystem), site) map {
+    case tp: SodorTileAttachParams => tp.copy(tileParams = tp.tileParams.copy(
+      core = tp.tileParams.core.copy(prefetch = Some(params))))
+    case other => other
+  }
+})
+
+// Merge the stores to off-chip memory into line-sized PutPartial bursts (see
+// master_adapter.scala). The buffer drains after `timeout` cycles without a
+// store, and on FENCE and FENCE.I.
+class WithSodorWriteCombine(timeout: Int = 64) extends Config((site, here, up) => {
+  case TilesLocated(InSubsystem) => up(TilesLocated(InSubsystem), site) map {
+    case tp: SodorTileAttachParams => tp.copy(tileParams = tp.tileParams.copy(
+      core = tp.tileParams.core.copy(writeCombine = Some(timeout))))
+    case other => other
+  }
+})
+
+// Give the 5-stage core `n` match triggers (see triggers.scala). mhpmcounter3
+// and 4 count the cycles and instructions while measuring; with roiOnly, these
+// and the trace output stay off until a start trigger fires.
+class WithSodorTriggers(n: Int = 2, roiOnly: Boolean = true) extends Config((site, here, up) => {
+  case TilesLocated(InSubsystem) => up(TilesLocated(InSubsystem), site) map {
+    case tp: SodorTileAttachParams => tp.copy(tileParams = tp.tileParams.copy(
+      core = tp.tileParams.core.copy(nBreakpoints = n, roiOnly = roiOnly)))
+    case other => other
+  }
+})
+
+// Add the MMIO console (see console.scala) to every Sodor tile. Stores to
+// `address` are printed on the emulator's stdout. Tile i's console is at
+// address + i * SodorTileConsts.deviceStride.
+class WithSodorConsole(address: BigInt = BigInt(0x64000000L)) extends Config((site, here, up) => {
+  case TilesLocated(InSubsystem) => up(TilesLocated(InSubsystem), site) map {
+    case tp: SodorTileAttachParams => tp.copy(tileParams = tp.tileParams.copy(
+      console = Some(address + tp.tileParams.tileId * SodorTileConsts.deviceStride)))
+    case other => other
+  }
+})
+
+// Add the tile-local DMA engine (see dma.scala) to every Sodor tile. Tile i's
+// registers are at address + i * SodorTileConsts.deviceStride.
+class WithSodorDMA(address: BigInt = BigInt(0x64001000L)) extends Config((site, here, up) => {
+  case TilesLocated(InSubsystem) => up(TilesLocated(InSubsystem), site) map {
+    case tp: SodorTileAttachParams => tp.copy(tileParams = tp.tileParams.copy(
+      dma = Some(address + tp.tileParams.tileId * SodorTileConsts.deviceStride)))
+    case other => other
+  }
+})
+
+// Register the TileLink boundary of every Sodor tile, so that each tile and
+// its scratchpad depend on the rest of the system only through registers.
+// A multithreaded Verilator build (--threads, Chipyard's VERILATOR_THREADS)
+// can then evaluate the tiles of a WithNSodorCores(n) system in parallel,
+// one partition per tile. Verilator's threaded model is cycle-exact and
+// deterministic; the registers add a cycle each way to every access that
+// leaves or enters a tile, also in single-threaded builds.
+class WithSodorParallelSim extends Config((site, here, up) => {
+  case TilesLocated(InSubsystem) => up(TilesLocated(InSubsystem), site) map {
+    case tp: SodorTileAttachParams => tp.copy(tileParams = tp.tileParams.copy(partitioned = true))
+    case other => other
+  }
+})
+
+// Time the off-chip memory accesses of every Sodor tile with a simple DRAM
+// model (see dram_model.scala). Simulation only: statistics are printed on
+// exit.
+class WithSodorDRAMModel(params: SodorDRAMParams = SodorDRAMParams()) extends Config((site, here, up) => {
+  case TilesLocated(InSubsystem) => up(TilesLocated(InSubsystem), site) map {
+    case tp: SodorTileAttachParams => tp.copy(tileParams = tp.tileParams.copy(dram = Some(params)))
+    case other => other
+  }
+})
@@ -0,0 +1,38 @@
+package sodor.common
+
+import chisel3._
+import chisel3.util._
+
+// Live telemetry for long emulator runs (see SodorTelemetry.cc and
+// scripts/telemetry.py). Built in with WithSodorTelemetry and enabled at run
+// time with +telemetry=<file>; every hart then publishes its cycles, retired
+// instructions, stall and kill cycles and last retired pc into its slot of
+// the file every +telemetry_interval cycles. Which cycles count as stalled or
+// killed is up to each core.
+class SodorTelemetry extends BlackBox with HasBlackBoxResource {
+  val io = IO(new Bundle {
+    val clock = Input(Clock())
+    val reset = Input(Bool())
+    val hartid = Input(UInt(32.W))
+    val retire = Input(Bool())
+    val pc = Input(UInt(64.W))
+    val stall = Input(Bool())
+    val kill = Input(Bool())
+  })
+  addResource("/sodor/vsrc/SodorTelemetry.v")
+  addResource("/sodor/csrc/SodorTelemetry.cc")
+}
+
+object SodorTelemetry {
+  def apply(hartid: UInt, retire: Bool, pc: UInt, stall: Bool, kill: Bool): SodorTelemetry = {
+    val telemetry = Module(new SodorTelemetry)
+    telemetry.io.clock := Module.clock
+    telemetry.io.reset := Module.reset.asBool
+    telemetry.io.hartid := hartid
+    telemetry.io.retire := retire
+    telemetry.io.pc := pc
+    telemetry.io.stall := stall
+    telemetry.io.kill := kill
+    telemetry
+  }
+}
@@ -0,0 +1,79 @@
+//**************************************************************************
+// Match triggers
+//--------------------------------------------------------------------------
+//
+// The CSR file holds nBreakpoints match triggers (tselect/tdata1/tdata2, see
+// the debug spec's mcontrol). They are checked on the instruction about to
+// commit: its pc for execute triggers, and the address of its load or store
+// for the others. The trigger's action says what a match does:
+//
+//    0  breakpoint exception
+//    1  halt in debug mode (only the debugger can arm these)
+//    2  start measuring
+//    3  stop measuring
+//
+// Actions 2 and 3 are the spec's trace on/off. While not measuring, the core's
+// uarch counters, the per-cycle trace, the pipeline view and the basic-block
+// vectors stand still, so only the region of interest between a start and a
+// stop trigger is profiled. Measuring is on from reset unless roiOnly is set.
+// The instruction that starts measuring is the first one measured; the one
+// that stops it is not.
+
+package sodor.common
+
+import chisel3._
+import chisel3.util._
+
+import org.chipsalliance.cde.config._
+import freechips.rocketchip.rocket.{BP, BreakpointUnit, CSR, Causes, MStatus}
+
+class SodorTriggers(implicit val p: Parameters, val conf: SodorCoreParams) extends Module {
+  val io = IO(new Bundle {
+    val status = Input(new MStatus)
+    val bp = Input(Vec(conf.nBreakpoints, new BP))
+    val valid = Input(Bool()) // an instruction is being checked
+    val pc = Input(UInt(conf.xprlen.W))
+    val load = Input(Bool())
+    val store = Input(Bool())
+    val addr = Input(UInt(conf.xprlen.W))
+    val commit = Input(Bool()) // the checked instruction leaves without a trap
+    val xcpt = Output(Bool())
+    val cause = Output(UInt(conf.xprlen.W))
+    val tval = Output(UInt(conf.xprlen.W))
+    val measure = Output(Bool())
+  })
+
+  val bpu = Module(new BreakpointUnit(conf.nBreakpoints))
+  bpu.io.status := io.status
+  bpu.io.bp := io.bp
+  bpu.io.pc := io.pc(bpu.io.pc.getWidth - 1, 0)
+  bpu.io.ea := io.addr(bpu.io.ea.getWidth - 1, 0)
+  bpu.io.mcontext := 0.U
+  bpu.io.scontext := 0.U
+
+  // Traps: the matching instruction does not commit
+  val debug = io.valid && (bpu.io.debug_if || (io.load && bpu.io.debug_ld) || (io.store && bpu.io.debug_st))
+  val xcpt = io.valid && (bpu.io.xcpt_if || (io.load && bpu.io.xcpt_ld) || (io.store && bpu.io.xcpt_st))
+  io.xcpt := debug || xcpt
+  io.cause := Mux(debug, CSR.debugTriggerCause.U, Causes.breakpoint.U)
+  io.tval := Mux(bpu.io.xcpt_if, io.pc, io.addr)
+
+  // Measurement: toggled by the instruction that matches, once it commits
+  val watch = bpu.io.bpwatch.map(w => w.ivalid(0) || (io.load && w.rvalid(0)) || (io.store && w.wvalid(0)))
+  def action(a: Int) = io.valid && (bpu.io.bpwatch zip watch).map { case (w, m) => m && w.action === a.U }.reduce(_ || _)
+  val measure = RegInit((!conf.roiOnly).B)
+  when (io.commit && action(2)) { measure := true.B }
+  when (io.commit && action(3)) { measure := false.B }
+  io.measure := measure
+}
+
+object SodorTriggers {
+  // Returns the trigger checker, or None when the core has no triggers
+  def apply(status: MStatus, bp: Vec[BP])(implicit p: Parameters, conf: SodorCoreParams): Option[SodorTriggers] =
+    if (conf.nBreakpoints == 0) None else {
+      val triggers = Module(new SodorTriggers)
+      triggers.io.status := status
+      triggers.io.bp := bp
+      Some(triggers)
+    }
+}
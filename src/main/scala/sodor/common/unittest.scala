@@ -0,0 +1,297 @@
+package sodor.common
+
+import chisel3._
+import chisel3.util._
+
+import org.chipsalliance.cde.config._
+import freechips.rocketchip.diplomacy._
+import freechips.rocketchip.tilelink._
+import freechips.rocketchip.unittest._
+
+// Fills a scratchpad through SodorScratchpadAdapter with back-to-back
+// PutFullData bursts, reads it back with Get bursts, and checks that both
+// phases sustain (close to) one scratchpad word per cycle. Then runs a few
+// single-beat accesses that only touch some byte lanes (narrow Gets and Puts,
+// a sparse PutPartial mask) of the last word of a beat and checks the lanes
+// that come back. beatBytes is the width of the bus in front of the adapter;
+// wider than the scratchpad, it goes through the adapter's width widget.
+class SodorScratchpadFill(bytes: Int, beatBytes: Int, blockBytes: Int, useAsync: Boolean)
+  (implicit p: Parameters, conf: SodorCoreParams) extends LazyModule
+{
+  val nSources = 4
+  val wordBytes = conf.xprlen / 8
+  val address = AddressSet(0x80000000L, bytes - 1)
+
+  val master = TLClientNode(Seq(TLMasterPortParameters.v1(
+    clients = Seq(TLMasterParameters.v1(
+      name = "sodor-scratchpad-fill",
+      sourceId = IdRange(0, nSources)
+    ))
+  )))
+  val adapter = LazyModule(new SodorScratchpadAdapter(Seq(address), wordBytes, blockBytes, beatBytes))
+  adapter.node := master
+
+  lazy val module = new Impl
+  class Impl extends LazyModuleImp(this) with UnitTestModule {
+    val memory = Module(if (useAsync) new AsyncScratchPadMemory(num_core_ports = 1, num_bytes = bytes)
+                        else new SyncScratchPadMemory(num_core_ports = 1, num_bytes = bytes))
+    memory.io := DontCare
+    memory.io.core_ports(0).req.valid := false.B
+    memory.io.debug_port <> adapter.module.io.memPort
+
+    val (out, edge) = master.out(0)
+    val lgBeatBytes = log2Ceil(beatBytes)
+    val lgBlockBytes = log2Ceil(blockBytes)
+    val nBursts = bytes / blockBytes
+    val nWords = bytes / wordBytes
+
+    // Every word holds its own address
+    def beatData(addr: UInt) = VecInit(Seq.tabulate(beatBytes / wordBytes)(i =>
+      (addr + (i * wordBytes).U).pad(wordBytes * 8))).asUInt
+
+    val s_idle :: s_write :: s_read :: s_lanes :: s_done :: Nil = Enum(5)
+    val state = RegInit(s_idle)
+    val burst = RegInit(0.U(log2Ceil(nBursts + 1).W))
+    val inflight = RegInit(0.U(log2Ceil(nSources + 1).W))
+    val cycles = RegInit(0.U(32.W))
+    val read_addr = RegInit(address.base.U(32.W))
+
+    val (_, _, a_done, a_beat) = edge.count(out.a)
+    val (_, _, d_done, _) = edge.count(out.d)
+
+    val burst_addr = address.base.U + (burst << lgBlockBytes)
+    val (_, put) = edge.Put(burst(log2Ceil(nSources) - 1, 0), burst_addr, lgBlockBytes.U,
+                            beatData(burst_addr + (a_beat << lgBeatBytes)))
+    val (_, get) = edge.Get(burst(log2Ceil(nSources) - 1, 0), burst_addr, lgBlockBytes.U)
+
+    // Byte-lane accesses, one at a time, to the last word of the first beat:
+    // a Put writes the lanes of mask, a Get checks them
+    case class LaneOp(put: Boolean, offset: Int, lgSize: Int, data: Long, mask: Int)
+    val laneOps = Seq(
+      LaneOp(true,  0, 2, 0x44332211L, 0xf), // PutFull word
+      LaneOp(false, 2, 0, 0x00330000L, 0x4), // Get byte 2
+      LaneOp(false, 2, 1, 0x44330000L, 0xc), // Get upper half
+      LaneOp(true,  0, 2, 0xaa0000bbL, 0x9), // PutPartial, bytes 0 and 3
+      LaneOp(true,  1, 0, 0x0000cc00L, 0x2), // PutFull byte 1
+      LaneOp(false, 0, 2, 0xaa33ccbbL, 0xf), // Get word
+      LaneOp(false, 3, 0, 0xaa000000L, 0x8)) // Get byte 3
+    require(wordBytes == 4, "The byte-lane accesses are written for a 32-bit scratchpad")
+    val laneBase = beatBytes - wordBytes
+    val lane_op = RegInit(0.U(log2Ceil(laneOps.size + 1).W))
+    val lane_waiting = RegInit(false.B)
+    val lane_a = WireDefault(get)
+    laneOps.zipWithIndex.foreach { case (o, i) =>
+      val addr = address.base.U + (laneBase + o.offset).U
+      val data = (BigInt(o.data) << (8 * laneBase)).U((beatBytes * 8).W)
+      val mask = (o.mask << laneBase).U(beatBytes.W)
+      when (lane_op === i.U) {
+        lane_a := (if (!o.put) edge.Get(0.U, addr, o.lgSize.U)._2
+                   else if (o.mask == ((1 << (1 << o.lgSize)) - 1) << o.offset) edge.Put(0.U, addr, o.lgSize.U, data)._2
+                   else edge.Put(0.U, addr, o.lgSize.U, data, mask)._2)
+      }
+    }
+    val lane_expect = VecInit(laneOps.map(o => (BigInt(o.data) << (8 * laneBase)).U((beatBytes * 8).W)))(lane_op)
+    val lane_mask = FillInterleaved(8, VecInit(laneOps.map(o => (o.mask << laneBase).U(beatBytes.W)))(lane_op))
+
+    out.a.valid := Mux(state === s_lanes, lane_op < laneOps.size.U && !lane_waiting,
+      (state === s_write || state === s_read) && burst < nBursts.U && inflight < nSources.U)
+    out.a.bits := Mux(state === s_lanes, lane_a, Mux(state === s_write, put, get))
+    out.d.ready := true.B
+
+    val issued = out.a.fire && a_done
+    val retired = out.d.fire && d_done
+    inflight := inflight + issued - retired
+    when (issued) { burst := burst + 1.U }
+    cycles := cycles + 1.U
+
+    when (state === s_read && out.d.fire && edge.hasData(out.d.bits)) {
+      assert(out.d.bits.data === beatData(read_addr), "Scratchpad read back %x at %x", out.d.bits.data, read_addr)
+      read_addr := read_addr + beatBytes.U
+    }
+
+    // Allow a few cycles of fill/drain latency on top of one word per cycle
+    val phase_done = (state === s_write || state === s_read) && burst === nBursts.U && inflight === retired
+    when (phase_done) {
+      when (state === s_write) { printf("Sodor scratchpad fill (%d-byte bus): %d words in %d cycles\n", beatBytes.U, nWords.U, cycles) }
+      .otherwise { printf("Sodor scratchpad read (%d-byte bus): %d words in %d cycles\n", beatBytes.U, nWords.U, cycles) }
+      assert(cycles <= (nWords + 2 * nBursts + 16).U, "Scratchpad adapter does not sustain one word per cycle")
+      state := Mux(state === s_write, s_read, s_lanes)
+      burst := 0.U
+      cycles := 0.U
+    }
+    when (state === s_idle && io.start) {
+      state := s_write
+      cycles := 0.U
+    }
+
+    when (state === s_lanes && out.a.fire) { lane_waiting := true.B }
+    when (state === s_lanes && out.d.fire) {
+      assert(!edge.hasData(out.d.bits) || (out.d.bits.data & lane_mask) === (lane_expect & lane_mask),
+        "Scratchpad byte-lane access %d read %x, expected %x", lane_op, out.d.bits.data & lane_mask, lane_expect & lane_mask)
+      lane_waiting := false.B
+      lane_op := lane_op + 1.U
+    }
+    when (state === s_lanes && lane_op === laneOps.size.U) { state := s_done }
+
+    io.finished := state === s_done
+  }
+}
+
+class SodorScratchpadAdapterTest(useAsync: Boolean, beatBytes: Int = 4, timeout: Int = 100000)(implicit p: Parameters) extends UnitTest(timeout) {
+  implicit val conf: SodorCoreParams = SodorCoreParams()
+  val dut = Module(LazyModule(new SodorScratchpadFill(bytes = 1 << 14, beatBytes, blockBytes = 64, useAsync)).module)
+  dut.io.start := io.start
+  io.finished := dut.io.finished
+}
+
+// Runs DMI reads of dmstatus through the DebugModule from a stand-in for the
+// host behind SimDTM, which like debug_tick only acts on the cycles
+// SimDTMPoll ticks it. Once the DTM is dormant, one read is queued along with
+// a wake pulse (as from a tohost store) and has to be serviced right away;
+// another is queued without one and has to wait for the poll interval. Last,
+// reads are started after 13 to 17 idle ticks, around the tick that goes
+// dormant; each has to be taken by the DebugModule exactly once.
+class SodorDTMPollTest(interval: Int = 200, timeout: Int = 2000)(implicit p: Parameters) extends UnitTest(timeout) {
+  implicit val conf: SodorCoreParams = SodorCoreParams()
+  val dm = Module(new DebugModule)
+  dm.io := DontCare
+  val poll = Module(new SimDTMPoll)
+
+  val cycle = RegInit(0.U(16.W))
+  val req_valid = RegInit(false.B)
+  val resp_ready = RegInit(false.B)
+  val queued = RegInit(1.U(2.W))
+  val served = RegInit(0.U(4.W))
+  val dormant = RegInit(false.B)
+  val host_idle = RegInit(0.U(8.W))
+  val race = RegInit(0.U(3.W))
+  val started = RegInit(0.U(4.W))
+  val fired = RegInit(0.U(4.W))
+  cycle := cycle + 1.U
+
+  dm.io.dmi.req.valid := req_valid
+  dm.io.dmi.req.bits.op := DMConsts.dmi_OP_READ
+  dm.io.dmi.req.bits.addr := DMI_RegAddrs.DMI_DMSTATUS.U
+  dm.io.dmi.req.bits.data := 0.U
+  dm.io.dmi.resp.ready := resp_ready
+
+  poll.io.interval := interval.U
+  poll.io.req_valid := dm.io.dmi.req.valid
+  poll.io.req_fire := dm.io.dmi.req.fire
+  poll.io.resp_fire := dm.io.dmi.resp.fire
+  poll.io.wake := cycle === 100.U
+  when (!poll.io.tick) { dormant := true.B }
+
+  // The host: one read at a time, started on a tick and retired on a later one
+  val queue = cycle === 90.U || cycle === 150.U
+  val racing = cycle >= (150 + interval + 50).U && race =/= 5.U
+  val start = !req_valid && !resp_ready && (queued =/= 0.U || (racing && host_idle === race +& 13.U))
+  when (poll.io.tick) {
+    host_idle := Mux(req_valid || resp_ready || !racing, 0.U, host_idle + 1.U)
+    when (req_valid && dm.io.dmi.req.ready) { req_valid := false.B }
+    when (resp_ready && dm.io.dmi.resp.valid) {
+      resp_ready := false.B
+      served := served + 1.U
+    } .elsewhen (start) {
+      req_valid := true.B
+      resp_ready := true.B
+      started := started + 1.U
+      when (queued === 0.U) { race := race + 1.U }
+    }
+  }
+  queued := queued + queue - (poll.io.tick && start && queued =/= 0.U)
+  when (dm.io.dmi.req.fire) { fired := fired + 1.U }
+  assert(fired <= started, "The DebugModule takes a DMI request more than once")
+
+  assert(cycle =/= 90.U || (served === 1.U && dormant), "The idle DTM does not go dormant")
+  assert(cycle =/= 110.U || served === 2.U, "The DTM does not service a command after a wake")
+  assert(cycle =/= 250.U || served === 2.U, "The dormant DTM calls the host before the poll interval")
+  assert(cycle =/= (150 + interval + 50).U || served === 3.U, "The DTM does not service a command after the poll interval")
+  io.finished := race === 5.U && served === 8.U && fired === 8.U
+}
+
+// Drives the DebugModule's DMI against a scratchpad: Access Memory commands,
+// some rerun through abstractauto, and a system bus write issued on the cycle
+// after a command, while the command still waits for the shared debug memory
+// port. Reads the words back with Access Memory reads and checks them. Then
+// checks that a command is ignored while cmderr is set, that cmderr is
+// cleared by writing ones to it, and that an Access Register command finishes.
+class SodorDebugMemoryTest(useAsync: Boolean, timeout: Int = 1000)(implicit p: Parameters) extends UnitTest(timeout) {
+  implicit val conf: SodorCoreParams = SodorCoreParams()
+  val dm = Module(new DebugModule)
+  dm.io := DontCare
+  val memory = Module(if (useAsync) new AsyncScratchPadMemory(num_core_ports = 1, num_bytes = 1 << 10)
+                      else new SyncScratchPadMemory(num_core_ports = 1, num_bytes = 1 << 10))
+  memory.io := DontCare
+  memory.io.core_ports(0).req.valid := false.B
+  memory.io.debug_port <> dm.io.debugmem
+
+  import DMI_RegAddrs._
+  val base = 0x80000000L
+  val aamWrite = 0x02290000L // Access Memory, 32 bits, postincrement, write
+  val aamRead = 0x02280000L  // Access Memory, 32 bits, postincrement, read
+  val aamWide = 0x02390000L  // Access Memory, 64 bits: not supported
+  val regRead = 0x00221005L  // Access Register, 32 bits, transfer, read x5
+  // gap: idle cycles before the next access, long enough for a command to finish
+  case class DMIOp(write: Boolean, addr: Int, data: Long, gap: Int = 4)
+  val ops = Seq(
+    DMIOp(true,  DMI_SBADDRESS0, base + 0x10),
+    DMIOp(true,  DMI_DATA0, 0x2222),
+    DMIOp(true,  DMI_DATA0 + 1, base + 0x20),
+    DMIOp(true,  DMI_ABSTRACTAUTO, 1),
+    DMIOp(true,  DMI_COMMAND, aamWrite, gap = 0), // 0x2222 to base + 0x20
+    DMIOp(true,  DMI_SBDATA0, 0x1111),            // to base + 0x10, while the command waits
+    DMIOp(true,  DMI_DATA0, 0x3333),              // autoexec: to base + 0x24
+    DMIOp(true,  DMI_DATA0 + 1, base + 0x10),
+    DMIOp(true,  DMI_COMMAND, aamRead),
+    DMIOp(false, DMI_DATA0, 0x1111),              // autoexec: reads base + 0x14
+    DMIOp(true,  DMI_DATA0 + 1, base + 0x20),
+    DMIOp(true,  DMI_COMMAND, aamRead),
+    DMIOp(false, DMI_DATA0, 0x2222),              // autoexec: reads base + 0x24
+    DMIOp(false, DMI_DATA0, 0x3333),
+    DMIOp(false, DMI_ABSTRACTCS, 0),              // cmderr still 0, not busy
+    DMIOp(true,  DMI_DATA0 + 1, base + 0x30),
+    DMIOp(true,  DMI_COMMAND, aamWide),
+    DMIOp(false, DMI_ABSTRACTCS, 0x200),          // cmderr 2: not supported
+    DMIOp(true,  DMI_COMMAND, aamWrite),          // ignored while cmderr is set
+    DMIOp(false, DMI_ABSTRACTCS, 0x200),
+    DMIOp(false, DMI_DATA0 + 1, base + 0x30),     // not incremented
+    DMIOp(true,  DMI_ABSTRACTCS, 0x700),          // write 1 to clear
+    DMIOp(false, DMI_ABSTRACTCS, 0),
+    DMIOp(true,  DMI_COMMAND, regRead),
+    DMIOp(false, DMI_ABSTRACTCS, 0))              // done, not busy
+
+  val op = RegInit(0.U(log2Ceil(ops.size + 1).W))
+  val gap = RegInit(0.U(3.W))
+  val started = RegInit(false.B)
+  when (io.start) { started := true.B }
+
+  dm.io.dmi.req.valid := started && op < ops.size.U && gap === 0.U
+  dm.io.dmi.req.bits.op := Mux(VecInit(ops.map(_.write.B))(op), DMConsts.dmi_OP_WRITE, DMConsts.dmi_OP_READ)
+  dm.io.dmi.req.bits.addr := VecInit(ops.map(_.addr.U(DMConsts.nDMIAddrSize.W)))(op)
+  dm.io.dmi.req.bits.data := VecInit(ops.map(_.data.U(32.W)))(op)
+  dm.io.dmi.resp.ready := true.B
+
+  val expect = VecInit(ops.map(o => (o.data & 0xffffffffL).U(32.W)))(op)
+  when (gap =/= 0.U) { gap := gap - 1.U }
+  when (dm.io.dmi.req.fire) {
+    assert(dm.io.dmi.resp.valid, "The DMI access %d got no response", op)
+    when (!VecInit(ops.map(_.write.B))(op)) {
+      val data = Mux(dm.io.dmi.req.bits.addr === DMI_ABSTRACTCS.U,
+        dm.io.dmi.resp.bits.data & "h1700".U, dm.io.dmi.resp.bits.data) // cmderr and busy
+      assert(data === expect, "The DMI read %d returned %x, expected %x", op, data, expect)
+    }
+    gap := VecInit(ops.map(_.gap.U(3.W)))(op)
+    op := op + 1.U
+  }
+  io.finished := op === ops.size.U
+}
+
+class WithSodorUnitTests extends Config((site, here, up) => {
+  case UnitTests => (q: Parameters) => Seq(4, 8, 16).flatMap(beatBytes => Seq(
+    Module(new SodorScratchpadAdapterTest(useAsync = true, beatBytes)(q)),
+    Module(new SodorScratchpadAdapterTest(useAsync = false, beatBytes)(q)))) ++ Seq(
+    Module(new SodorDTMPollTest()(q)),
+    Module(new SodorDebugMemoryTest(useAsync = true)(q)),
+    Module(new SodorDebugMemoryTest(useAsync = false)(q)))
+})
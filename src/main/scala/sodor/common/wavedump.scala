@@ -0,0 +1,112 @@
+package sodor.common
+
+import chisel3._
+import chisel3.util._
+
+import Constants._
+
+// Windowed waveform dumping for debug emulators. Instead of dumping the whole
+// run, the waveform is switched on by a trigger and off again after a fixed
+// number of cycles, and only the given hierarchy scopes are recorded.
+//
+// Scopes are instance paths, resolved upwards from the internal tile, e.g.
+// "core", "core.d" or "dmaster_adapter". Build the simulator with FST tracing
+// (verilator --trace-fst) to get a compressed waveform.
+//
+// Run-time options:
+//   +wave=<file>              enable dumping into <file>
+//   +wave_start_cycle=<n>     start n cycles after reset
+//   +wave_start_pc=<hex>      start when the core fetches <hex>
+//   +wave_start_tohost=<hex>  start when <hex> is stored to tohost
+//   +wave_tohost=<hex>        tohost address (default 80001000)
+//   +wave_cycles=<n>          stop after n cycles (default 10000)
+// With no start option, dumping starts right after reset.
+class SodorWaveDump(scopes: Seq[String]) extends BlackBox with HasBlackBoxInline {
+  require(scopes.nonEmpty, "SodorWaveDump needs at least one scope to dump")
+  val io = IO(new Bundle {
+    val clock = Input(Clock())
+    val reset = Input(Bool())
+    val fetch_valid = Input(Bool())
+    val fetch_pc = Input(UInt(32.W))
+    val store_valid = Input(Bool())
+    val store_addr = Input(UInt(32.W))
+    val store_data = Input(UInt(32.W))
+  })
+
+  setInline("SodorWaveDump.v",
+    """module SodorWaveDump (
+      |  input         clock,
+      |  input         reset,
+      |  input         fetch_valid,
+      |  input  [31:0] fetch_pc,
+      |  input         store_valid,
+      |  input  [31:0] store_addr,
+      |  input  [31:0] store_data
+      |);
+      |
+      |  string file;
+      |  reg enabled, has_cycle, has_pc, has_tohost;
+      |  reg [63:0] start_cycle, window, cycle, stop_cycle;
+      |  reg [31:0] start_pc, start_tohost, tohost;
+      |  reg dumping, done;
+      |
+      |  initial begin
+      |    enabled = $value$plusargs("wave=%s", file);
+      |    has_cycle = $value$plusargs("wave_start_cycle=%d", start_cycle);
+      |    has_pc = $value$plusargs("wave_start_pc=%h", start_pc);
+      |    has_tohost = $value$plusargs("wave_start_tohost=%h", start_tohost);
+      |    if (!$value$plusargs("wave_tohost=%h", tohost))
+      |      tohost = 32'h80001000;
+      |    if (!$value$plusargs("wave_cycles=%d", window))
+      |      window = 10000;
+      |    cycle = 0;
+      |    dumping = 0;
+      |    done = 0;
+      |    if (enabled) begin
+      |      $dumpfile(file);
+      |""".stripMargin +
+    scopes.map(s => s"      $$dumpvars(0, $s);\n").mkString +
+    """      $dumpoff;
+      |    end
+      |  end
+      |
+      |  wire trigger = !(has_cycle || has_pc || has_tohost) ||
+      |                 (has_cycle && cycle == start_cycle) ||
+      |                 (has_pc && fetch_valid && fetch_pc == start_pc) ||
+      |                 (has_tohost && store_valid && store_addr == tohost && store_data == start_tohost);
+      |
+      |  always @(posedge clock) begin
+      |    if (enabled && !reset) begin
+      |      cycle <= cycle + 1;
+      |      if (!dumping && !done && trigger) begin
+      |        $display("wave: dumping cycles %0d to %0d into %0s", cycle, cycle + window, file);
+      |        $dumpon;
+      |        dumping <= 1;
+      |        stop_cycle <= cycle + window;
+      |      end
+      |      else if (dumping && cycle == stop_cycle) begin
+      |        $dumpoff;
+      |        $dumpflush;
+      |        dumping <= 0;
+      |        done <= 1;
+      |      end
+      |    end
+      |  end
+      |endmodule
+      |""".stripMargin)
+}
+
+object SodorWaveDump {
+  // Triggers come from the core's instruction fetches and data stores
+  def apply(scopes: Seq[String], imem: MemPortIo, dmem: MemPortIo): SodorWaveDump = {
+    val wave = Module(new SodorWaveDump(scopes))
+    wave.io.clock := Module.clock
+    wave.io.reset := Module.reset.asBool
+    wave.io.fetch_valid := imem.req.fire && imem.req.bits.fcn === M_XRD
+    wave.io.fetch_pc := imem.req.bits.addr
+    wave.io.store_valid := dmem.req.fire && dmem.req.bits.fcn === M_XWR
+    wave.io.store_addr := dmem.req.bits.addr
+    wave.io.store_data := dmem.req.bits.data
+    wave
+  }
+}
@@ -65,18 +65,25 @@ trait ScalarOpConstants
    val REN_X   = false.B
 
    // ALU Operation Signal
-   val ALU_ADD = 1.asUInt(4.W)
-   val ALU_SUB = 2.asUInt(4.W)
-   val ALU_SLL = 3.asUInt(4.W)
-   val ALU_SRL = 4.asUInt(4.W)
-   val ALU_SRA = 5.asUInt(4.W)
-   val ALU_AND = 6.asUInt(4.W)
-   val ALU_OR  = 7.asUInt(4.W)
-   val ALU_XOR = 8.asUInt(4.W)
-   val ALU_SLT = 9.asUInt(4.W)
-   val ALU_SLTU= 10.asUInt(4.W)
-   val ALU_COPY1= 11.asUInt(4.W)
-   val ALU_X   = 0.asUInt(4.W)
+   val ALU_ADD = 1.asUInt(5.W)
+   val ALU_SUB = 2.asUInt(5.W)
+   val ALU_SLL = 3.asUInt(5.W)
+   val ALU_SRL = 4.asUInt(5.W)
+   val ALU_SRA = 5.asUInt(5.W)
+   val ALU_AND = 6.asUInt(5.W)
+   val ALU_OR  = 7.asUInt(5.W)
+   val ALU_XOR = 8.asUInt(5.W)
+   val ALU_SLT = 9.asUInt(5.W)
+   val ALU_SLTU= 10.asUInt(5.W)
+   val ALU_COPY1= 11.asUInt(5.W)
+   val ALU_ADDW= 12.asUInt(5.W) // RV64: 32-bit operation, sign-extended result
+   val ALU_SUBW= 13.asUInt(5.W)
+   val ALU_SLLW= 14.asUInt(5.W)
+   val ALU_SRLW= 15.asUInt(5.W)
+   val ALU_SRAW= 16.asUInt(5.W)
+   val ALU_CZEQZ= 17.asUInt(5.W) // Zicond: op1, or zero if op2 is zero
+   val ALU_CZNEZ= 18.asUInt(5.W) // Zicond: op1, or zero if op2 is not zero
+   val ALU_X   = 0.asUInt(5.W)
 
    // Writeback Select Signal
    val WB_ALU  = 0.asUInt(2.W)
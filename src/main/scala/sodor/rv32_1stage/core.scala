@@ -32,6 +32,8 @@ class CoreIo(implicit val p: Parameters, val conf: SodorCoreParams) extends Bund
   val interrupt = Input(new CoreInterrupts(false))
   val hartid = Input(UInt())
   val reset_vector = Input(UInt())
+  val wfi = Output(Bool()) // asleep in WFI
+  val fence = Output(Bool()) // executing a FENCE or FENCE.I
 }
 
 class Core(implicit val p: Parameters, val conf: SodorCoreParams) extends AbstractCore
@@ -59,7 +61,12 @@ class Core(implicit val p: Parameters, val conf: SodorCoreParams) extends Abstra
   d.io.hartid := io.hartid
   d.io.reset_vector := io.reset_vector
 
+  io.wfi := d.io.dat.csr_stall
+  io.fence := AbstractCore.isFence(d.io.dat.inst)
+
   val mem_ports = List(io.dmem, io.imem)
+  val wfi = io.wfi
+  val fence = io.fence
   val interrupt = io.interrupt
   val hartid = io.hartid
   val reset_vector = io.reset_vector
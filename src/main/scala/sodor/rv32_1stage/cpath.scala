@@ -15,7 +15,7 @@ import sodor.common._
 import sodor.common.Instructions._
 import sodor.stage1.Constants._
 
-class CtlToDatIo extends Bundle()
+class CtlToDatIo(implicit val conf: SodorCoreParams) extends Bundle()
 {
    val stall     = Output(Bool())
    val dmiss     = Output(Bool())
@@ -27,7 +27,7 @@ class CtlToDatIo extends Bundle()
    val rf_wen    = Output(Bool())
    val csr_cmd   = Output(UInt(CSR.SZ.W))
    val exception = Output(Bool())
-   val exception_cause = Output(UInt(32.W))
+   val exception_cause = Output(UInt(conf.xprlen.W))
    val pc_sel_no_xept = Output(UInt(PC_4.getWidth.W))    // Use only for instuction misalignment detection
 }
 
@@ -46,6 +46,34 @@ class CtlPath(implicit val conf: SodorCoreParams) extends Module
   val io = IO(new CpathIo())
   io := DontCare
 
+   // Immediate shifts take a 6-bit shamt on RV64
+   val (slli, srai, srli) = if (conf.xprlen == 64) (SLLI, SRAI, SRLI) else (SLLI_RV32, SRAI_RV32, SRLI_RV32)
+
+   // RV64I: doubleword loads and stores, and the *W instructions, which
+   // operate on the low 32 bits and sign-extend the result
+   val rv64_insts = if (conf.xprlen != 64) Array[(BitPat, List[UInt])]() else Array(
+                  LD      -> List(Y, BR_N  , OP1_RS1, OP2_IMI , ALU_ADD ,  WB_MEM, REN_1, MEN_1, M_XRD, MT_D,  CSR.N),
+                  LWU     -> List(Y, BR_N  , OP1_RS1, OP2_IMI , ALU_ADD ,  WB_MEM, REN_1, MEN_1, M_XRD, MT_WU, CSR.N),
+                  SD      -> List(Y, BR_N  , OP1_RS1, OP2_IMS , ALU_ADD ,  WB_X  , REN_0, MEN_1, M_XWR, MT_D,  CSR.N),
+
+                  ADDIW   -> List(Y, BR_N  , OP1_RS1, OP2_IMI , ALU_ADDW,  WB_ALU, REN_1, MEN_0, M_X  , MT_X,  CSR.N),
+                  SLLIW   -> List(Y, BR_N  , OP1_RS1, OP2_IMI , ALU_SLLW,  WB_ALU, REN_1, MEN_0, M_X  , MT_X,  CSR.N),
+                  SRAIW   -> List(Y, BR_N  , OP1_RS1, OP2_IMI , ALU_SRAW,  WB_ALU, REN_1, MEN_0, M_X  , MT_X,  CSR.N),
+                  SRLIW   -> List(Y, BR_N  , OP1_RS1, OP2_IMI , ALU_SRLW,  WB_ALU, REN_1, MEN_0, M_X  , MT_X,  CSR.N),
+
+                  ADDW    -> List(Y, BR_N  , OP1_RS1, OP2_RS2 , ALU_ADDW,  WB_ALU, REN_1, MEN_0, M_X  , MT_X,  CSR.N),
+                  SUBW    -> List(Y, BR_N  , OP1_RS1, OP2_RS2 , ALU_SUBW,  WB_ALU, REN_1, MEN_0, M_X  , MT_X,  CSR.N),
+                  SLLW    -> List(Y, BR_N  , OP1_RS1, OP2_RS2 , ALU_SLLW,  WB_ALU, REN_1, MEN_0, M_X  , MT_X,  CSR.N),
+                  SRAW    -> List(Y, BR_N  , OP1_RS1, OP2_RS2 , ALU_SRAW,  WB_ALU, REN_1, MEN_0, M_X  , MT_X,  CSR.N),
+                  SRLW    -> List(Y, BR_N  , OP1_RS1, OP2_RS2 , ALU_SRLW,  WB_ALU, REN_1, MEN_0, M_X  , MT_X,  CSR.N)
+                  )
+
+   // Zicond: select rs1 or zero on rs2, in place of a data-dependent branch
+   val zicond_insts = if (!conf.useConditionalZero) Array[(BitPat, List[UInt])]() else Array(
+                  CZERO_EQZ -> List(Y, BR_N  , OP1_RS1, OP2_RS2 , ALU_CZEQZ, WB_ALU, REN_1, MEN_0, M_X  , MT_X,  CSR.N),
+                  CZERO_NEZ -> List(Y, BR_N  , OP1_RS1, OP2_RS2 , ALU_CZNEZ, WB_ALU, REN_1, MEN_0, M_X  , MT_X,  CSR.N)
+                  )
+
    val csignals =
       ListLookup(io.dat.inst,
                              List(N, BR_N  , OP1_X  ,  OP2_X  , ALU_X   , WB_X   , REN_0, MEN_0, M_X  , MT_X,  CSR.N),
@@ -69,9 +97,9 @@ class CtlPath(implicit val conf: SodorCoreParams) extends Module
                   XORI    -> List(Y, BR_N  , OP1_RS1, OP2_IMI , ALU_XOR ,  WB_ALU, REN_1, MEN_0, M_X  , MT_X,  CSR.N),
                   SLTI    -> List(Y, BR_N  , OP1_RS1, OP2_IMI , ALU_SLT ,  WB_ALU, REN_1, MEN_0, M_X  , MT_X,  CSR.N),
                   SLTIU   -> List(Y, BR_N  , OP1_RS1, OP2_IMI , ALU_SLTU,  WB_ALU, REN_1, MEN_0, M_X  , MT_X,  CSR.N),
-                  SLLI_RV32->List(Y, BR_N  , OP1_RS1, OP2_IMI , ALU_SLL ,  WB_ALU, REN_1, MEN_0, M_X  , MT_X,  CSR.N),
-                  SRAI_RV32->List(Y, BR_N  , OP1_RS1, OP2_IMI , ALU_SRA ,  WB_ALU, REN_1, MEN_0, M_X  , MT_X,  CSR.N),
-                  SRLI_RV32->List(Y, BR_N  , OP1_RS1, OP2_IMI , ALU_SRL ,  WB_ALU, REN_1, MEN_0, M_X  , MT_X,  CSR.N),
+                  slli    -> List(Y, BR_N  , OP1_RS1, OP2_IMI , ALU_SLL ,  WB_ALU, REN_1, MEN_0, M_X  , MT_X,  CSR.N),
+                  srai    -> List(Y, BR_N  , OP1_RS1, OP2_IMI , ALU_SRA ,  WB_ALU, REN_1, MEN_0, M_X  , MT_X,  CSR.N),
+                  srli    -> List(Y, BR_N  , OP1_RS1, OP2_IMI , ALU_SRL ,  WB_ALU, REN_1, MEN_0, M_X  , MT_X,  CSR.N),
 
                   SLL     -> List(Y, BR_N  , OP1_RS1, OP2_RS2 , ALU_SLL ,  WB_ALU, REN_1, MEN_0, M_X  , MT_X,  CSR.N),
                   ADD     -> List(Y, BR_N  , OP1_RS1, OP2_RS2 , ALU_ADD ,  WB_ALU, REN_1, MEN_0, M_X  , MT_X,  CSR.N),
@@ -104,12 +132,12 @@ class CtlPath(implicit val conf: SodorCoreParams) extends Module
                   MRET    -> List(Y, BR_N  , OP1_X  , OP2_X  ,  ALU_X    , WB_X  , REN_0, MEN_0, M_X  , MT_X,  CSR.I),
                   DRET    -> List(Y, BR_N  , OP1_X  , OP2_X  ,  ALU_X    , WB_X  , REN_0, MEN_0, M_X  , MT_X,  CSR.I),
                   EBREAK  -> List(Y, BR_N  , OP1_X  , OP2_X  ,  ALU_X    , WB_X  , REN_0, MEN_0, M_X  , MT_X,  CSR.I),
-                  WFI     -> List(Y, BR_N  , OP1_X  , OP2_X  ,  ALU_X    , WB_X  , REN_0, MEN_0, M_X  , MT_X,  CSR.N), // implemented as a NOP
+                  WFI     -> List(Y, BR_N  , OP1_X  , OP2_X  ,  ALU_X    , WB_X  , REN_0, MEN_0, M_X  , MT_X,  CSR.I),
 
                   FENCE_I -> List(Y, BR_N  , OP1_X  , OP2_X  ,  ALU_X    , WB_X  , REN_0, MEN_0, M_X  , MT_X,  CSR.N),
                   FENCE   -> List(Y, BR_N  , OP1_X  , OP2_X  ,  ALU_X    , WB_X  , REN_0, MEN_0, M_X  , MT_X,  CSR.N)
                   // we are already sequentially consistent, so no need to honor the fence instruction
-                  ))
+                  ) ++ rv64_insts ++ zicond_insts)
 
    // Put these control signals into variables
    val (cs_val_inst: Bool) :: cs_br_type         :: cs_op1_sel            :: cs_op2_sel :: cs0 = csignals
@@ -117,8 +145,7 @@ class CtlPath(implicit val conf: SodorCoreParams) extends Module
    val (cs_mem_en: Bool)   :: cs_mem_fcn         :: cs_msk_sel            :: cs_csr_cmd :: Nil = cs1
 
    // Branch Logic
-   val ctrl_pc_sel_no_xept =  Mux(io.dat.csr_interrupt ,  PC_EXC,
-                              Mux(cs_br_type === BR_N  ,  PC_4,
+   val ctrl_pc_sel_no_xept =  Mux(cs_br_type === BR_N  ,  PC_4,
                               Mux(cs_br_type === BR_NE ,  Mux(!io.dat.br_eq,  PC_BR, PC_4),
                               Mux(cs_br_type === BR_EQ ,  Mux( io.dat.br_eq,  PC_BR, PC_4),
                               Mux(cs_br_type === BR_GE ,  Mux(!io.dat.br_lt,  PC_BR, PC_4),
@@ -127,22 +154,27 @@ class CtlPath(implicit val conf: SodorCoreParams) extends Module
                               Mux(cs_br_type === BR_LTU,  Mux( io.dat.br_ltu, PC_BR, PC_4),
                               Mux(cs_br_type === BR_J  ,  PC_J,
                               Mux(cs_br_type === BR_JR ,  PC_JR,
-                                                          PC_4))))))))))
+                                                          PC_4)))))))))
    val ctrl_pc_sel = Mux(io.ctl.exception || io.dat.csr_eret, PC_EXC, ctrl_pc_sel_no_xept)
 
+   // A pending interrupt is taken on the instruction just fetched, before it has
+   // any side effect, and goes through the CSR file like an exception
+   val interrupt = io.dat.csr_interrupt && io.imem.resp.valid
+
    // mem_en suppression: no new memory request shall be issued after the memory operation of the current instruction is done.
    // Once we get a new instruction, we reset this flag.
    val reg_mem_en = RegInit(false.B)
    when (io.dmem.resp.valid) {
       reg_mem_en := false.B
    } .elsewhen (io.imem.resp.valid) {
-      reg_mem_en := cs_mem_en
+      reg_mem_en := cs_mem_en && !interrupt
    }
-   val mem_en = Mux(io.imem.resp.valid, cs_mem_en, reg_mem_en)
+   val mem_en = Mux(io.imem.resp.valid, cs_mem_en && !interrupt, reg_mem_en)
 
    val data_misaligned = Wire(Bool())
    io.ctl.dmiss := !((mem_en && (io.dmem.resp.valid || data_misaligned)) || !mem_en)
-   val stall =  io.dat.imiss || io.ctl.dmiss
+   // After a WFI the instruction that follows waits here until an interrupt is pending
+   val stall =  io.dat.imiss || io.ctl.dmiss || io.dat.csr_stall
 
 
    // Set the data-path control signals
@@ -159,7 +191,7 @@ class CtlPath(implicit val conf: SodorCoreParams) extends Module
    val csr_ren = (cs_csr_cmd === CSR.S || cs_csr_cmd === CSR.C) && rs1_addr === 0.U
    val csr_cmd = Mux(csr_ren, CSR.R, cs_csr_cmd)
 
-   io.ctl.csr_cmd  := Mux(stall, CSR.N, csr_cmd)
+   io.ctl.csr_cmd  := Mux(stall || interrupt, CSR.N, csr_cmd)
 
    // Memory Requests
    io.dmem.req.valid    := mem_en && !io.ctl.exception
@@ -179,11 +211,12 @@ class CtlPath(implicit val conf: SodorCoreParams) extends Module
 
    // Set exception flag and cause
    // Exception priority matters!
-   io.ctl.exception := illegal || io.dat.inst_misaligned || data_misaligned
-   io.ctl.exception_cause :=  Mux(illegal,                Causes.illegal_instruction.U,
+   io.ctl.exception := (interrupt || illegal || io.dat.inst_misaligned || data_misaligned) && !io.dat.csr_stall
+   io.ctl.exception_cause :=  Mux(interrupt,              io.dat.csr_interrupt_cause,
+                              Mux(illegal,                Causes.illegal_instruction.U,
                               Mux(io.dat.inst_misaligned, Causes.misaligned_fetch.U,
                               Mux(mem_store,              Causes.misaligned_store.U,
                                                           Causes.misaligned_load.U
-                              )))
+                              ))))
 
 }
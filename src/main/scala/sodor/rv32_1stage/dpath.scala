@@ -26,6 +26,8 @@ class DatToCtlIo(implicit val conf: SodorCoreParams) extends Bundle()
    val br_ltu = Output(Bool())
    val csr_eret = Output(Bool())
    val csr_interrupt = Output(Bool())
+   val csr_interrupt_cause = Output(UInt(conf.xprlen.W))
+   val csr_stall = Output(Bool()) // asleep in WFI until an interrupt is pending
    val inst_misaligned = Output(Bool())
    val mem_address_low = Output(UInt(3.W))
 }
@@ -51,16 +53,13 @@ class DatPath(implicit val p: Parameters, val conf: SodorCoreParams) extends Mod
    val tval_data_ma = Wire(UInt(conf.xprlen.W))
    val tval_inst_ma = Wire(UInt(conf.xprlen.W))
 
-   // Interrupt kill
-   val interrupt_edge = Wire(Bool())
-
    // Instruction Fetch
-   val pc_next          = Wire(UInt(32.W))
-   val pc_plus4         = Wire(UInt(32.W))
-   val br_target        = Wire(UInt(32.W))
-   val jmp_target       = Wire(UInt(32.W))
-   val jump_reg_target  = Wire(UInt(32.W))
-   val exception_target = Wire(UInt(32.W))
+   val pc_next          = Wire(UInt(conf.xprlen.W))
+   val pc_plus4         = Wire(UInt(conf.xprlen.W))
+   val br_target        = Wire(UInt(conf.xprlen.W))
+   val jmp_target       = Wire(UInt(conf.xprlen.W))
+   val jump_reg_target  = Wire(UInt(conf.xprlen.W))
+   val exception_target = Wire(UInt(conf.xprlen.W))
 
    // PC Register
    pc_next := MuxCase(pc_plus4, Array(
@@ -82,19 +81,20 @@ class DatPath(implicit val p: Parameters, val conf: SodorCoreParams) extends Mod
 
 
    // Instruction memory buffer to store instruction during multicycle data request
+   // (on RV64 the fetched word is in the low half of the response)
    io.dat.imiss := (io.imem.req.valid && !io.imem.resp.valid)
    val reg_dmiss = RegNext(io.ctl.dmiss, false.B)
    val if_inst_buffer = RegInit(0.U(32.W))
    when (io.imem.resp.valid) {
       assert(!reg_dmiss, "instruction arrived during data miss")
-      if_inst_buffer := io.imem.resp.bits.data
+      if_inst_buffer := io.imem.resp.bits.data(31, 0)
    }
 
    io.imem.req.bits.fcn := M_XRD
    io.imem.req.bits.typ := MT_WU
    io.imem.req.bits.addr := pc_reg
    io.imem.req.valid := !reg_dmiss
-   val inst = Mux(reg_dmiss, if_inst_buffer, io.imem.resp.bits.data)
+   val inst = Mux(reg_dmiss, if_inst_buffer, io.imem.resp.bits.data(31, 0))
 
    // Instruction misalign detection
    // In control path, instruction misalignment exception is always raised in the next cycle once the misaligned instruction reaches
@@ -114,7 +114,7 @@ class DatPath(implicit val p: Parameters, val conf: SodorCoreParams) extends Mod
    val wb_addr  = inst(RD_MSB,  RD_LSB)
 
    val wb_data = Wire(UInt(conf.xprlen.W))
-   val wb_wen = io.ctl.rf_wen && !io.ctl.exception && !interrupt_edge
+   val wb_wen = io.ctl.rf_wen && !io.ctl.exception
 
    // Register File
    val regfile = Mem(32, UInt(conf.xprlen.W))
@@ -144,11 +144,11 @@ class DatPath(implicit val p: Parameters, val conf: SodorCoreParams) extends Mod
    val imm_z = Cat(Fill(27,0.U), inst(19,15))
 
    // sign-extend immediates
-   val imm_i_sext = Cat(Fill(20,imm_i(11)), imm_i)
-   val imm_s_sext = Cat(Fill(20,imm_s(11)), imm_s)
-   val imm_b_sext = Cat(Fill(19,imm_b(11)), imm_b, 0.U)
-   val imm_u_sext = Cat(imm_u, Fill(12,0.U))
-   val imm_j_sext = Cat(Fill(11,imm_j(19)), imm_j, 0.U)
+   val imm_i_sext = Cat(Fill(conf.xprlen-12,imm_i(11)), imm_i)
+   val imm_s_sext = Cat(Fill(conf.xprlen-12,imm_s(11)), imm_s)
+   val imm_b_sext = Cat(Fill(conf.xprlen-13,imm_b(11)), imm_b, 0.U)
+   val imm_u_sext = Cat(Fill(conf.xprlen-32,imm_u(19)), imm_u, Fill(12,0.U))
+   val imm_j_sext = Cat(Fill(conf.xprlen-21,imm_j(19)), imm_j, 0.U)
 
 
    val alu_op1 = MuxCase(0.U, Array(
@@ -169,7 +169,18 @@ class DatPath(implicit val p: Parameters, val conf: SodorCoreParams) extends Mod
    // ALU
    val alu_out   = Wire(UInt(conf.xprlen.W))
 
-   val alu_shamt = alu_op2(4,0).asUInt
+   val alu_shamt = alu_op2(log2Ceil(conf.xprlen)-1,0).asUInt
+
+   // RV64 *W operations: computed on the low 32 bits, result sign-extended
+   def sext_w(x: UInt) = Cat(Fill(conf.xprlen-32, x(31)), x(31, 0))
+   val alu_shamt_w = alu_op2(4,0).asUInt
+   val alu_w_ops = if (conf.xprlen != 64) Nil else Seq(
+                  (io.ctl.alu_fun === ALU_ADDW) -> sext_w(alu_op1 + alu_op2),
+                  (io.ctl.alu_fun === ALU_SUBW) -> sext_w(alu_op1 - alu_op2),
+                  (io.ctl.alu_fun === ALU_SLLW) -> sext_w(alu_op1 << alu_shamt_w),
+                  (io.ctl.alu_fun === ALU_SRLW) -> sext_w(alu_op1(31,0) >> alu_shamt_w),
+                  (io.ctl.alu_fun === ALU_SRAW) -> sext_w((alu_op1(31,0).asSInt >> alu_shamt_w).asUInt)
+                  )
 
    alu_out := MuxCase(0.U, Array(
                   (io.ctl.alu_fun === ALU_ADD)  -> (alu_op1 + alu_op2).asUInt,
@@ -182,8 +193,10 @@ class DatPath(implicit val p: Parameters, val conf: SodorCoreParams) extends Mod
                   (io.ctl.alu_fun === ALU_SLL)  -> ((alu_op1 << alu_shamt)(conf.xprlen-1, 0)).asUInt,
                   (io.ctl.alu_fun === ALU_SRA)  -> (alu_op1.asSInt >> alu_shamt).asUInt,
                   (io.ctl.alu_fun === ALU_SRL)  -> (alu_op1 >> alu_shamt).asUInt,
-                  (io.ctl.alu_fun === ALU_COPY1)-> alu_op1
-                  ))
+                  (io.ctl.alu_fun === ALU_COPY1)-> alu_op1,
+                  (io.ctl.alu_fun === ALU_CZEQZ)-> Mux(alu_op2 === 0.U, 0.U, alu_op1),
+                  (io.ctl.alu_fun === ALU_CZNEZ)-> Mux(alu_op2 =/= 0.U, 0.U, alu_op1)
+                  ) ++ alu_w_ops)
 
    // Branch/Jump Target Calculation
    br_target       := pc_reg + imm_b_sext
@@ -210,21 +223,21 @@ class DatPath(implicit val p: Parameters, val conf: SodorCoreParams) extends Mod
                   (io.ctl.exception_cause === Causes.misaligned_load.U)  -> tval_data_ma,
                   ))
 
-   // Interrupt rising edge detector (output trap signal for one cycle on rising edge)
-   val reg_interrupt_edge = RegInit(false.B)
-   when (!io.ctl.stall) {
-      reg_interrupt_edge := csr.io.interrupt
-   }
-   interrupt_edge := csr.io.interrupt && !reg_interrupt_edge
-
    io.dat.csr_eret := csr.io.eret
 
    csr.io.interrupts := io.interrupt
    csr.io.hartid := io.hartid
-   io.dat.csr_interrupt := interrupt_edge
+   io.dat.csr_interrupt := csr.io.interrupt
+   io.dat.csr_interrupt_cause := csr.io.interrupt_cause
    csr.io.cause := Mux(io.ctl.exception, io.ctl.exception_cause, csr.io.interrupt_cause)
    csr.io.ungated_clock := clock
 
+   // WFI: no fetch while the CSR file holds the hart asleep
+   io.dat.csr_stall := csr.io.csr_stall
+   when (csr.io.csr_stall) {
+      io.imem.req.valid := false.B
+   }
+
    // Add your own uarch counters here!
    csr.io.counters.foreach(_.inc := false.B)
 
@@ -251,6 +264,33 @@ class DatPath(implicit val p: Parameters, val conf: SodorCoreParams) extends Mod
    io.dat.mem_address_low := alu_out(2, 0)
    tval_data_ma := alu_out
 
+   // Co-simulation: check every retired instruction against the reference model
+   if (conf.useCosim)
+   {
+      val cosim = SodorCosim(io.hartid)
+      cosim.io.commit_valid   := !io.ctl.stall && !io.ctl.exception
+      cosim.io.commit_pc      := pc_reg
+      cosim.io.commit_inst    := inst
+      cosim.io.commit_wen     := wb_wen
+      cosim.io.commit_rd      := wb_addr
+      cosim.io.commit_wdata   := wb_data
+      cosim.io.trap_valid     := !io.ctl.stall && io.ctl.exception
+      cosim.io.trap_interrupt := io.ctl.exception_cause(conf.xprlen-1)
+      cosim.io.trap_target    := exception_target
+   }
+
+   // Basic-block vector profiling from the retire valid/pc shown in the trace below
+   if (conf.useBBV)
+   {
+      SodorBBV(io.hartid, csr.io.retire, pc_reg)
+   }
+
+   // Live telemetry; a trap throws away the instruction it is taken on
+   if (conf.useTelemetry)
+   {
+      SodorTelemetry(io.hartid, csr.io.retire, pc_reg, io.ctl.stall, io.ctl.exception)
+   }
+
    // Printout
    // pass output through the spike-dasm binary (found in riscv-tools) to turn
    // the DASM(%x) into a disassembly string.
@@ -285,7 +325,7 @@ class DatPath(implicit val p: Parameters, val conf: SodorCoreParams) extends Mod
          val rd = inst(RD_MSB,RD_LSB)
          when (io.ctl.rf_wen && rd =/= 0.U)
          {
-            printf("@@@ 0x%x (0x%x) x%d 0x%x\n", pc_reg, inst, rd, Cat(Fill(32,wb_data(31)),wb_data))
+            printf("@@@ 0x%x (0x%x) x%d 0x%x\n", pc_reg, inst, rd, Cat(Fill(64-conf.xprlen,wb_data(conf.xprlen-1)),wb_data))
          }
          .otherwise
          {
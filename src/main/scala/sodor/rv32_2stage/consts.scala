@@ -77,6 +77,8 @@ trait ScalarOpConstants
    val ALU_SLT = 9.asUInt(4.W)
    val ALU_SLTU= 10.asUInt(4.W)
    val ALU_COPY1 = 11.asUInt(4.W)
+   val ALU_CZEQZ = 12.asUInt(4.W) // Zicond: op1, or zero if op2 is zero
+   val ALU_CZNEZ = 13.asUInt(4.W) // Zicond: op1, or zero if op2 is not zero
    val ALU_X   = 0.asUInt(4.W)
 
    // Writeback Address Select Signal
@@ -49,6 +49,12 @@ class CtlPath(implicit val conf: SodorCoreParams) extends Module
   val io = IO(new CpathIo())
   io := DontCare
 
+   // Zicond: select rs1 or zero on rs2, in place of a data-dependent branch
+   val zicond_insts = if (!conf.useConditionalZero) Array[(BitPat, List[UInt])]() else Array(
+                  CZERO_EQZ -> List(Y, BR_N  , OP1_RS1, OP2_RS2 , ALU_CZEQZ, WB_ALU, REN_1, MEN_0, M_X  , MT_X,  CSR.N),
+                  CZERO_NEZ -> List(Y, BR_N  , OP1_RS1, OP2_RS2 , ALU_CZNEZ, WB_ALU, REN_1, MEN_0, M_X  , MT_X,  CSR.N)
+                  )
+
    val csignals =
       ListLookup(io.dat.inst,
                             List(N, BR_N  , OP1_X  , OP2_X   , ALU_X   , WB_X  , REN_0, MEN_0, M_X   ,MT_X,  CSR.N),
@@ -107,13 +113,13 @@ class CtlPath(implicit val conf: SodorCoreParams) extends Module
                   MRET    -> List(Y, BR_N  , OP1_X  , OP2_X  ,  ALU_X    , WB_X  , REN_0, MEN_0, M_X  , MT_X,  CSR.I),
                   DRET    -> List(Y, BR_N  , OP1_X  , OP2_X  ,  ALU_X    , WB_X  , REN_0, MEN_0, M_X  , MT_X,  CSR.I),
                   EBREAK  -> List(Y, BR_N  , OP1_X  , OP2_X  ,  ALU_X    , WB_X  , REN_0, MEN_0, M_X  , MT_X,  CSR.I),
-                  WFI    -> List(Y, BR_N  , OP1_X  , OP2_X  ,  ALU_X    , WB_X , REN_0, MEN_0, M_X  , MT_X,  CSR.N), // implemented as a NOP
+                  WFI    -> List(Y, BR_N  , OP1_X  , OP2_X  ,  ALU_X    , WB_X , REN_0, MEN_0, M_X  , MT_X,  CSR.I),
 
                   FENCE_I-> List(Y, BR_N  , OP1_X  , OP2_X  ,  ALU_X    , WB_X , REN_0, MEN_0, M_X  , MT_X,  CSR.N),
                   FENCE  -> List(Y, BR_N  , OP1_X  , OP2_X  ,  ALU_X    , WB_X , REN_0, MEN_0, M_X  , MT_X,  CSR.N)
                   // we are already sequentially consistent, so no need to honor the fence instruction
 
-                  ))
+                  ) ++ zicond_insts)
 
      // Put these control signals in variables
    val (cs_val_inst: Bool) :: cs_br_type :: cs_op1_sel :: cs_op2_sel :: cs_alu_fun :: cs_wb_sel :: cs0 = csignals
@@ -121,8 +127,7 @@ class CtlPath(implicit val conf: SodorCoreParams) extends Module
 
 
    // Branch Logic
-   val ctrl_pc_sel_no_xept =  Mux(io.dat.csr_interrupt , PC_EXC,
-                              Mux(cs_br_type === BR_N  , PC_4,
+   val ctrl_pc_sel_no_xept =  Mux(cs_br_type === BR_N  , PC_4,
                               Mux(cs_br_type === BR_NE , Mux(!io.dat.br_eq,  PC_BR, PC_4),
                               Mux(cs_br_type === BR_EQ , Mux( io.dat.br_eq,  PC_BR, PC_4),
                               Mux(cs_br_type === BR_GE , Mux(!io.dat.br_lt,  PC_BR, PC_4),
@@ -131,11 +136,21 @@ class CtlPath(implicit val conf: SodorCoreParams) extends Module
                               Mux(cs_br_type === BR_LTU, Mux( io.dat.br_ltu, PC_BR, PC_4),
                               Mux(cs_br_type === BR_J  , PC_J,
                               Mux(cs_br_type === BR_JR , PC_JR,
-                                                         PC_4))))))))))
+                                                         PC_4)))))))))
    val ctrl_pc_sel = Mux(io.ctl.exception || io.dat.csr_eret, PC_EXC, ctrl_pc_sel_no_xept)
 
+   // A pending interrupt is taken on the instruction in execute in its first cycle,
+   // before it has any side effect, and goes through the CSR file like an exception
+   // After a WFI the instruction in execute waits, without side effects, until
+   // an interrupt is pending; it then counts as being in its first cycle.
+   val stall = Wire(Bool())
+   val asleep = io.dat.csr_stall
+   val exe_first = RegNext(!stall || asleep, false.B)
+   val interrupt = io.dat.csr_interrupt && io.dat.exe_valid && exe_first && io.dat.if_valid_resp && !asleep
+   val mem_en = cs_mem_en && !interrupt && !asleep
+
    // stall entire pipeline on I$ or D$ miss
-   val stall = !io.dat.if_valid_resp || !((cs_mem_en && (io.dmem.resp.valid || io.dat.data_misaligned)) || !cs_mem_en)
+   stall := asleep || !io.dat.if_valid_resp || !((mem_en && (io.dmem.resp.valid || io.dat.data_misaligned)) || !mem_en)
 
    val ifkill = !(ctrl_pc_sel === PC_4)
 
@@ -154,13 +169,13 @@ class CtlPath(implicit val conf: SodorCoreParams) extends Module
    val csr_ren = (cs_csr_cmd === CSR.S || cs_csr_cmd === CSR.C) && rs1_addr === 0.U
    val csr_cmd = Mux(csr_ren, CSR.R, cs_csr_cmd)
 
-   io.ctl.csr_cmd    := Mux(stall, CSR.N, csr_cmd)
+   io.ctl.csr_cmd    := Mux(stall || interrupt, CSR.N, csr_cmd)
 
-   io.dmem.req.valid    := cs_mem_en && !io.dat.data_misaligned
+   io.dmem.req.valid    := mem_en && !io.dat.data_misaligned
    io.dmem.req.bits.fcn := cs_mem_fcn
    io.dmem.req.bits.typ := cs_msk_sel
 
-   io.ctl.mem_val    := cs_mem_en
+   io.ctl.mem_val    := mem_en
    io.ctl.mem_fcn    := cs_mem_fcn
    io.ctl.mem_typ    := cs_msk_sel
 
@@ -168,11 +183,12 @@ class CtlPath(implicit val conf: SodorCoreParams) extends Module
    io.ctl.pc_sel_no_xept := ctrl_pc_sel_no_xept
    val illegal = (!cs_val_inst && io.imem.resp.valid)
    // Exception priority matters!
-   io.ctl.exception := (illegal || io.dat.inst_misaligned || io.dat.data_misaligned) && !io.dat.csr_eret
-   io.ctl.exception_cause :=  Mux(illegal,                Causes.illegal_instruction.U,
+   io.ctl.exception := interrupt || ((illegal || io.dat.inst_misaligned || io.dat.data_misaligned) && !io.dat.csr_eret && !asleep)
+   io.ctl.exception_cause :=  Mux(interrupt,              io.dat.csr_interrupt_cause,
+                              Mux(illegal,                Causes.illegal_instruction.U,
                               Mux(io.dat.inst_misaligned, Causes.misaligned_fetch.U,
                               Mux(io.dat.mem_store,       Causes.misaligned_store.U,
                                                           Causes.misaligned_load.U
-                              )))
+                              ))))
 
 }
@@ -29,6 +29,9 @@ class DatToCtlIo(implicit val conf: SodorCoreParams) extends Bundle()
    val mem_store = Output(Bool())
    val csr_eret = Output(Bool())
    val csr_interrupt = Output(Bool())
+   val csr_interrupt_cause = Output(UInt(conf.xprlen.W))
+   val csr_stall = Output(Bool()) // asleep in WFI until an interrupt is pending
+   val exe_valid = Output(Bool())
 }
 
 class DpathIo(implicit val p: Parameters, val conf: SodorCoreParams) extends Bundle()
@@ -204,7 +207,9 @@ class DatPath(implicit val p: Parameters, val conf: SodorCoreParams) extends Mod
                   (io.ctl.alu_fun === ALU_SLL)  -> ((exe_alu_op1 << alu_shamt)(conf.xprlen-1, 0)).asUInt,
                   (io.ctl.alu_fun === ALU_SRA)  -> (exe_alu_op1.asSInt >> alu_shamt).asUInt,
                   (io.ctl.alu_fun === ALU_SRL)  -> (exe_alu_op1 >> alu_shamt).asUInt,
-                  (io.ctl.alu_fun === ALU_COPY1)-> exe_alu_op1
+                  (io.ctl.alu_fun === ALU_COPY1)-> exe_alu_op1,
+                  (io.ctl.alu_fun === ALU_CZEQZ)-> Mux(exe_alu_op2 === 0.U, 0.U, exe_alu_op1),
+                  (io.ctl.alu_fun === ALU_CZNEZ)-> Mux(exe_alu_op2 =/= 0.U, 0.U, exe_alu_op1)
                   ))
 
    // Branch/Jump Target Calculation
@@ -245,19 +250,19 @@ class DatPath(implicit val p: Parameters, val conf: SodorCoreParams) extends Mod
                   (io.ctl.exception_cause === Causes.misaligned_load.U)  -> tval_data_ma,
                   ))
 
-   // Interrupt rising edge detector (output trap signal for one cycle on rising edge)
-   val reg_interrupt_handled = RegInit(false.B)
-   when (!io.ctl.stall) {
-      reg_interrupt_handled := csr.io.interrupt
-   }
-   val interrupt_edge = csr.io.interrupt && !reg_interrupt_handled
-
    csr.io.interrupts := io.interrupt
    csr.io.hartid := io.hartid
-   io.dat.csr_interrupt := interrupt_edge
+   io.dat.csr_interrupt := csr.io.interrupt
+   io.dat.csr_interrupt_cause := csr.io.interrupt_cause
    csr.io.cause := Mux(io.ctl.exception, io.ctl.exception_cause, csr.io.interrupt_cause)
    csr.io.ungated_clock := clock
 
+   // WFI: no fetch while the CSR file holds the hart asleep
+   io.dat.csr_stall := csr.io.csr_stall
+   when (csr.io.csr_stall) {
+      io.imem.req.valid := false.B
+   }
+
    io.dat.csr_eret := csr.io.eret
 
    // Add your own uarch counters here!
@@ -275,6 +280,7 @@ class DatPath(implicit val p: Parameters, val conf: SodorCoreParams) extends Mod
 
    // datapath to controlpath outputs
    io.dat.inst   := exe_reg_inst
+   io.dat.exe_valid := exe_reg_valid
    io.dat.br_eq  := (exe_rs1_data === exe_rs2_data)
    io.dat.br_lt  := (exe_rs1_data.asSInt < exe_rs2_data.asSInt)
    io.dat.br_ltu := (exe_rs1_data.asUInt < exe_rs2_data.asUInt)
@@ -292,6 +298,33 @@ class DatPath(implicit val p: Parameters, val conf: SodorCoreParams) extends Mod
    io.dmem.req.bits.data := exe_rs2_data.asUInt
 
 
+   // Co-simulation: check every retired instruction against the reference model
+   if (conf.useCosim)
+   {
+      val cosim = SodorCosim(io.hartid)
+      cosim.io.commit_valid   := exe_reg_valid && !io.ctl.stall && !io.ctl.exception
+      cosim.io.commit_pc      := exe_reg_pc
+      cosim.io.commit_inst    := exe_reg_inst
+      cosim.io.commit_wen     := exe_wben
+      cosim.io.commit_rd      := exe_wbaddr
+      cosim.io.commit_wdata   := exe_wbdata
+      cosim.io.trap_valid     := !io.ctl.stall && io.ctl.exception
+      cosim.io.trap_interrupt := io.ctl.exception_cause(conf.xprlen-1)
+      cosim.io.trap_target    := exception_target
+   }
+
+   // Basic-block vector profiling from the retire valid/pc shown in the trace below
+   if (conf.useBBV)
+   {
+      SodorBBV(io.hartid, csr.io.retire, exe_reg_pc)
+   }
+
+   // Live telemetry; a redirect throws away the fetched instruction
+   if (conf.useTelemetry)
+   {
+      SodorTelemetry(io.hartid, csr.io.retire, exe_reg_pc, io.ctl.stall, io.ctl.if_kill)
+   }
+
    // Printout
    printf("Cyc= %d [%d] pc=[%x] W[r%d=%x][%d] Op1=[r%d][%x] Op2=[r%d][%x] inst=[%x] %c%c%c DASM(%x)\n",
       csr.io.time(31,0),
@@ -26,6 +26,8 @@ object ALU
   val ALU_SLT  = 12.U
   val ALU_SLTU = 14.U
   val ALU_COPY1= 8.U
+  val ALU_CZEQZ= 2.U // Zicond
+  val ALU_CZNEZ= 3.U
 
   def isSub(cmd: UInt) = cmd(3)
   def isSLTU(cmd: UInt) = cmd(1)
@@ -61,11 +63,16 @@ class ALU(implicit val conf: SodorCoreParams) extends Module
   val shout_r = (Cat(isSub(io.fn) & shin(msb), shin).asSInt >> shamt)(msb,0)
   val shout_l = Reverse(shout_r)
 
+  // CZERO.EQZ, CZERO.NEZ
+  val in2_zero = io.in2 === 0.U
+  val czero = Mux(io.fn === ALU_CZEQZ, in2_zero, !in2_zero)
+
   val bitwise_logic =
     Mux(io.fn === ALU_AND, io.in1 & io.in2,
     Mux(io.fn === ALU_OR,  io.in1 | io.in2,
     Mux(io.fn === ALU_XOR, io.in1 ^ io.in2,
-                           io.in1))) // ALU_COPY1
+    Mux((io.fn === ALU_CZEQZ || io.fn === ALU_CZNEZ) && czero, 0.U,
+                           io.in1)))) // ALU_COPY1, or a czero that keeps rs1
 
   val out_xpr_length =
     Mux(io.fn === ALU_ADD || io.fn === ALU_SUB,  sum,
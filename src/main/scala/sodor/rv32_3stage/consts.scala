@@ -30,6 +30,7 @@ trait SodorProcConstants
    //************************************
    // Debugging
    val PRINT_COMMIT_LOG = false
+   val PRINT_PIPEVIEW = false     // print an O3PipeView record per instruction
 }
 
 trait ScalarOpConstants
@@ -21,10 +21,14 @@ class CoreIo(implicit val p: Parameters, val conf: SodorCoreParams) extends Bund
   val interrupt = Input(new CoreInterrupts(false))
   val hartid = Input(UInt())
   val reset_vector = Input(UInt())
+  val wfi = Output(Bool()) // asleep in WFI
+  val dmem_pc = Output(UInt(conf.xprlen.W)) // pc of the data request (for the prefetcher)
+  val fence = Output(Bool()) // executing a FENCE or FENCE.I
 }
 
 class Core(implicit val p: Parameters, val conf: SodorCoreParams) extends AbstractCore
 {
+  require(conf.xprlen == 32, "The 3-stage core is RV32I only.")
   val io = IO(new CoreIo())
 
   val frontend = Module(new FrontEnd())
@@ -47,10 +51,18 @@ class Core(implicit val p: Parameters, val conf: SodorCoreParams) extends Abstra
   dpath.io.ddpath <> io.ddpath
   cpath.io.dcpath <> io.dcpath
 
+  SodorAccel.attach(dpath.io.accel)
   dpath.io.interrupt := io.interrupt
   dpath.io.hartid := io.hartid
 
+  io.wfi := dpath.io.dat.csr_stall
+  io.dmem_pc := dpath.io.dmem_pc
+  io.fence := frontend.io.cpu.resp.valid && AbstractCore.isFence(frontend.io.cpu.resp.bits.inst)
+
   val mem_ports = List(io.dmem, io.imem)
+  val wfi = io.wfi
+  override val dmem_pc = Some(io.dmem_pc)
+  val fence = io.fence
   val interrupt = io.interrupt
   val hartid = io.hartid
   val reset_vector = io.reset_vector
@@ -36,6 +36,8 @@ class CtrlSignals extends Bundle()
 
    val exception = Output(Bool())
    val exception_cause = Output(UInt(32.W))
+   val interrupt = Output(Bool())    // take the pending interrupt on the EX instruction
+   val accel_val = Output(Bool())    // custom instruction for the accelerator
 }
 
 class CpathIo(implicit val conf: SodorCoreParams) extends Bundle()
@@ -53,6 +55,16 @@ class CtlPath(implicit val conf: SodorCoreParams) extends Module
 {
    val io = IO(new CpathIo())
    io := DontCare
+   // Zicond: select rs1 or zero on rs2, in place of a data-dependent branch
+   val zicond_insts = if (!conf.useConditionalZero) Array[(BitPat, List[UInt])]() else Array(
+                  CZERO_EQZ -> List(Y, BR_N  , N, OP1_RS1, OP2_RS2 , ALU_CZEQZ,WB_ALU, REN_1, Y, MEN_0, M_X  , MT_X,  CSR.N, M_N),
+                  CZERO_NEZ -> List(Y, BR_N  , N, OP1_RS1, OP2_RS2 , ALU_CZNEZ,WB_ALU, REN_1, Y, MEN_0, M_X  , MT_X,  CSR.N, M_N)
+                  )
+   // Custom-0/1: sent to the accelerator from WB, its response is not bypassed
+   val accel_insts = if (conf.accel.isEmpty) Array[(BitPat, List[UInt])]() else SodorAccel.decode { (xd, xs1, xs2) =>
+                               List(Y, BR_N  , N, OP1_RS1, OP2_RS2 , ALU_X   , WB_ALU, if (xd) REN_1 else REN_0, N, MEN_0, M_X  , MT_X,  CSR.N, M_N)
+                  }
+
                              //
                              //   inst val?                                                                                mem flush/sync
                              //   |    br type                      alu fcn                 bypassable?                    |
@@ -120,7 +132,7 @@ class CtlPath(implicit val conf: SodorCoreParams) extends Module
                   FENCE_I -> List(Y, BR_N  , N, OP1_X  , OP2_X   , ALU_X   , WB_X  , REN_0, N, MEN_0, M_X  , MT_X,  CSR.N, M_SI),
                   FENCE   -> List(Y, BR_N  , N, OP1_X  , OP2_X   , ALU_X   , WB_X  , REN_0, N, MEN_0, M_X  , MT_X,  CSR.N, M_SD)
                   // we are already sequentially consistent, so no need to honor the fence instruction
-                  ))
+                  ) ++ zicond_insts ++ accel_insts)
 
    // Put these control signals in variables
    val (cs_inst_val: Bool) :: cs_br_type :: (cs_brjmp_sel: Bool) :: cs_op1_sel            :: cs_op2_sel  :: cs0 = csignals
@@ -133,7 +145,9 @@ class CtlPath(implicit val conf: SodorCoreParams) extends Module
 
    // Branch Logic
    val take_evec = Wire(Bool()) // jump to the csr.io.evec target
-                          // (for exceptions or sret, taken in the WB stage)
+                          // (for exceptions or sret, taken in the WB stage,
+                          // and for interrupts, injected in the EX stage)
+   val exe_interrupt = Wire(Bool())
 
    val ctrl_pc_sel = Mux(take_evec            ,  PC_EXC,
                      Mux(cs_br_type === BR_N  ,  PC_4,
@@ -170,10 +184,12 @@ class CtlPath(implicit val conf: SodorCoreParams) extends Module
    if(NUM_MEMORY_PORTS == 1)
       io.ctl.dmem_val   := cs_mem_en && ctrl_valid && !take_evec
    else
-      io.ctl.dmem_val   := cs_mem_en && ctrl_valid
+      io.ctl.dmem_val   := cs_mem_en && ctrl_valid && !exe_interrupt
    io.ctl.dmem_fcn   := cs_mem_fcn
    io.ctl.dmem_typ   := cs_msk_sel
 
+   io.ctl.accel_val  := cs_inst_val && SodorAccel.isCmd(io.imem.resp.bits.inst) && ctrl_valid
+
 
    //-------------------------------
    // Exception Handling
@@ -185,23 +201,47 @@ class CtlPath(implicit val conf: SodorCoreParams) extends Module
    val wb_reg_data_misaligned = RegInit(false.B)
    val wb_reg_inst_misaligned = RegInit(false.B)
    val wb_reg_mem_fcn = RegInit(M_X)
+   val wb_reg_csr_cmd = RegInit(false.B)
    wb_reg_illegal := exe_illegal
    wb_reg_data_misaligned := io.dat.data_misaligned
    wb_reg_inst_misaligned := io.dat.inst_misaligned
    wb_reg_mem_fcn := cs_mem_fcn
-   when (io.dat.wb_hazard_stall || io.ctl.exe_kill) {
+   wb_reg_csr_cmd := io.ctl.csr_cmd =/= CSR.N && io.ctl.csr_cmd =/= CSR.R
+   // (while an accelerator command holds WB, nothing from EX gets there)
+   when (io.dat.wb_hazard_stall || io.ctl.exe_kill || io.dat.wb_accel_stall) {
       wb_reg_illegal := false.B
       wb_reg_data_misaligned := false.B
       wb_reg_inst_misaligned := false.B
       wb_reg_mem_fcn := false.B
+      wb_reg_csr_cmd := false.B
+   }
+
+   // A pending interrupt is taken on the instruction in EX, which is killed and
+   // carries the interrupt into WB as a bubble, where the trap is taken with its
+   // pc as mepc. Fetch is redirected to the (vectored) trap target right away.
+   // Nothing in WB may still change the interrupt state (CSR write, exception,
+   // ecall, mret), and WB must not be waiting on memory or the accelerator, so
+   // that EX moves on.
+   val wb_reg_interrupt = RegInit(false.B)
+   val wb_reg_interrupt_cause = Reg(UInt(32.W))
+   exe_interrupt := io.dat.csr_interrupt && ctrl_valid && !wb_reg_interrupt && !wb_reg_csr_cmd &&
+                    !wb_reg_illegal && !wb_reg_inst_misaligned && !wb_reg_data_misaligned &&
+                    !io.dat.wb_mem && !io.dat.wb_accel_stall
+   wb_reg_interrupt := exe_interrupt
+   when (exe_interrupt)
+   {
+      wb_reg_interrupt_cause := io.dat.csr_interrupt_cause
    }
+   io.ctl.interrupt := exe_interrupt
 
-   take_evec        := io.ctl.exception || io.dat.csr_eret || io.dat.csr_interrupt
+   val wb_exception = (wb_reg_illegal || wb_reg_inst_misaligned || wb_reg_data_misaligned) && !io.dat.csr_eret
+   take_evec        := wb_exception || io.dat.csr_eret || exe_interrupt
 
-   io.ctl.exception := (wb_reg_illegal || wb_reg_inst_misaligned || wb_reg_data_misaligned) && !io.dat.csr_eret
-   io.ctl.exception_cause :=  Mux(wb_reg_illegal,           Causes.illegal_instruction.U,
+   io.ctl.exception := wb_exception || wb_reg_interrupt
+   io.ctl.exception_cause :=  Mux(wb_reg_interrupt,         wb_reg_interrupt_cause,
+                              Mux(wb_reg_illegal,           Causes.illegal_instruction.U,
                               Mux(wb_reg_inst_misaligned,   Causes.misaligned_fetch.U,
                               Mux(wb_reg_mem_fcn === M_XWR, Causes.misaligned_store.U,
                                                             Causes.misaligned_load.U
-                              )))
+                              ))))
 }
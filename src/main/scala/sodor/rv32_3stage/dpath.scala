@@ -34,6 +34,10 @@ class DatToCtlIo(implicit val conf: SodorCoreParams) extends Bundle()
    val wb_hazard_stall = Output(Bool())
    val csr_eret = Output(Bool())
    val csr_interrupt = Output(Bool())
+   val csr_interrupt_cause = Output(UInt(conf.xprlen.W))
+   val csr_stall = Output(Bool()) // asleep in WFI until an interrupt is pending
+   val wb_mem = Output(Bool())
+   val wb_accel_stall = Output(Bool()) // the custom instruction in WB waits on the accelerator
 }
 
 class DpathIo(implicit val p: Parameters, val conf: SodorCoreParams) extends Bundle()
@@ -41,6 +45,8 @@ class DpathIo(implicit val p: Parameters, val conf: SodorCoreParams) extends Bun
    val ddpath = Flipped(new DebugDPath())
    val imem = Flipped(new FrontEndCpuIO())
    val dmem = new MemPortIo(conf.xprlen)
+   val dmem_pc = Output(UInt(conf.xprlen.W))
+   val accel = new SodorAccelIo()
    val ctl  = Input(new CtrlSignals())
    val dat  = new DatToCtlIo()
    val interrupt = Input(new CoreInterrupts(false))
@@ -67,9 +73,13 @@ class DatPath(implicit val p: Parameters, val conf: SodorCoreParams) extends Mod
    val wb_reg_wbaddr    = Reg(UInt(log2Ceil(32).W))
    val wb_reg_target_pc = Reg(UInt(conf.xprlen.W))
    val wb_reg_mem       = RegInit(false.B)
+   val wb_reg_rs1_data  = Reg(UInt(conf.xprlen.W)) // accelerator command operands
+   val wb_reg_rs2_data  = Reg(UInt(conf.xprlen.W))
 
    val wb_hazard_stall  = Wire(Bool()) // hazard detected, stall in IF/EXE required
    val wb_dmiss_stall   = Wire(Bool()) // Data operation miss stall
+   val wb_wfi_stall     = Wire(Bool()) // WFI in WB or the hart asleep, hold EXE as on a hazard
+   val wb_accel_stall   = Wire(Bool()) // accelerator command in WB not done, hold EXE as on a miss
 
    //**********************************
    // Instruction Fetch Stage
@@ -122,11 +132,13 @@ class DatPath(implicit val p: Parameters, val conf: SodorCoreParams) extends Mod
       }
       wb_hazard_stall := ((wb_reg_wbaddr === exe_rs1_addr) && (exe_rs1_addr =/= 0.U) && wb_reg_ctrl.rf_wen && !wb_reg_ctrl.bypassable) ||
                          ((wb_reg_wbaddr === exe_rs2_addr) && (exe_rs2_addr =/= 0.U) && wb_reg_ctrl.rf_wen && !wb_reg_ctrl.bypassable) ||
+                         wb_wfi_stall ||
                          (io.ctl.dmem_val && !RegNext(wb_hazard_stall)) || (io.ctl.dmem_val && (count =/= 2.U))
    }
    else{
       wb_hazard_stall := ((wb_reg_wbaddr === exe_rs1_addr) && (exe_rs1_addr =/= 0.U) && wb_reg_ctrl.rf_wen && !wb_reg_ctrl.bypassable) ||
-                         ((wb_reg_wbaddr === exe_rs2_addr) && (exe_rs2_addr =/= 0.U) && wb_reg_ctrl.rf_wen && !wb_reg_ctrl.bypassable)
+                         ((wb_reg_wbaddr === exe_rs2_addr) && (exe_rs2_addr =/= 0.U) && wb_reg_ctrl.rf_wen && !wb_reg_ctrl.bypassable) ||
+                         wb_wfi_stall
    }
 
 
@@ -214,17 +226,18 @@ class DatPath(implicit val p: Parameters, val conf: SodorCoreParams) extends Mod
    io.dat.data_misaligned := (misaligned_mask & mem_address_low).orR && io.ctl.dmem_val
 
    // datapath to data memory outputs
-   io.dmem.req.valid     := io.ctl.dmem_val && !io.dat.data_misaligned && !wb_hazard_stall // Do not fire during hazard
+   io.dmem.req.valid     := io.ctl.dmem_val && !io.dat.data_misaligned && !wb_hazard_stall && !wb_accel_stall // Do not fire during hazard
    if(conf.ports == 1)
       io.dmem.req.bits.fcn  := io.ctl.dmem_fcn & exe_valid & !((wb_reg_wbaddr === exe_rs1_addr) && (exe_rs1_addr =/= 0.U) && wb_reg_ctrl.rf_wen && !wb_reg_ctrl.bypassable)
    else
       io.dmem.req.bits.fcn  := io.ctl.dmem_fcn & !wb_hazard_stall & exe_valid
    io.dmem.req.bits.typ  := io.ctl.dmem_typ
    io.dmem.req.bits.addr := exe_alu_out
+   io.dmem_pc            := exe_pc
    io.dmem.req.bits.data := exe_rs2_data
 
    // Data memory miss detection
-   wb_dmiss_stall := (!io.dmem.req.ready && io.dmem.req.valid) || (wb_reg_mem && !io.dmem.resp.valid)
+   wb_dmiss_stall := (!io.dmem.req.ready && io.dmem.req.valid) || (wb_reg_mem && !io.dmem.resp.valid) || wb_accel_stall
 
    // execute to wb registers
    when (!wb_dmiss_stall)
@@ -237,7 +250,13 @@ class DatPath(implicit val p: Parameters, val conf: SodorCoreParams) extends Mod
          wb_reg_ctrl.csr_cmd   := CSR.N
          wb_reg_ctrl.dmem_val  := false.B
          wb_reg_ctrl.exception := false.B
+         wb_reg_ctrl.accel_val := false.B
          wb_reg_mem            := false.B
+         when (io.ctl.interrupt)
+         {
+            // the interrupt is taken in WB with the killed instruction's pc
+            wb_reg_pc := exe_pc
+         }
       }
       .otherwise {
          wb_reg_inst := exe_inst
@@ -249,6 +268,8 @@ class DatPath(implicit val p: Parameters, val conf: SodorCoreParams) extends Mod
          wb_reg_csr_addr := exe_inst(CSR_ADDR_MSB,CSR_ADDR_LSB)
          wb_reg_target_pc := exe_target_pc
          wb_reg_mem := io.dmem.req.valid
+         wb_reg_rs1_data := exe_rs1_data
+         wb_reg_rs2_data := exe_rs2_data
       }
    }
 
@@ -279,31 +300,106 @@ class DatPath(implicit val p: Parameters, val conf: SodorCoreParams) extends Mod
                   (io.ctl.exception_cause === Causes.misaligned_load.U)  -> tval_data_ma,
                   ))
 
-   // Interrupt handle flag
-   val reg_interrupt_flag = RegNext(csr.io.interrupt, false.B)
-   val interrupt_edge = csr.io.interrupt && !reg_interrupt_flag
-
+   // Pending interrupts are injected in EX by the control path. While no trap is
+   // taken, the CSR file is given the pending interrupt's cause so that evec is
+   // already the (vectored) handler address when the interrupt is injected.
    csr.io.interrupts := io.interrupt
    csr.io.hartid := io.hartid
-   io.dat.csr_interrupt := interrupt_edge
+   io.dat.csr_interrupt := csr.io.interrupt
+   io.dat.csr_interrupt_cause := csr.io.interrupt_cause
+   io.dat.wb_mem := wb_reg_mem
    csr.io.cause := Mux(io.ctl.exception, io.ctl.exception_cause, csr.io.interrupt_cause)
    csr.io.ungated_clock := clock
 
+   // WFI puts the hart to sleep in the CSR file when it reaches WB. The
+   // instruction behind it waits in EXE from then on, so nothing after the WFI
+   // executes until an interrupt is pending (and the frontend stops once its
+   // buffer is full).
+   wb_wfi_stall := (wb_reg_valid && wb_reg_inst === Instructions.WFI) || csr.io.csr_stall
+   io.dat.csr_stall := csr.io.csr_stall
+
    // Add your own uarch counters here!
    csr.io.counters.foreach(_.inc := false.B)
 
+   // Accelerator
+   // The custom instruction sends its command from WB, where nothing older can
+   // kill it any more, and holds EXE like a data memory miss until the command
+   // is taken and, if it writes rd, the response is back. FENCE waits in WB for
+   // the accelerator to finish its work. WB can also be held by a data access
+   // in EXE, so the response is kept until the instruction leaves.
+   val wb_accel_sent = RegInit(false.B)
+   val wb_accel_got  = RegInit(false.B)
+   val wb_accel_data = Reg(UInt(conf.xprlen.W))
+   val wb_accel_inst = wb_reg_inst.asTypeOf(new SodorAccelInst)
+   io.accel.cmd.valid     := wb_reg_ctrl.accel_val && !wb_accel_sent
+   io.accel.cmd.bits.inst := wb_accel_inst
+   io.accel.cmd.bits.rs1  := wb_reg_rs1_data
+   io.accel.cmd.bits.rs2  := wb_reg_rs2_data
+   io.accel.resp.ready    := wb_reg_ctrl.accel_val && wb_accel_inst.xd && !wb_accel_got
+
+   val wb_accel_done = Mux(wb_accel_inst.xd, wb_accel_got || io.accel.resp.valid, wb_accel_sent || io.accel.cmd.ready)
+   wb_accel_stall := (wb_reg_ctrl.accel_val && !wb_accel_done) ||
+                     (wb_reg_valid && Instructions.FENCE === wb_reg_inst && io.accel.busy)
+   io.dat.wb_accel_stall := wb_accel_stall
+   when (!wb_dmiss_stall)
+   {
+      wb_accel_sent := false.B
+      wb_accel_got := false.B
+   }
+   .otherwise
+   {
+      when (io.accel.cmd.fire) { wb_accel_sent := true.B }
+      when (io.accel.resp.fire)
+      {
+         wb_accel_got := true.B
+         wb_accel_data := io.accel.resp.bits.data
+      }
+   }
+
    // WB Mux
    // Note: I'm relying on the fact that the EXE stage is holding the
    // instruction behind our jal, which assumes we always predict PC+4, and we
    // don't clear the "mispredicted" PC when we jump.
    require (PREDICT_PCP4==true)
    wb_wbdata := MuxCase(wb_reg_alu, Array(
+                  (wb_reg_ctrl.accel_val)         -> Mux(wb_accel_got, wb_accel_data, io.accel.resp.bits.data),
                   (wb_reg_ctrl.wb_sel === WB_ALU) -> wb_reg_alu,
                   (wb_reg_ctrl.wb_sel === WB_MEM) -> io.dmem.resp.bits.data,
                   (wb_reg_ctrl.wb_sel === WB_PC4) -> exe_pc,
                   (wb_reg_ctrl.wb_sel === WB_CSR) -> wb_csr_out
                   ))
 
+   //**********************************
+   // Co-simulation: check every retired instruction against the reference model
+   if (conf.useCosim)
+   {
+      val cosim = SodorCosim(io.hartid)
+      cosim.io.commit_valid   := wb_reg_valid && !wb_dmiss_stall && !io.ctl.exception
+      cosim.io.commit_pc      := wb_reg_pc
+      cosim.io.commit_inst    := wb_reg_inst
+      cosim.io.commit_wen     := wb_reg_ctrl.rf_wen
+      cosim.io.commit_rd      := wb_reg_wbaddr
+      cosim.io.commit_wdata   := wb_wbdata
+      cosim.io.trap_valid     := io.ctl.exception
+      cosim.io.trap_interrupt := io.ctl.exception_cause(conf.xprlen-1)
+      cosim.io.trap_target    := exception_target
+   }
+
+   //**********************************
+   // Basic-block vector profiling from the retire valid/pc shown in the trace below.
+   // csr.io.retire stays high while WB waits on a data miss, so count it once.
+   if (conf.useBBV)
+   {
+      SodorBBV(io.hartid, csr.io.retire && !wb_dmiss_stall, wb_reg_pc)
+   }
+
+   // Live telemetry; stalls are WB hazards and data misses, kills squash EXE
+   if (conf.useTelemetry)
+   {
+      SodorTelemetry(io.hartid, csr.io.retire && !wb_dmiss_stall, wb_reg_pc,
+         wb_hazard_stall || wb_dmiss_stall, io.ctl.exe_kill)
+   }
+
    //**********************************
    // Printout
 
@@ -352,4 +448,74 @@ class DatPath(implicit val p: Parameters, val conf: SodorCoreParams) extends Mod
       }
    }
 
+
+   //**********************************
+   // Pipeline view trace
+   // Follow each instruction from EXE to WB, stamping the cycle it entered every
+   // stage (see common/pipeview.scala). The fetch cycle comes from the front-end;
+   // instructions it drops on a redirect never reach EXE and are not traced.
+   // Decode happens in EXE here, so both get the same stamp.
+   if (PRINT_PIPEVIEW)
+   {
+      val pv_cycle    = PipeView.cycle()
+      val pv_seq      = RegInit(0.U(32.W))
+      val pv_exe      = Reg(new PipeViewStamps)
+      val pv_wb       = Reg(new PipeViewStamps)
+      val pv_wb_pc    = Reg(UInt(conf.xprlen.W))
+      val pv_wb_inst  = Reg(UInt(conf.xprlen.W))
+
+      // the front-end loads a new instruction into EXE whenever we accept one
+      val pv_exe_new = RegNext(io.imem.resp.ready || io.ctl.exe_kill, true.B)
+      val pv_exe_fresh = PipeView.stamps(pv_seq, io.imem.debug.exe_fetch)
+      pv_exe_fresh.decode := pv_cycle
+      pv_exe_fresh.execute := pv_cycle
+      val pv_exe_cur = Mux(pv_exe_new, pv_exe_fresh, pv_exe)
+
+      // EXE -> WB
+      when (exe_valid)
+      {
+         when (pv_exe_new)
+         {
+            pv_seq := pv_seq + 1.U
+         }
+         pv_exe := pv_exe_cur
+
+         when (io.ctl.exe_kill)
+         {
+            PipeView.squash(pv_exe_cur, exe_pc, exe_inst, Mux(io.ctl.interrupt, Str('I'), Str('K')))
+         }
+         .elsewhen (wb_dmiss_stall)
+         {
+            pv_exe.mem_wait := pv_exe_cur.mem_wait + 1.U
+         }
+         .elsewhen (wb_hazard_stall)
+         {
+            pv_exe.hazard := pv_exe_cur.hazard + 1.U
+         }
+         .otherwise
+         {
+            pv_wb := pv_exe_cur
+            pv_wb.memory := pv_cycle + 1.U
+            pv_wb_pc := exe_pc
+            pv_wb_inst := exe_inst
+         }
+      }
+
+      // WB
+      when (wb_reg_valid)
+      {
+         when (wb_dmiss_stall)
+         {
+            pv_wb.mem_wait := pv_wb.mem_wait + 1.U
+         }
+         .elsewhen (io.ctl.exception)
+         {
+            PipeView.squash(pv_wb, pv_wb_pc, pv_wb_inst, Str('X'))
+         }
+         .otherwise
+         {
+            PipeView.retire(pv_wb, pv_wb_pc, pv_wb_inst, pv_cycle)
+         }
+      }
+   }
 }
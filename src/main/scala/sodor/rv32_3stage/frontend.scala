@@ -62,6 +62,7 @@ class FrontEndDebug(xprlen: Int) extends Bundle
 {
    val if_pc   = Output(UInt(xprlen.W))
    val if_inst = Output(UInt(xprlen.W))
+   val exe_fetch = Output(UInt(32.W))  // cycle the exe instruction was fetched (PRINT_PIPEVIEW)
 }
 
 class FrontEndCpuIO(implicit val conf: SodorCoreParams) extends Bundle
@@ -172,4 +173,23 @@ class FrontEnd(implicit val conf: SodorCoreParams) extends Module
    // only used for debugging
    io.cpu.debug.if_pc := if_reg_pc
    io.cpu.debug.if_inst := io.imem.resp.bits.data
+   io.cpu.debug.exe_fetch := 0.U
+
+   if (PRINT_PIPEVIEW)
+   {
+      // the cycle each instruction arrived, kept alongside the instruction buffer
+      val pv_cycle = PipeView.cycle()
+      val pv_fetch_in = Wire(new DecoupledIO(UInt(32.W)))
+      pv_fetch_in.bits := pv_cycle
+      pv_fetch_in.valid := if_buffer_in.valid
+      val pv_fetch_out = Queue(pv_fetch_in, entries = 1, pipe = false, flow = true)
+      pv_fetch_out.ready := if_buffer_out.ready
+
+      val exe_reg_fetch = Reg(UInt(32.W))
+      when (io.cpu.resp.ready)
+      {
+         exe_reg_fetch := pv_fetch_out.bits
+      }
+      io.cpu.debug.exe_fetch := exe_reg_fetch
+   }
 }
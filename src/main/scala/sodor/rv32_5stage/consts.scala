@@ -22,6 +22,25 @@ trait SodorProcConstants
                                   // on load-use). Otherwise rely
                                   // entirely on interlocking to handle
                                   // pipeline hazards.
+
+   val USE_LOOP_BUFFER = false    // serve short backward-branch loops from
+                                  // a small buffer in IF instead of imem.
+   val LOOP_BUFFER_ENTRIES = 8    // max loop body size (instructions).
+
+   //************************************
+   // Uarch events (mhpmcounter3 + n, see dpath.scala)
+   val HPM_ROI_CYCLES       = 0   // cycles while measuring (with triggers)
+   val HPM_ROI_INSTRET      = 1   // retired instructions while measuring (with triggers)
+   val HPM_LOOP_BUFFER_HITS = 2   // instructions supplied by the loop buffer
+
+   // mhpmcounters needed to reach every enabled event
+   def HPM_COUNTERS(triggers: Boolean): Int =
+      ((if (triggers) Seq(HPM_ROI_CYCLES, HPM_ROI_INSTRET) else Nil) ++
+       (if (USE_LOOP_BUFFER) Seq(HPM_LOOP_BUFFER_HITS) else Nil)).map(_ + 1).foldLeft(0)(_ max _)
+
+   //************************************
+   // Debugging
+   val PRINT_PIPEVIEW = false     // print an O3PipeView record per instruction
 }
 
 trait ScalarOpConstants
@@ -73,19 +92,26 @@ trait ScalarOpConstants
    val REN_1   = true.B
 
    // ALU Operation Signal
-   val ALU_ADD    = 0.asUInt(4.W)
-   val ALU_SUB    = 1.asUInt(4.W)
-   val ALU_SLL    = 2.asUInt(4.W)
-   val ALU_SRL    = 3.asUInt(4.W)
-   val ALU_SRA    = 4.asUInt(4.W)
-   val ALU_AND    = 5.asUInt(4.W)
-   val ALU_OR     = 6.asUInt(4.W)
-   val ALU_XOR    = 7.asUInt(4.W)
-   val ALU_SLT    = 8.asUInt(4.W)
-   val ALU_SLTU   = 9.asUInt(4.W)
-   val ALU_COPY_1 = 10.asUInt(4.W)
-   val ALU_COPY_2 = 11.asUInt(4.W)
-   val ALU_X      = 0.asUInt(4.W)
+   val ALU_ADD    = 0.asUInt(5.W)
+   val ALU_SUB    = 1.asUInt(5.W)
+   val ALU_SLL    = 2.asUInt(5.W)
+   val ALU_SRL    = 3.asUInt(5.W)
+   val ALU_SRA    = 4.asUInt(5.W)
+   val ALU_AND    = 5.asUInt(5.W)
+   val ALU_OR     = 6.asUInt(5.W)
+   val ALU_XOR    = 7.asUInt(5.W)
+   val ALU_SLT    = 8.asUInt(5.W)
+   val ALU_SLTU   = 9.asUInt(5.W)
+   val ALU_COPY_1 = 10.asUInt(5.W)
+   val ALU_COPY_2 = 11.asUInt(5.W)
+   val ALU_ADDW   = 12.asUInt(5.W) // RV64: 32-bit operation, sign-extended result
+   val ALU_SUBW   = 13.asUInt(5.W)
+   val ALU_SLLW   = 14.asUInt(5.W)
+   val ALU_SRLW   = 15.asUInt(5.W)
+   val ALU_SRAW   = 16.asUInt(5.W)
+   val ALU_CZEQZ  = 17.asUInt(5.W) // Zicond: op1, or zero if op2 is zero
+   val ALU_CZNEZ  = 18.asUInt(5.W) // Zicond: op1, or zero if op2 is not zero
+   val ALU_X      = 0.asUInt(5.W)
 
    // Writeback Select Signal
    val WB_ALU  = 0.asUInt(2.W)
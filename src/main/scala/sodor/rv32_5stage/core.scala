@@ -18,7 +18,11 @@ class CoreIo(implicit val p: Parameters, val conf: SodorCoreParams) extends Bund
    val dmem = new MemPortIo(conf.xprlen)
    val interrupt = Input(new CoreInterrupts(false))
    val hartid = Input(UInt())
-   val reset_vector = Input(UInt())}
+   val reset_vector = Input(UInt())
+   val wfi = Output(Bool()) // asleep in WFI
+   val dmem_pc = Output(UInt(conf.xprlen.W)) // pc of the data request (for the prefetcher)
+   val fence = Output(Bool()) // executing a FENCE or FENCE.I
+}
 
 class Core()(implicit val p: Parameters, val conf: SodorCoreParams) extends AbstractCore
 {
@@ -38,11 +42,20 @@ class Core()(implicit val p: Parameters, val conf: SodorCoreParams) extends Abst
    d.io.ddpath <> io.ddpath
    c.io.dcpath <> io.dcpath
 
+   SodorAccel.attach(d.io.accel)
+
    d.io.interrupt := io.interrupt
    d.io.hartid := io.hartid
    d.io.reset_vector := io.reset_vector
 
+   io.wfi := d.io.dat.csr_stall
+   io.dmem_pc := d.io.dmem_pc
+   io.fence := d.io.fence
+
    val mem_ports = List(io.dmem, io.imem)
+   val wfi = io.wfi
+   override val dmem_pc = Some(io.dmem_pc)
+   val fence = io.fence
    val interrupt = io.interrupt
    val hartid = io.hartid
    val reset_vector = io.reset_vector
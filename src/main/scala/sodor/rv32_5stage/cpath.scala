@@ -19,7 +19,7 @@ import sodor.stage5.Constants._
 import sodor.common._
 import sodor.common.Instructions._
 
-class CtlToDatIo extends Bundle()
+class CtlToDatIo(implicit val conf: SodorCoreParams) extends Bundle()
 {
    val dec_stall  = Output(Bool())    // stall IF/DEC stages (due to hazards)
    val full_stall = Output(Bool())    // stall entire pipeline (due to D$ misses)
@@ -29,7 +29,7 @@ class CtlToDatIo extends Bundle()
    val dec_kill   = Output(Bool())
    val op1_sel    = Output(UInt(2.W))
    val op2_sel    = Output(UInt(3.W))
-   val alu_fun    = Output(UInt(4.W))
+   val alu_fun    = Output(UInt(ALU_X.getWidth.W))
    val wb_sel     = Output(UInt(2.W))
    val rf_wen     = Output(Bool())
    val mem_val    = Output(Bool())
@@ -37,12 +37,14 @@ class CtlToDatIo extends Bundle()
    val mem_typ    = Output(UInt(3.W))
    val csr_cmd    = Output(UInt(CSR.SZ.W))
    val fencei     = Output(Bool())    // pipeline is executing a fencei
+   val accel_val  = Output(Bool())    // custom-0/1 instruction for the accelerator
 
    val pipeline_kill = Output(Bool()) // an exception occurred (detected in mem stage).
                                     // Kill the entire pipeline disregard stalls
                                     // and kill if,dec,exe stages.
    val mem_exception = Output(Bool()) // tell the CSR that the core detected an exception
-   val mem_exception_cause = Output(UInt(32.W))
+   val mem_interrupt = Output(Bool()) // the interrupt injected at decode reached mem, take the trap
+   val mem_exception_cause = Output(UInt(conf.xprlen.W))
 }
 
 class CpathIo(implicit val conf: SodorCoreParams) extends Bundle()
@@ -60,6 +62,39 @@ class CtlPath(implicit val conf: SodorCoreParams) extends Module
   val io = IO(new CpathIo())
   io := DontCare
 
+   // Immediate shifts take a 6-bit shamt on RV64
+   val (slli, srai, srli) = if (conf.xprlen == 64) (SLLI, SRAI, SRLI) else (SLLI_RV32, SRAI_RV32, SRLI_RV32)
+
+   // RV64I: doubleword loads and stores, and the *W instructions, which
+   // operate on the low 32 bits and sign-extend the result
+   val rv64_insts = if (conf.xprlen != 64) Array[(BitPat, List[UInt])]() else Array(
+                  LD     -> List(Y, BR_N  , OP1_RS1, OP2_ITYPE , OEN_1, OEN_0, ALU_ADD , WB_MEM, REN_1, MEN_1, M_XRD, MT_D, CSR.N, N),
+                  LWU    -> List(Y, BR_N  , OP1_RS1, OP2_ITYPE , OEN_1, OEN_0, ALU_ADD , WB_MEM, REN_1, MEN_1, M_XRD, MT_WU,CSR.N, N),
+                  SD     -> List(Y, BR_N  , OP1_RS1, OP2_STYPE , OEN_1, OEN_1, ALU_ADD , WB_X  , REN_0, MEN_1, M_XWR, MT_D, CSR.N, N),
+
+                  ADDIW  -> List(Y, BR_N  , OP1_RS1, OP2_ITYPE , OEN_1, OEN_0, ALU_ADDW, WB_ALU, REN_1, MEN_0, M_X  , MT_X, CSR.N, N),
+                  SLLIW  -> List(Y, BR_N  , OP1_RS1, OP2_ITYPE , OEN_1, OEN_0, ALU_SLLW, WB_ALU, REN_1, MEN_0, M_X  , MT_X, CSR.N, N),
+                  SRAIW  -> List(Y, BR_N  , OP1_RS1, OP2_ITYPE , OEN_1, OEN_0, ALU_SRAW, WB_ALU, REN_1, MEN_0, M_X  , MT_X, CSR.N, N),
+                  SRLIW  -> List(Y, BR_N  , OP1_RS1, OP2_ITYPE , OEN_1, OEN_0, ALU_SRLW, WB_ALU, REN_1, MEN_0, M_X  , MT_X, CSR.N, N),
+
+                  ADDW   -> List(Y, BR_N  , OP1_RS1, OP2_RS2   , OEN_1, OEN_1, ALU_ADDW, WB_ALU, REN_1, MEN_0, M_X  , MT_X, CSR.N, N),
+                  SUBW   -> List(Y, BR_N  , OP1_RS1, OP2_RS2   , OEN_1, OEN_1, ALU_SUBW, WB_ALU, REN_1, MEN_0, M_X  , MT_X, CSR.N, N),
+                  SLLW   -> List(Y, BR_N  , OP1_RS1, OP2_RS2   , OEN_1, OEN_1, ALU_SLLW, WB_ALU, REN_1, MEN_0, M_X  , MT_X, CSR.N, N),
+                  SRAW   -> List(Y, BR_N  , OP1_RS1, OP2_RS2   , OEN_1, OEN_1, ALU_SRAW, WB_ALU, REN_1, MEN_0, M_X  , MT_X, CSR.N, N),
+                  SRLW   -> List(Y, BR_N  , OP1_RS1, OP2_RS2   , OEN_1, OEN_1, ALU_SRLW, WB_ALU, REN_1, MEN_0, M_X  , MT_X, CSR.N, N)
+                  )
+
+   // Zicond: select rs1 or zero on rs2, in place of a data-dependent branch
+   val zicond_insts = if (!conf.useConditionalZero) Array[(BitPat, List[UInt])]() else Array(
+                  CZERO_EQZ -> List(Y, BR_N  , OP1_RS1, OP2_RS2   , OEN_1, OEN_1, ALU_CZEQZ, WB_ALU, REN_1, MEN_0, M_X  , MT_X, CSR.N, N),
+                  CZERO_NEZ -> List(Y, BR_N  , OP1_RS1, OP2_RS2   , OEN_1, OEN_1, ALU_CZNEZ, WB_ALU, REN_1, MEN_0, M_X  , MT_X, CSR.N, N)
+                  )
+
+   // Custom-0/1 instructions, executed by the accelerator (see accelerator.scala)
+   val accel_insts = if (conf.accel.isEmpty) Array[(BitPat, List[UInt])]() else SodorAccel.decode { (xd, xs1, xs2) =>
+                  List(Y, BR_N  , OP1_RS1, OP2_RS2   , if (xs1) OEN_1 else OEN_0, if (xs2) OEN_1 else OEN_0, ALU_X, WB_ALU,
+                       if (xd) REN_1 else REN_0, MEN_0, M_X  , MT_X, CSR.N, N) }
+
    val csignals =
       ListLookup(io.dat.dec_inst,
                              List(N, BR_N  , OP1_X , OP2_X    , OEN_0, OEN_0, ALU_X   , WB_X  ,  REN_0, MEN_0, M_X  , MT_X, CSR.N, N),
@@ -83,9 +118,9 @@ class CtlPath(implicit val conf: SodorCoreParams) extends Module
                   XORI   -> List(Y, BR_N  , OP1_RS1, OP2_ITYPE , OEN_1, OEN_0, ALU_XOR , WB_ALU, REN_1, MEN_0, M_X  , MT_X, CSR.N, N),
                   SLTI   -> List(Y, BR_N  , OP1_RS1, OP2_ITYPE , OEN_1, OEN_0, ALU_SLT , WB_ALU, REN_1, MEN_0, M_X  , MT_X, CSR.N, N),
                   SLTIU  -> List(Y, BR_N  , OP1_RS1, OP2_ITYPE , OEN_1, OEN_0, ALU_SLTU, WB_ALU, REN_1, MEN_0, M_X  , MT_X, CSR.N, N),
-                  SLLI_RV32->List(Y, BR_N  , OP1_RS1, OP2_ITYPE , OEN_1, OEN_0, ALU_SLL , WB_ALU, REN_1, MEN_0, M_X  , MT_X, CSR.N, N),
-                  SRAI_RV32->List(Y, BR_N  , OP1_RS1, OP2_ITYPE , OEN_1, OEN_0, ALU_SRA , WB_ALU, REN_1, MEN_0, M_X  , MT_X, CSR.N, N),
-                  SRLI_RV32->List(Y, BR_N  , OP1_RS1, OP2_ITYPE , OEN_1, OEN_0, ALU_SRL , WB_ALU, REN_1, MEN_0, M_X  , MT_X, CSR.N, N),
+                  slli   -> List(Y, BR_N  , OP1_RS1, OP2_ITYPE , OEN_1, OEN_0, ALU_SLL , WB_ALU, REN_1, MEN_0, M_X  , MT_X, CSR.N, N),
+                  srai   -> List(Y, BR_N  , OP1_RS1, OP2_ITYPE , OEN_1, OEN_0, ALU_SRA , WB_ALU, REN_1, MEN_0, M_X  , MT_X, CSR.N, N),
+                  srli   -> List(Y, BR_N  , OP1_RS1, OP2_ITYPE , OEN_1, OEN_0, ALU_SRL , WB_ALU, REN_1, MEN_0, M_X  , MT_X, CSR.N, N),
 
                   SLL    -> List(Y, BR_N  , OP1_RS1, OP2_RS2   , OEN_1, OEN_1, ALU_SLL , WB_ALU, REN_1, MEN_0, M_X  , MT_X, CSR.N, N),
                   ADD    -> List(Y, BR_N  , OP1_RS1, OP2_RS2   , OEN_1, OEN_1, ALU_ADD , WB_ALU, REN_1, MEN_0, M_X  , MT_X, CSR.N, N),
@@ -118,21 +153,22 @@ class CtlPath(implicit val conf: SodorCoreParams) extends Module
                   MRET   -> List(Y, BR_N  , OP1_X  , OP2_X     , OEN_0, OEN_0, ALU_X   , WB_X  , REN_0, MEN_0, M_X  , MT_X, CSR.I, N),
                   DRET   -> List(Y, BR_N  , OP1_X  , OP2_X     , OEN_0, OEN_0, ALU_X   , WB_X  , REN_0, MEN_0, M_X  , MT_X, CSR.I, N),
                   EBREAK -> List(Y, BR_N  , OP1_X  , OP2_X     , OEN_0, OEN_0, ALU_X   , WB_X  , REN_0, MEN_0, M_X  , MT_X, CSR.I, N),
-                  WFI    -> List(Y, BR_N  , OP1_X  , OP2_X     , OEN_0, OEN_0, ALU_X   , WB_X  , REN_0, MEN_0, M_X  , MT_X, CSR.N, N), // implemented as a NOP
+                  WFI    -> List(Y, BR_N  , OP1_X  , OP2_X     , OEN_0, OEN_0, ALU_X   , WB_X  , REN_0, MEN_0, M_X  , MT_X, CSR.I, N),
 
                   FENCE_I-> List(Y, BR_N  , OP1_X  , OP2_X     , OEN_0, OEN_0, ALU_X   , WB_X  , REN_0, MEN_0, M_X  , MT_X, CSR.N, Y),
                   // kill pipeline and refetch instructions since the pipeline will be holding stall instructions.
                   FENCE  -> List(Y, BR_N  , OP1_X  , OP2_X     , OEN_0, OEN_0, ALU_X   , WB_X  , REN_0, MEN_0, M_X  , MT_X, CSR.N, N)
                   // we are already sequentially consistent, so no need to honor the fence instruction
-                  ))
+                  ) ++ rv64_insts ++ zicond_insts ++ accel_insts)
 
    // Put these control signals in variables
    val (cs_val_inst: Bool) :: cs_br_type :: cs_op1_sel :: cs_op2_sel :: (cs_rs1_oen: Bool) :: (cs_rs2_oen: Bool) :: cs0 = csignals
    val cs_alu_fun :: cs_wb_sel :: (cs_rf_wen: Bool) :: (cs_mem_en: Bool) :: cs_mem_fcn :: cs_msk_sel :: cs_csr_cmd :: (cs_fencei: Bool) :: Nil = cs0
+   val cs_accel = cs_val_inst && SodorAccel.isCmd(io.dat.dec_inst)
 
 
    // Branch Logic
-   val ctrl_exe_pc_sel = Mux(io.ctl.pipeline_kill         , PC_EXC,
+   val exe_pc_sel      = Mux(io.ctl.pipeline_kill         , PC_EXC,
                          Mux(io.dat.exe_br_type === BR_N  , PC_4,
                          Mux(io.dat.exe_br_type === BR_NE , Mux(!io.dat.exe_br_eq,  PC_BRJMP, PC_4),
                          Mux(io.dat.exe_br_type === BR_EQ , Mux( io.dat.exe_br_eq,  PC_BRJMP, PC_4),
@@ -145,23 +181,58 @@ class CtlPath(implicit val conf: SodorCoreParams) extends Module
                                                             PC_4
                      ))))))))))
 
-   val ifkill  = (ctrl_exe_pc_sel =/= PC_4) || cs_fencei || RegNext(cs_fencei)
+   // Interrupt Injection --------------------
+   // A pending interrupt is taken on the instruction in decode, which becomes a
+   // bubble carrying the interrupt down to mem, where the trap is taken with the
+   // decode pc as mepc. Fetch is redirected to the (vectored) trap target right
+   // away instead of when the trap is taken, so the first handler instruction
+   // follows the injection by one fetch. Nothing older than the injected
+   // instruction may still change the interrupt state: a CSR write in exe or
+   // mem, or a trap or eret in mem, holds the injection off, and so does a
+   // hazard stall, which would turn the injected bubble into a plain one while
+   // fetch has already gone to the trap target.
+   val exe_reg_interrupt = RegInit(false.B)
+   val mem_reg_interrupt = RegInit(false.B)
+   val mem_reg_is_csr    = RegInit(false.B)
+   val exe_reg_is_csr    = RegInit(false.B)
+   val interrupt_cause   = Reg(UInt(conf.xprlen.W))
+
+   // WFI --------------------
+   // The CSR file puts the hart to sleep when the WFI reaches mem. Decode holds
+   // the next instruction from the moment the WFI leaves it until the hart is
+   // woken up by a pending interrupt; the full fetch buffer then stops fetch.
+   val exe_reg_is_wfi    = RegInit(false.B)
+   val mem_reg_is_wfi    = RegInit(false.B)
+   val wfi_stall = exe_reg_is_wfi || mem_reg_is_wfi || io.dat.csr_stall
+
+   val stall   = Wire(Bool())
+
+   val dec_interrupt = io.dat.csr_interrupt && io.dat.dec_valid && exe_pc_sel === PC_4 &&
+                       !exe_reg_interrupt && !mem_reg_interrupt &&
+                       !exe_reg_is_csr && !mem_reg_is_csr && !wfi_stall && !io.ctl.full_stall && !stall
+
+   val ctrl_exe_pc_sel = Mux(dec_interrupt, PC_EXC, exe_pc_sel)
+   val dec_fencei = cs_fencei && !dec_interrupt
+
+   val fencei_stages = dec_fencei || RegNext(dec_fencei) || RegNext(RegNext(dec_fencei))
+
+   val ifkill  = (ctrl_exe_pc_sel =/= PC_4) || fencei_stages
    val deckill = (ctrl_exe_pc_sel =/= PC_4)
 
    // Exception Handling ---------------------
 
-   io.ctl.pipeline_kill := (io.dat.csr_eret || io.ctl.mem_exception || io.dat.csr_interrupt)
+   io.ctl.pipeline_kill := (io.dat.csr_eret || io.ctl.mem_exception)
 
    val dec_illegal = (!cs_val_inst && io.dat.dec_valid)
 
    // Stall Signal Logic --------------------
-   val stall   = Wire(Bool())
-
    val dec_rs1_addr = io.dat.dec_inst(19, 15)
    val dec_rs2_addr = io.dat.dec_inst(24, 20)
    val dec_wbaddr   = io.dat.dec_inst(11, 7)
-   val dec_rs1_oen  = Mux(deckill, false.B, cs_rs1_oen)
-   val dec_rs2_oen  = Mux(deckill, false.B, cs_rs2_oen)
+   // Only a branch kills decode for the hazard check: the stall holds off an
+   // injected interrupt, so it must not depend on it
+   val dec_rs1_oen  = Mux(exe_pc_sel =/= PC_4, false.B, cs_rs1_oen)
+   val dec_rs2_oen  = Mux(exe_pc_sel =/= PC_4, false.B, cs_rs2_oen)
 
    val exe_reg_wbaddr      = Reg(UInt())
    val mem_reg_wbaddr      = Reg(UInt())
@@ -171,8 +242,6 @@ class CtlPath(implicit val conf: SodorCoreParams) extends Module
    val wb_reg_ctrl_rf_wen  = RegInit(false.B)
    val exe_reg_illegal     = RegInit(false.B)
 
-   val exe_reg_is_csr = RegInit(false.B)
-
    // TODO rename stall==hazard_stall full_stall == cmiss_stall
    val full_stall = Wire(Bool())
    when (!stall && !full_stall)
@@ -182,6 +251,7 @@ class CtlPath(implicit val conf: SodorCoreParams) extends Module
          exe_reg_wbaddr      := 0.U
          exe_reg_ctrl_rf_wen := false.B
          exe_reg_is_csr      := false.B
+         exe_reg_is_wfi      := false.B
          exe_reg_illegal     := false.B
       }
       .otherwise
@@ -189,8 +259,10 @@ class CtlPath(implicit val conf: SodorCoreParams) extends Module
          exe_reg_wbaddr      := dec_wbaddr
          exe_reg_ctrl_rf_wen := cs_rf_wen
          exe_reg_is_csr      := cs_csr_cmd =/= CSR.N && cs_csr_cmd =/= CSR.I
+         exe_reg_is_wfi      := io.dat.dec_valid && io.dat.dec_inst(31, 0) === WFI
          exe_reg_illegal     := dec_illegal
       }
+      exe_reg_interrupt := dec_interrupt
    }
    .elsewhen (stall && !full_stall)
    {
@@ -198,20 +270,37 @@ class CtlPath(implicit val conf: SodorCoreParams) extends Module
       exe_reg_wbaddr      := 0.U
       exe_reg_ctrl_rf_wen := false.B
       exe_reg_is_csr      := false.B
+      exe_reg_is_wfi      := false.B
       exe_reg_illegal     := false.B
+      exe_reg_interrupt   := false.B
    }
    when (!full_stall) {
      mem_reg_wbaddr      := exe_reg_wbaddr
      wb_reg_wbaddr       := mem_reg_wbaddr
      mem_reg_ctrl_rf_wen := exe_reg_ctrl_rf_wen
      wb_reg_ctrl_rf_wen  := mem_reg_ctrl_rf_wen
+     mem_reg_is_csr      := exe_reg_is_csr
+     mem_reg_interrupt   := exe_reg_interrupt
+     mem_reg_is_wfi      := exe_reg_is_wfi
+   }
+   when (dec_interrupt)
+   {
+      interrupt_cause := io.dat.csr_interrupt_cause
+   }
+   // an older trap or eret squashes the injected interrupt, which is retaken later if still pending
+   when (io.ctl.pipeline_kill)
+   {
+      exe_reg_interrupt := false.B
+      mem_reg_interrupt := false.B
+      exe_reg_is_wfi    := false.B
    }
 
    val exe_inst_is_load = RegInit(false.B)
 
    when (!full_stall)
    {
-      exe_inst_is_load := cs_mem_en && (cs_mem_fcn === M_XRD)
+      // an accelerator result, like load data, is only there in mem
+      exe_inst_is_load := (cs_mem_en && (cs_mem_fcn === M_XRD)) || (cs_accel && cs_rf_wen)
    }
 
    // Clear instruction exception (from the "instruction" following xret) when returning from trap
@@ -228,7 +317,8 @@ class CtlPath(implicit val conf: SodorCoreParams) extends Module
       // stall for load-use hazard
       stall := ((exe_inst_is_load) && (exe_reg_wbaddr === dec_rs1_addr) && (exe_reg_wbaddr =/= 0.U) && dec_rs1_oen) ||
                ((exe_inst_is_load) && (exe_reg_wbaddr === dec_rs2_addr) && (exe_reg_wbaddr =/= 0.U) && dec_rs2_oen) ||
-               (exe_reg_is_csr)
+               (exe_reg_is_csr) ||
+               wfi_stall
    }
    else
    {
@@ -241,13 +331,14 @@ class CtlPath(implicit val conf: SodorCoreParams) extends Module
                ((wb_reg_wbaddr  === dec_rs2_addr) && (dec_rs2_addr =/= 0.U) &&  wb_reg_ctrl_rf_wen && dec_rs2_oen) ||
                ((exe_inst_is_load) && (exe_reg_wbaddr === dec_rs1_addr) && (exe_reg_wbaddr =/= 0.U) && dec_rs1_oen) ||
                ((exe_inst_is_load) && (exe_reg_wbaddr === dec_rs2_addr) && (exe_reg_wbaddr =/= 0.U) && dec_rs2_oen) ||
-               ((exe_reg_is_csr))
+               ((exe_reg_is_csr)) ||
+               wfi_stall
    }
 
 
-   // stall full pipeline on D$ miss
+   // stall full pipeline on D$ miss, or while mem waits on the accelerator
    val dmem_val   = io.dat.mem_ctrl_dmem_val
-   full_stall := !((dmem_val && io.dmem.resp.valid) || !dmem_val)
+   full_stall := !((dmem_val && io.dmem.resp.valid) || !dmem_val) || io.dat.mem_accel_stall
 
 
    io.ctl.dec_stall  := stall // stall if, dec stage (pipeline hazard)
@@ -263,16 +354,21 @@ class CtlPath(implicit val conf: SodorCoreParams) extends Module
    io.ctl.rf_wen     := cs_rf_wen
 
    // we need to stall IF while fencei goes through DEC and EXE, as there may
-   // be a store we need to wait to clear in MEM.
-   io.ctl.fencei     := cs_fencei || RegNext(cs_fencei)
+   // be a store we need to wait to clear in MEM, and through MEM, where it
+   // starts draining the write-combining buffer that the refetch waits for.
+   io.ctl.fencei     := fencei_stages
 
    // Exception priority matters!
-   io.ctl.mem_exception := RegNext((exe_reg_illegal || io.dat.exe_inst_misaligned) && !io.dat.csr_eret) || io.dat.mem_data_misaligned
-   io.ctl.mem_exception_cause := Mux(RegNext(exe_reg_illegal),            Causes.illegal_instruction.U,
+   io.ctl.mem_exception := RegNext((exe_reg_illegal || io.dat.exe_inst_misaligned) && !io.dat.csr_eret) || io.dat.mem_data_misaligned ||
+                           io.dat.mem_trigger
+   io.ctl.mem_interrupt := mem_reg_interrupt
+   io.ctl.mem_exception_cause := Mux(mem_reg_interrupt,                     interrupt_cause,
+                                 Mux(io.dat.mem_trigger,                  io.dat.mem_trigger_cause,
+                                 Mux(RegNext(exe_reg_illegal),            Causes.illegal_instruction.U,
                                  Mux(RegNext(io.dat.exe_inst_misaligned), Causes.misaligned_fetch.U,
                                  Mux(io.dat.mem_store,                    Causes.misaligned_store.U,
                                                                           Causes.misaligned_load.U
-                                 )))
+                                 )))))
 
    // convert CSR instructions with raddr1 == 0 to read-only CSR commands
    val rs1_addr = io.dat.dec_inst(RS1_MSB, RS1_LSB)
@@ -282,5 +378,6 @@ class CtlPath(implicit val conf: SodorCoreParams) extends Module
    io.ctl.mem_val    := cs_mem_en
    io.ctl.mem_fcn    := cs_mem_fcn
    io.ctl.mem_typ    := cs_msk_sel
+   io.ctl.accel_val  := cs_accel
 
 }
@@ -32,9 +32,14 @@ class DatToCtlIo(implicit val conf: SodorCoreParams) extends Bundle()
    val mem_ctrl_dmem_val = Output(Bool())
    val mem_data_misaligned = Output(Bool())
    val mem_store = Output(Bool())
+   val mem_accel_stall = Output(Bool()) // the custom instruction in mem waits on the accelerator
+   val mem_trigger = Output(Bool()) // a trigger traps on the instruction in mem
+   val mem_trigger_cause = Output(UInt(conf.xprlen.W))
 
    val csr_eret = Output(Bool())
    val csr_interrupt = Output(Bool())
+   val csr_interrupt_cause = Output(UInt(conf.xprlen.W))
+   val csr_stall = Output(Bool()) // asleep in WFI until an interrupt is pending
 }
 
 class DpathIo(implicit val p: Parameters, val conf: SodorCoreParams) extends Bundle
@@ -42,6 +47,9 @@ class DpathIo(implicit val p: Parameters, val conf: SodorCoreParams) extends Bun
    val ddpath = Flipped(new DebugDPath())
    val imem = new MemPortIo(conf.xprlen)
    val dmem = new MemPortIo(conf.xprlen)
+   val dmem_pc = Output(UInt(conf.xprlen.W))
+   val fence = Output(Bool())
+   val accel = new SodorAccelIo()
    val ctl  = Flipped(new CtlToDatIo())
    val dat  = new DatToCtlIo()
    val interrupt = Input(new CoreInterrupts(false))
@@ -58,6 +66,8 @@ class DatPath(implicit val p: Parameters, val conf: SodorCoreParams) extends Mod
    // Exception handling values (all read during mem_stage)
    val mem_tval_data_ma = Wire(UInt(conf.xprlen.W))
    val mem_tval_inst_ma = Wire(UInt(conf.xprlen.W))
+   val mem_trigger      = Wire(Bool())
+   val mem_trigger_tval = Wire(UInt(conf.xprlen.W))
 
    //**********************************
 
@@ -91,6 +101,7 @@ class DatPath(implicit val p: Parameters, val conf: SodorCoreParams) extends Mod
    val exe_reg_ctrl_mem_fcn  = RegInit(M_X)
    val exe_reg_ctrl_mem_typ  = RegInit(MT_X)
    val exe_reg_ctrl_csr_cmd  = RegInit(CSR.N)
+   val exe_reg_ctrl_accel_val = RegInit(false.B)
 
    // Memory State
    val mem_reg_valid         = RegInit(false.B)
@@ -109,6 +120,7 @@ class DatPath(implicit val p: Parameters, val conf: SodorCoreParams) extends Mod
    val mem_reg_ctrl_mem_typ  = RegInit(MT_X)
    val mem_reg_ctrl_wb_sel   = Reg(UInt())
    val mem_reg_ctrl_csr_cmd  = RegInit(CSR.N)
+   val mem_reg_ctrl_accel_val = RegInit(false.B)
 
    // Writeback State
    val wb_reg_valid          = RegInit(false.B)
@@ -119,15 +131,24 @@ class DatPath(implicit val p: Parameters, val conf: SodorCoreParams) extends Mod
 
    //**********************************
    // Instruction Fetch Stage
-   val if_pc_next          = Wire(UInt(32.W))
-   val exe_brjmp_target    = Wire(UInt(32.W))
-   val exe_jump_reg_target = Wire(UInt(32.W))
-   val exception_target    = Wire(UInt(32.W))
+   val if_pc_next          = Wire(UInt(conf.xprlen.W))
+   val exe_brjmp_target    = Wire(UInt(conf.xprlen.W))
+   val exe_jump_reg_target = Wire(UInt(conf.xprlen.W))
+   val exception_target    = Wire(UInt(conf.xprlen.W))
+
+   // Loop buffer
+   // Instructions come from the loop buffer when it hits and no instruction memory request is
+   // outstanding (so that responses stay in order); imem is then left idle.
+   val if_lb_hit = Wire(Bool())
+   val if_lb_inst = Wire(UInt(conf.xprlen.W))
+   val if_imem_inflight = RegInit(false.B)
+   if_lb_hit := false.B
+   if_lb_inst := BUBBLE
 
    // Instruction fetch buffer
    val if_buffer_in = Wire(new DecoupledIO(new MemResp(conf.xprlen)))
-   if_buffer_in.bits := io.imem.resp.bits
-   if_buffer_in.valid := io.imem.resp.valid
+   if_buffer_in.bits.data := Mux(if_lb_hit, if_lb_inst, io.imem.resp.bits.data)
+   if_buffer_in.valid := Mux(if_lb_hit, if_buffer_in.ready, io.imem.resp.valid)
    assert(!(if_buffer_in.valid && !if_buffer_in.ready), "Instruction backlog")
 
    val if_buffer_out = Queue(if_buffer_in, entries = 1, pipe = false, flow = true)
@@ -173,7 +194,7 @@ class DatPath(implicit val p: Parameters, val conf: SodorCoreParams) extends Mod
    }
 
    // Instruction Memory
-   io.imem.req.valid := if_buffer_in.ready
+   io.imem.req.valid := if_buffer_in.ready && !if_lb_hit
    io.imem.req.bits.fcn := M_XRD
    io.imem.req.bits.typ := MT_WU
    io.imem.req.bits.addr := if_reg_pc
@@ -193,7 +214,7 @@ class DatPath(implicit val p: Parameters, val conf: SodorCoreParams) extends Mod
       .elsewhen (if_buffer_out.valid)
       {
          dec_reg_valid := true.B
-         dec_reg_inst := if_buffer_out.bits.data
+         dec_reg_inst := if_buffer_out.bits.data(31, 0) // the fetched word is the low half on RV64
       }
       .otherwise
       {
@@ -239,11 +260,11 @@ class DatPath(implicit val p: Parameters, val conf: SodorCoreParams) extends Mod
    val imm_z = Cat(Fill(27,0.U), dec_reg_inst(19,15))
 
    // sign-extend immediates
-   val imm_itype_sext  = Cat(Fill(20,imm_itype(11)), imm_itype)
-   val imm_stype_sext  = Cat(Fill(20,imm_stype(11)), imm_stype)
-   val imm_sbtype_sext = Cat(Fill(19,imm_sbtype(11)), imm_sbtype, 0.U)
-   val imm_utype_sext  = Cat(imm_utype, Fill(12,0.U))
-   val imm_ujtype_sext = Cat(Fill(11,imm_ujtype(19)), imm_ujtype, 0.U)
+   val imm_itype_sext  = Cat(Fill(conf.xprlen-12,imm_itype(11)), imm_itype)
+   val imm_stype_sext  = Cat(Fill(conf.xprlen-12,imm_stype(11)), imm_stype)
+   val imm_sbtype_sext = Cat(Fill(conf.xprlen-13,imm_sbtype(11)), imm_sbtype, 0.U)
+   val imm_utype_sext  = Cat(Fill(conf.xprlen-32,imm_utype(19)), imm_utype, Fill(12,0.U))
+   val imm_ujtype_sext = Cat(Fill(conf.xprlen-21,imm_ujtype(19)), imm_ujtype, 0.U)
 
    // Operand 2 Mux
    val dec_alu_op2 = MuxCase(0.U, Array(
@@ -312,6 +333,7 @@ class DatPath(implicit val p: Parameters, val conf: SodorCoreParams) extends Mod
       exe_reg_ctrl_mem_fcn  := M_X
       exe_reg_ctrl_csr_cmd  := CSR.N
       exe_reg_ctrl_br_type  := BR_N
+      exe_reg_ctrl_accel_val := false.B
    }
    .elsewhen(!io.ctl.dec_stall && !io.ctl.full_stall)
    {
@@ -336,6 +358,7 @@ class DatPath(implicit val p: Parameters, val conf: SodorCoreParams) extends Mod
          exe_reg_ctrl_mem_fcn  := M_X
          exe_reg_ctrl_csr_cmd  := CSR.N
          exe_reg_ctrl_br_type  := BR_N
+         exe_reg_ctrl_accel_val := false.B
       }
       .otherwise
       {
@@ -348,6 +371,7 @@ class DatPath(implicit val p: Parameters, val conf: SodorCoreParams) extends Mod
          exe_reg_ctrl_mem_typ  := io.ctl.mem_typ
          exe_reg_ctrl_csr_cmd  := io.ctl.csr_cmd
          exe_reg_ctrl_br_type  := io.ctl.br_type
+         exe_reg_ctrl_accel_val := io.ctl.accel_val
       }
    }
 
@@ -358,9 +382,20 @@ class DatPath(implicit val p: Parameters, val conf: SodorCoreParams) extends Mod
    val exe_alu_op2 = exe_reg_op2_data.asUInt
 
    // ALU
-   val alu_shamt     = exe_alu_op2(4,0).asUInt
+   val alu_shamt     = exe_alu_op2(log2Ceil(conf.xprlen)-1,0).asUInt
    val exe_adder_out = (exe_alu_op1 + exe_alu_op2)(conf.xprlen-1,0)
 
+   // RV64 *W operations: computed on the low 32 bits, result sign-extended
+   def sext_w(x: UInt) = Cat(Fill(conf.xprlen-32, x(31)), x(31, 0))
+   val alu_shamt_w   = exe_alu_op2(4,0).asUInt
+   val exe_alu_w_ops = if (conf.xprlen != 64) Nil else Seq(
+                  (exe_reg_ctrl_alu_fun === ALU_ADDW) -> sext_w(exe_adder_out),
+                  (exe_reg_ctrl_alu_fun === ALU_SUBW) -> sext_w(exe_alu_op1 - exe_alu_op2),
+                  (exe_reg_ctrl_alu_fun === ALU_SLLW) -> sext_w(exe_alu_op1 << alu_shamt_w),
+                  (exe_reg_ctrl_alu_fun === ALU_SRLW) -> sext_w(exe_alu_op1(31,0) >> alu_shamt_w),
+                  (exe_reg_ctrl_alu_fun === ALU_SRAW) -> sext_w((exe_alu_op1(31,0).asSInt >> alu_shamt_w).asUInt)
+                  )
+
    //only for debug purposes right now until debug() works
    exe_alu_out := MuxCase(exe_reg_inst.asUInt, Array(
                   (exe_reg_ctrl_alu_fun === ALU_ADD)  -> exe_adder_out,
@@ -374,8 +409,10 @@ class DatPath(implicit val p: Parameters, val conf: SodorCoreParams) extends Mod
                   (exe_reg_ctrl_alu_fun === ALU_SRA)  -> (exe_alu_op1.asSInt >> alu_shamt).asUInt,
                   (exe_reg_ctrl_alu_fun === ALU_SRL)  -> (exe_alu_op1 >> alu_shamt).asUInt,
                   (exe_reg_ctrl_alu_fun === ALU_COPY_1)-> exe_alu_op1,
-                  (exe_reg_ctrl_alu_fun === ALU_COPY_2)-> exe_alu_op2
-                  ))
+                  (exe_reg_ctrl_alu_fun === ALU_COPY_2)-> exe_alu_op2,
+                  (exe_reg_ctrl_alu_fun === ALU_CZEQZ)-> Mux(exe_alu_op2 === 0.U, 0.U, exe_alu_op1),
+                  (exe_reg_ctrl_alu_fun === ALU_CZNEZ)-> Mux(exe_alu_op2 =/= 0.U, 0.U, exe_alu_op1)
+                  ) ++ exe_alu_w_ops)
 
    // Branch/Jump Target Calculation
    val brjmp_offset    = exe_reg_op2_data
@@ -391,6 +428,33 @@ class DatPath(implicit val p: Parameters, val conf: SodorCoreParams) extends Mod
 
    val exe_pc_plus4    = (exe_reg_pc + 4.U)(conf.xprlen-1,0)
 
+   if (USE_LOOP_BUFFER)
+   {
+      val loop_buffer = Module(new LoopBuffer(LOOP_BUFFER_ENTRIES))
+      loop_buffer.io.fetch_pc  := if_reg_pc
+      if_lb_hit  := loop_buffer.io.hit && !if_imem_inflight
+      if_lb_inst := loop_buffer.io.inst
+
+      // A response to a fetch that was killed belongs to the old path, not
+      // to if_reg_pc, which already points at the new one
+      loop_buffer.io.fill_val  := io.imem.resp.valid && !if_reg_killed
+      loop_buffer.io.fill_pc   := if_reg_pc
+      loop_buffer.io.fill_inst := io.imem.resp.bits.data
+
+      // short backward taken branch or jump
+      loop_buffer.io.loop_val   := io.ctl.exe_pc_sel === PC_BRJMP && exe_brjmp_target <= exe_reg_pc &&
+                                   (exe_reg_pc - exe_brjmp_target) < (LOOP_BUFFER_ENTRIES * 4).U
+      loop_buffer.io.loop_start := exe_brjmp_target
+      loop_buffer.io.loop_end   := exe_reg_pc
+
+      loop_buffer.io.redirect_val    := io.ctl.if_kill
+      loop_buffer.io.redirect_target := if_pc_next
+      loop_buffer.io.flush           := io.ctl.fencei || io.ctl.pipeline_kill
+
+      when (io.imem.req.fire && !io.imem.resp.valid) { if_imem_inflight := true.B }
+      .elsewhen (io.imem.resp.valid) { if_imem_inflight := false.B }
+   }
+
    when (io.ctl.pipeline_kill)
    {
       mem_reg_valid         := false.B
@@ -398,6 +462,7 @@ class DatPath(implicit val p: Parameters, val conf: SodorCoreParams) extends Mod
       mem_reg_ctrl_rf_wen   := false.B
       mem_reg_ctrl_mem_val  := false.B
       mem_reg_ctrl_csr_cmd  := false.B
+      mem_reg_ctrl_accel_val := false.B
    }
    .elsewhen (!io.ctl.full_stall)
    {
@@ -417,6 +482,7 @@ class DatPath(implicit val p: Parameters, val conf: SodorCoreParams) extends Mod
       mem_reg_ctrl_mem_typ  := exe_reg_ctrl_mem_typ
       mem_reg_ctrl_wb_sel   := exe_reg_ctrl_wb_sel
       mem_reg_ctrl_csr_cmd  := exe_reg_ctrl_csr_cmd
+      mem_reg_ctrl_accel_val := exe_reg_ctrl_accel_val
    }
 
    //**********************************
@@ -429,35 +495,61 @@ class DatPath(implicit val p: Parameters, val conf: SodorCoreParams) extends Mod
    csr.io.decode(0).inst := mem_reg_inst
    csr.io.rw.addr   := mem_reg_inst(CSR_ADDR_MSB,CSR_ADDR_LSB)
    csr.io.rw.wdata  := mem_reg_alu_out
-   csr.io.rw.cmd    := mem_reg_ctrl_csr_cmd
+   csr.io.rw.cmd    := Mux(mem_trigger, CSR.N, mem_reg_ctrl_csr_cmd)
 
    csr.io.retire    := wb_reg_valid
-   csr.io.exception := io.ctl.mem_exception
+   csr.io.exception := io.ctl.mem_exception || io.ctl.mem_interrupt
    csr.io.pc        := mem_reg_pc
    exception_target := csr.io.evec
 
    csr.io.tval := MuxCase(0.U, Array(
+                  (mem_trigger)                                                 -> mem_trigger_tval,
                   (io.ctl.mem_exception_cause === Causes.illegal_instruction.U) -> RegNext(exe_reg_inst),
                   (io.ctl.mem_exception_cause === Causes.misaligned_fetch.U)    -> mem_tval_inst_ma,
                   (io.ctl.mem_exception_cause === Causes.misaligned_store.U)    -> mem_tval_data_ma,
                   (io.ctl.mem_exception_cause === Causes.misaligned_load.U)     -> mem_tval_data_ma,
                   ))
 
-   // Interrupt rising edge detector (output trap signal for one cycle on rising edge)
-   val reg_interrupt_handled = RegNext(csr.io.interrupt, false.B)
-   val interrupt_edge = csr.io.interrupt && !reg_interrupt_handled
-
+   // Pending interrupts are injected at decode by the control path. While no trap
+   // is taken, the CSR file is given the pending interrupt's cause so that evec
+   // is already the (vectored) handler address when the interrupt is injected.
    csr.io.interrupts := io.interrupt
    csr.io.hartid := io.hartid
-   io.dat.csr_interrupt := interrupt_edge
-   csr.io.cause := Mux(io.ctl.mem_exception, io.ctl.mem_exception_cause, csr.io.interrupt_cause)
+   io.dat.csr_interrupt := csr.io.interrupt
+   io.dat.csr_interrupt_cause := csr.io.interrupt_cause
+   csr.io.cause := Mux(csr.io.exception, io.ctl.mem_exception_cause, csr.io.interrupt_cause)
    csr.io.ungated_clock := clock
+   io.dat.csr_stall := csr.io.csr_stall
 
    io.dat.csr_eret := csr.io.eret
    // TODO replay? stall?
 
-   // Add your own uarch counters here!
+   // Triggers (see triggers.scala)
+   // Checked in mem, on the instruction about to commit. A trap keeps it from
+   // touching memory, the CSRs or the accelerator.
+   val triggers = SodorTriggers(csr.io.status, csr.io.bp)
+   triggers.foreach { t =>
+      t.io.valid  := mem_reg_valid
+      t.io.pc     := mem_reg_pc
+      t.io.load   := mem_reg_ctrl_mem_val && mem_reg_ctrl_mem_fcn === M_XRD
+      t.io.store  := mem_reg_ctrl_mem_val && mem_reg_ctrl_mem_fcn === M_XWR
+      t.io.addr   := mem_reg_alu_out
+      t.io.commit := !io.ctl.full_stall && !io.ctl.mem_exception
+   }
+   mem_trigger := triggers.map(_.io.xcpt).getOrElse(false.B)
+   mem_trigger_tval := triggers.map(_.io.tval).getOrElse(0.U)
+   io.dat.mem_trigger := mem_trigger
+   io.dat.mem_trigger_cause := triggers.map(_.io.cause).getOrElse(0.U)
+   // Uarch counters and trace output only run while measuring
+   val measure = triggers.map(_.io.measure).getOrElse(true.B)
+
+   // Add your own uarch counters here! Each event has a fixed mhpmcounter
+   // (HPM_* in consts.scala), whichever others are enabled.
+   val uarch_events = (if (triggers.isDefined) Seq(HPM_ROI_CYCLES -> true.B, HPM_ROI_INSTRET -> wb_reg_valid) else Nil) ++
+                      (if (USE_LOOP_BUFFER) Seq(HPM_LOOP_BUFFER_HITS -> (if_lb_hit && if_buffer_in.fire)) else Nil)
+   require(csr.io.counters.size >= HPM_COUNTERS(triggers.isDefined), "Not enough mhpmcounters for the uarch events.")
    csr.io.counters.foreach(_.inc := false.B)
+   uarch_events.foreach { case (i, e) => csr.io.counters(i).inc := e && measure }
 
 
    // Data misalignment detection
@@ -468,8 +560,28 @@ class DatPath(implicit val p: Parameters, val conf: SodorCoreParams) extends Mod
    io.dat.mem_store := mem_reg_ctrl_mem_fcn === M_XWR
    mem_tval_data_ma := mem_reg_alu_out.asUInt
 
+   // Accelerator
+   // The custom instruction sends its command from mem, where nothing older can
+   // kill it any more, and holds the pipeline like a data memory access until
+   // the command is taken and, if it writes rd, the response is back. FENCE
+   // waits in mem for the accelerator to finish its work.
+   val mem_accel_sent = RegInit(false.B)
+   val mem_accel_inst = mem_reg_inst.asTypeOf(new SodorAccelInst)
+   io.accel.cmd.valid     := mem_reg_ctrl_accel_val && !mem_accel_sent && !mem_trigger
+   io.accel.cmd.bits.inst := mem_accel_inst
+   io.accel.cmd.bits.rs1  := mem_reg_op1_data
+   io.accel.cmd.bits.rs2  := mem_reg_rs2_data
+   io.accel.resp.ready    := mem_reg_ctrl_accel_val && mem_accel_inst.xd
+
+   val mem_accel_done = Mux(mem_accel_inst.xd, io.accel.resp.valid, mem_accel_sent || io.accel.cmd.ready)
+   io.dat.mem_accel_stall := (mem_reg_ctrl_accel_val && !mem_accel_done) ||
+                             (mem_reg_valid && Instructions.FENCE === mem_reg_inst && io.accel.busy)
+   when (!io.ctl.full_stall) { mem_accel_sent := false.B }
+   .elsewhen (io.accel.cmd.fire) { mem_accel_sent := true.B }
+
    // WB Mux
    mem_wbdata := MuxCase(mem_reg_alu_out, Array(
+                  (mem_reg_ctrl_accel_val)         -> io.accel.resp.bits.data,
                   (mem_reg_ctrl_wb_sel === WB_ALU) -> mem_reg_alu_out,
                   (mem_reg_ctrl_wb_sel === WB_PC4) -> mem_reg_alu_out,
                   (mem_reg_ctrl_wb_sel === WB_MEM) -> io.dmem.resp.bits.data,
@@ -482,10 +594,10 @@ class DatPath(implicit val p: Parameters, val conf: SodorCoreParams) extends Mod
 
    when (!io.ctl.full_stall)
    {
-      wb_reg_valid         := mem_reg_valid && !io.ctl.mem_exception && !interrupt_edge
+      wb_reg_valid         := mem_reg_valid && !io.ctl.mem_exception
       wb_reg_wbaddr        := mem_reg_wbaddr
       wb_reg_wbdata        := mem_wbdata
-      wb_reg_ctrl_rf_wen   := Mux(io.ctl.mem_exception || interrupt_edge, false.B, mem_reg_ctrl_rf_wen)
+      wb_reg_ctrl_rf_wen   := Mux(io.ctl.mem_exception, false.B, mem_reg_ctrl_rf_wen)
    }
    .otherwise
    {
@@ -509,35 +621,188 @@ class DatPath(implicit val p: Parameters, val conf: SodorCoreParams) extends Mod
    io.dat.mem_ctrl_dmem_val := mem_reg_ctrl_mem_val
 
    // datapath to data memory outputs
-   io.dmem.req.valid     := mem_reg_ctrl_mem_val && !io.dat.mem_data_misaligned
+   io.dmem.req.valid     := mem_reg_ctrl_mem_val && !io.dat.mem_data_misaligned && !mem_trigger
    io.dmem.req.bits.addr := mem_reg_alu_out.asUInt
+   io.dmem_pc            := mem_reg_pc
+   io.fence              := mem_reg_valid && AbstractCore.isFence(mem_reg_inst)
    io.dmem.req.bits.fcn  := mem_reg_ctrl_mem_fcn
    io.dmem.req.bits.typ  := mem_reg_ctrl_mem_typ
    io.dmem.req.bits.data := mem_reg_rs2_data
 
    val wb_reg_inst = RegNext(mem_reg_inst)
 
-   printf("Cyc= %d [%d] pc=[%x] W[r%d=%x][%d] Op1=[r%d][%x] Op2=[r%d][%x] inst=[%x] %c%c%c DASM(%x)\n",
-      csr.io.time(31,0),
-      csr.io.retire,
-      RegNext(mem_reg_pc),
-      wb_reg_wbaddr,
-      wb_reg_wbdata,
-      wb_reg_ctrl_rf_wen,
-      RegNext(mem_reg_rs1_addr),
-      RegNext(mem_reg_op1_data),
-      RegNext(mem_reg_rs2_addr),
-      RegNext(mem_reg_op2_data),
-      wb_reg_inst,
-      MuxCase(Str(" "), Seq(
-         io.ctl.pipeline_kill -> Str("K"),
-         io.ctl.full_stall -> Str("F"),
-         io.ctl.dec_stall -> Str("S"))),
-      MuxLookup(io.ctl.exe_pc_sel, Str("?"))(Seq(
-         PC_BRJMP -> Str("B"),
-         PC_JALR -> Str("R"),
-         PC_EXC -> Str("E"),
-         PC_4 -> Str(" "))),
-      Mux(csr.io.exception, Str("X"), Str(" ")),
-      wb_reg_inst)
+   // Basic-block vector profiling from the retire valid/pc shown in the trace below
+   if (conf.useBBV)
+   {
+      SodorBBV(io.hartid, csr.io.retire && measure, RegNext(mem_reg_pc))
+   }
+
+   // Live telemetry of the whole run, regardless of measuring; stalls are
+   // hazards and memory waits, kills are redirects and pipeline flushes
+   if (conf.useTelemetry)
+   {
+      SodorTelemetry(io.hartid, csr.io.retire, RegNext(mem_reg_pc),
+         io.ctl.dec_stall || io.ctl.full_stall, io.ctl.pipeline_kill || io.ctl.if_kill)
+   }
+
+   when (measure)
+   {
+      printf("Cyc= %d [%d] pc=[%x] W[r%d=%x][%d] Op1=[r%d][%x] Op2=[r%d][%x] inst=[%x] %c%c%c DASM(%x)\n",
+         csr.io.time(31,0),
+         csr.io.retire,
+         RegNext(mem_reg_pc),
+         wb_reg_wbaddr,
+         wb_reg_wbdata,
+         wb_reg_ctrl_rf_wen,
+         RegNext(mem_reg_rs1_addr),
+         RegNext(mem_reg_op1_data),
+         RegNext(mem_reg_rs2_addr),
+         RegNext(mem_reg_op2_data),
+         wb_reg_inst,
+         MuxCase(Str(" "), Seq(
+            io.ctl.pipeline_kill -> Str("K"),
+            io.ctl.full_stall -> Str("F"),
+            io.ctl.dec_stall -> Str("S"))),
+         MuxLookup(io.ctl.exe_pc_sel, Str("?"))(Seq(
+            PC_BRJMP -> Str("B"),
+            PC_JALR -> Str("R"),
+            PC_EXC -> Str("E"),
+            PC_4 -> Str(" "))),
+         Mux(csr.io.exception, Str("X"), Str(" ")),
+         wb_reg_inst)
+   }
+
+   //**********************************
+   // Co-simulation: check every retired instruction against the reference model.
+   // Traps are taken in MEM, after everything in WB has retired.
+   if (conf.useCosim)
+   {
+      val cosim = SodorCosim(io.hartid)
+      cosim.io.commit_valid   := wb_reg_valid
+      cosim.io.commit_pc      := RegNext(mem_reg_pc)
+      cosim.io.commit_inst    := wb_reg_inst
+      cosim.io.commit_wen     := wb_reg_ctrl_rf_wen
+      cosim.io.commit_rd      := wb_reg_wbaddr
+      cosim.io.commit_wdata   := wb_reg_wbdata
+      cosim.io.trap_valid     := csr.io.exception
+      cosim.io.trap_interrupt := io.ctl.mem_interrupt
+      cosim.io.trap_target    := exception_target
+   }
+
+   //**********************************
+   // Pipeline view trace
+   // Follow each instruction from IF to WB, stamping the cycle it entered every
+   // stage (see common/pipeview.scala). The stamps ride along the stage registers.
+   if (PRINT_PIPEVIEW)
+   {
+      val pv_cycle = PipeView.cycle()
+      val pv_next  = pv_cycle + 1.U
+      val pv_seq   = RegInit(0.U(32.W))
+      val pv_dec   = Reg(new PipeViewStamps)
+      val pv_exe   = Reg(new PipeViewStamps)
+      val pv_mem   = Reg(new PipeViewStamps)
+      val pv_wb    = Reg(new PipeViewStamps)
+      val pv_wb_pc = Reg(UInt(conf.xprlen.W))
+
+      // the cycle each instruction arrived, kept alongside the fetch buffer
+      val pv_fetch_in = Wire(new DecoupledIO(UInt(32.W)))
+      pv_fetch_in.bits := pv_cycle
+      pv_fetch_in.valid := if_buffer_in.valid
+      val pv_fetch_out = Queue(pv_fetch_in, entries = 1, pipe = false, flow = true)
+      pv_fetch_out.ready := if_buffer_out.ready
+
+      val full_stall = io.ctl.full_stall
+      val pipeline_kill = io.ctl.pipeline_kill
+
+      // IF -> DEC
+      val if_stamps = PipeView.stamps(pv_seq, pv_fetch_out.bits)
+      when (if_buffer_out.fire)
+      {
+         pv_seq := pv_seq + 1.U
+         when (pipeline_kill || io.ctl.if_kill || if_reg_killed)
+         {
+            PipeView.squash(if_stamps, if_pc_buffer_out.bits, if_buffer_out.bits.data, Mux(pipeline_kill, Str('K'), Str('B')), measure)
+         }
+         .otherwise
+         {
+            pv_dec := if_stamps
+            pv_dec.decode := pv_next
+         }
+      }
+
+      // DEC -> EXE
+      when (dec_reg_valid)
+      {
+         when (pipeline_kill)
+         {
+            PipeView.squash(pv_dec, dec_reg_pc, dec_reg_inst, Str('K'), measure)
+         }
+         .elsewhen (full_stall)
+         {
+            pv_dec.mem_wait := pv_dec.mem_wait + 1.U
+         }
+         .elsewhen (io.ctl.dec_stall)
+         {
+            pv_dec.hazard := pv_dec.hazard + 1.U
+         }
+         .elsewhen (io.ctl.dec_kill)
+         {
+            PipeView.squash(pv_dec, dec_reg_pc, dec_reg_inst, Mux(io.ctl.exe_pc_sel === PC_EXC, Str('I'), Str('B')), measure)
+         }
+         .otherwise
+         {
+            pv_exe := pv_dec
+            pv_exe.execute := pv_next
+         }
+      }
+
+      // EXE -> MEM
+      when (exe_reg_valid)
+      {
+         when (pipeline_kill)
+         {
+            PipeView.squash(pv_exe, exe_reg_pc, exe_reg_inst, Str('K'), measure)
+         }
+         .elsewhen (full_stall)
+         {
+            pv_exe.mem_wait := pv_exe.mem_wait + 1.U
+         }
+         .otherwise
+         {
+            pv_mem := pv_exe
+            pv_mem.memory := pv_next
+         }
+      }
+
+      // MEM -> WB
+      when (mem_reg_valid)
+      {
+         when (!full_stall)
+         {
+            when (io.ctl.mem_exception)
+            {
+               PipeView.squash(pv_mem, mem_reg_pc, mem_reg_inst, Str('X'), measure)
+            }
+            .otherwise
+            {
+               pv_wb := pv_mem
+               pv_wb_pc := mem_reg_pc
+            }
+         }
+         .elsewhen (pipeline_kill)
+         {
+            PipeView.squash(pv_mem, mem_reg_pc, mem_reg_inst, Str('K'), measure)
+         }
+         .otherwise
+         {
+            pv_mem.mem_wait := pv_mem.mem_wait + 1.U
+         }
+      }
+
+      // WB
+      when (wb_reg_valid)
+      {
+         PipeView.retire(pv_wb, pv_wb_pc, wb_reg_inst, pv_cycle, measure)
+      }
+   }
 }
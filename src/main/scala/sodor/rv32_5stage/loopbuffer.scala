@@ -0,0 +1,82 @@
+//**************************************************************************
+// RISCV Processor Loop Buffer
+//--------------------------------------------------------------------------
+//
+// Holds the body of a short loop so that the IF stage can re-fetch it
+// without sending requests to the instruction memory port.
+//
+// A loop is detected when a taken branch/jump in EXE goes backwards by at
+// most `entries` instructions. The body [target, branch pc] is then captured
+// from the instruction memory responses on the next iteration and served from
+// the buffer afterwards. The buffer is dropped on FENCE.I, on a pipeline kill
+// (exception, interrupt, eret) and on any redirect that leaves the loop.
+
+package sodor.stage5
+
+import chisel3._
+import chisel3.util._
+
+import sodor.stage5.Constants._
+import sodor.common._
+
+class LoopBufferIo(implicit val conf: SodorCoreParams) extends Bundle()
+{
+   // Fetch lookup
+   val fetch_pc = Input(UInt(conf.xprlen.W))
+   val hit      = Output(Bool())
+   val inst     = Output(UInt(conf.xprlen.W))
+
+   // Instructions returned by the instruction memory
+   val fill_val  = Input(Bool())
+   val fill_pc   = Input(UInt(conf.xprlen.W))
+   val fill_inst = Input(UInt(conf.xprlen.W))
+
+   // Taken backward branch/jump resolved in EXE
+   val loop_val   = Input(Bool())
+   val loop_start = Input(UInt(conf.xprlen.W))
+   val loop_end   = Input(UInt(conf.xprlen.W))
+
+   // Invalidation
+   val redirect_val    = Input(Bool())
+   val redirect_target = Input(UInt(conf.xprlen.W))
+   val flush           = Input(Bool())
+}
+
+class LoopBuffer(entries: Int)(implicit val conf: SodorCoreParams) extends Module
+{
+   val io = IO(new LoopBufferIo())
+   require(isPow2(entries), "Loop buffer size must be a power of 2")
+
+   val reg_active = RegInit(false.B)
+   val reg_start  = Reg(UInt(conf.xprlen.W))
+   val reg_end    = Reg(UInt(conf.xprlen.W))
+   val reg_valid  = RegInit(VecInit(Seq.fill(entries)(false.B)))
+   val reg_insts  = Reg(Vec(entries, UInt(conf.xprlen.W)))
+
+   def inLoop(pc: UInt) = reg_active && pc >= reg_start && pc <= reg_end
+   def index(pc: UInt) = ((pc - reg_start) >> 2)(log2Ceil(entries) - 1, 0)
+
+   io.hit  := inLoop(io.fetch_pc) && reg_valid(index(io.fetch_pc))
+   io.inst := reg_insts(index(io.fetch_pc))
+
+   when (io.fill_val && inLoop(io.fill_pc))
+   {
+      reg_insts(index(io.fill_pc)) := io.fill_inst
+      reg_valid(index(io.fill_pc)) := true.B
+   }
+
+   // A newly detected loop replaces the current one
+   when (io.loop_val && !(reg_active && io.loop_start === reg_start && io.loop_end === reg_end))
+   {
+      reg_active := true.B
+      reg_start  := io.loop_start
+      reg_end    := io.loop_end
+      reg_valid.foreach(_ := false.B)
+   }
+
+   when (io.flush || (io.redirect_val && !inLoop(io.redirect_target)))
+   {
+      reg_active := false.B
+      reg_valid.foreach(_ := false.B)
+   }
+}
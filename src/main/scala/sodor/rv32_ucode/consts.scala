@@ -81,6 +81,8 @@ trait ScalarOpConstants extends MemoryOpConstants
    val ALU_SLTU     = 15.asUInt(5.W)
    val ALU_MASK_12  = 16.asUInt(5.W)  // output A with lower 12 bits cleared (AUIPC)
    val ALU_EVEC     = 17.asUInt(5.W)  // output evec from CSR file
+   val ALU_CZEQZ    = 18.asUInt(5.W)  // output A, or zero if B is zero (CZERO.EQZ)
+   val ALU_CZNEZ    = 19.asUInt(5.W)  // output A, or zero if B is not zero (CZERO.NEZ)
    val ALU_X        = 0.asUInt(5.W)
 
    // ALU Enable Signal
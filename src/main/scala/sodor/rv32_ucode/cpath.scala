@@ -58,7 +58,10 @@ class CtlPath(implicit val conf: SodorCoreParams) extends Module
    // Compile the Micro-code down into a ROM
   val (label_target_map, label_sz) = MicrocodeCompiler.constructLabelTargetMap(Microcode.codes)
   val rombits                      = MicrocodeCompiler.emitRomBits(Microcode.codes, label_target_map, label_sz)
-  val opcode_dispatch_table        = MicrocodeCompiler.generateDispatchTable(label_target_map)
+  // Without Zicond the CZERO routines stay in the ROM but are not dispatched to
+  val dispatch_labels              = if (conf.useConditionalZero) label_target_map
+                                     else label_target_map -- Seq("CZERO_EQZ", "CZERO_NEZ")
+  val opcode_dispatch_table        = MicrocodeCompiler.generateDispatchTable(dispatch_labels)
 
 
    // Macro Instruction Opcode Dispatch Table
@@ -113,8 +116,12 @@ class CtlPath(implicit val conf: SodorCoreParams) extends Module
                     ))
 
 
+   // After a WFI the micro-PC waits in FETCH until an interrupt is pending
+   val wfi_sleep = io.dat.csr_stall && io.ctl.upc_is_fetch
+
    upc_state_next := MuxCase(upc_state, Array(
                       (non_illegal_trap)         -> label_target_map("ILLEGAL").asUInt(label_sz.W),
+                      (wfi_sleep)                -> upc_state,
                       (upc_sel === UPC_DISPATCH) -> upc_opgroup_target,
                       (upc_sel === UPC_ABSOLUTE) -> cs.upc_rom_target,
                       (upc_sel === UPC_NEXT)     -> (upc_state + 1.U),
@@ -154,7 +161,7 @@ class CtlPath(implicit val conf: SodorCoreParams) extends Module
    // track whether current instruction caused an exception
    val en_retire = RegInit(false.B)
    when (io.ctl.upc_is_fetch) {
-      en_retire := true.B
+      en_retire := !wfi_sleep // the WFI retires once, in the first cycle of its sleep
    }
    when (io.ctl.exception) {
       en_retire := false.B
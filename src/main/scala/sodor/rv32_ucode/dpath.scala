@@ -23,6 +23,7 @@ class DatToCtlIo extends Bundle()
    val alu_zero = Output(Bool())
    val csr_eret = Output(Bool())
    val interrupt = Output(Bool())
+   val csr_stall = Output(Bool()) // asleep in WFI until an interrupt is pending
    val addr_exception = Output(Bool())
 }
 
@@ -173,19 +174,29 @@ class DatPath(implicit val p: Parameters, val conf: SodorCoreParams) extends Mod
    csr.io.rw.wdata := csr_wdata
    csr.io.rw.cmd   := io.ctl.csr_cmd
    csr_rdata       := csr.io.rw.rdata
+   // A pending interrupt is taken in FETCH, before the next instruction is
+   // fetched, so mepc is the PC itself rather than the instruction just run
+   val interrupt_taken = csr.io.interrupt && io.ctl.upc_is_fetch
    csr.io.retire    := io.ctl.retire
-   csr.io.pc        := regfile(PC_IDX) - 4.U
-   exception_target := csr.io.evec
+   csr.io.pc        := regfile(PC_IDX) - Mux(interrupt_taken, 0.U, 4.U)
+
+   // The trap routine writes evec to the PC a cycle or two after the trap is
+   // raised, by when the CSR file's cause input has moved on (mtvec vectored
+   // mode depends on it), so keep the target computed with the trap
+   val trap_target = RegEnable(csr.io.evec, csr.io.exception)
+   val in_trap = RegInit(false.B)
+   when (csr.io.exception) { in_trap := true.B } .elsewhen (io.ctl.upc_is_fetch) { in_trap := false.B }
+   exception_target := Mux(in_trap, trap_target, csr.io.evec)
 
    csr.io.interrupts := io.interrupt
    csr.io.hartid := io.hartid
 
    io.dat.csr_eret := csr.io.eret
+   io.dat.csr_stall := csr.io.csr_stall
 
-   val interrupt_handled = RegInit(false.B)
-   when (io.ctl.retire) { interrupt_handled := csr.io.interrupt }
-   val interrupt_edge = csr.io.interrupt && ! interrupt_handled
-   io.dat.interrupt := interrupt_edge
+   // Taking the interrupt clears MIE, so it is level-sensitive like on the
+   // other cores: it is taken again after mret if it is still pending
+   io.dat.interrupt := csr.io.interrupt
 
   // Delay exception for CSR to avoid combinational loop
   // If there is an exception, we will enter ILLEGAL state in the next cycle
@@ -195,9 +206,10 @@ class DatPath(implicit val p: Parameters, val conf: SodorCoreParams) extends Mod
                         Mux(RegNext(mem_store),         Causes.misaligned_store.U,
                                                         Causes.misaligned_load.U
                         )))
-  csr.io.exception := delayed_exception
+  csr.io.exception := delayed_exception || interrupt_taken
   csr.io.cause := Mux(delayed_exception, exception_cause, csr.io.interrupt_cause)
   csr.io.tval := MuxCase(0.U, Array(
+              (interrupt_taken)                                   -> 0.U,
               (exception_cause === Causes.illegal_instruction.U)  -> io.dat.inst,
               (exception_cause === Causes.misaligned_fetch.U)     -> tval_inst_ma,
               (exception_cause === Causes.misaligned_store.U)     -> tval_data_ma,
@@ -229,7 +241,9 @@ class DatPath(implicit val p: Parameters, val conf: SodorCoreParams) extends Mod
               (io.ctl.alu_op === ALU_SLT)     ->  (reg_a.asSInt < reg_b.asSInt).asUInt,
               (io.ctl.alu_op === ALU_SLTU)    ->  (reg_a < reg_b),
               (io.ctl.alu_op === ALU_MASK_12) ->  (reg_a & ~((1<<12)-1).asUInt(conf.xprlen.W)),
-              (io.ctl.alu_op === ALU_EVEC)    ->  exception_target
+              (io.ctl.alu_op === ALU_EVEC)    ->  exception_target,
+              (io.ctl.alu_op === ALU_CZEQZ)   ->  Mux(reg_b === 0.U, 0.U, reg_a),
+              (io.ctl.alu_op === ALU_CZNEZ)   ->  Mux(reg_b =/= 0.U, 0.U, reg_a)
             ))
 
    // Output Signals to the Control Path
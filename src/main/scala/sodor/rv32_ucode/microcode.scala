@@ -250,6 +250,16 @@ object Microcode
    /* B  <- Reg[rs2]   */,                  Signals(Cat(CSR.N, LDIR_0, RS_RS2, RWR_0, REN_1, LDA_0, LDB_1, ALU_X      , AEN_0, LDMA_X, MWR_0, MEN_0, MT_X , IS_X , IEN_0, UBR_N), "X")
    /* Reg[rd] <- A ^ B */,                  Signals(Cat(CSR.N, LDIR_0, RS_RD , RWR_1, REN_0, LDA_0, LDB_0, ALU_XOR    , AEN_1, LDMA_X, MWR_0, MEN_0, MT_X , IS_X , IEN_0, UBR_J), "FETCH")
 
+   /* CZERO.EQZ        */
+   /* A  <- Reg[rs1]   */,Label("CZERO_EQZ"),Signals(Cat(CSR.N, LDIR_0, RS_RS1, RWR_0, REN_1, LDA_1, LDB_X, ALU_X      , AEN_0, LDMA_X, MWR_0, MEN_0, MT_X , IS_X , IEN_0, UBR_N), "X")
+   /* B  <- Reg[rs2]   */,                  Signals(Cat(CSR.N, LDIR_0, RS_RS2, RWR_0, REN_1, LDA_0, LDB_1, ALU_X      , AEN_0, LDMA_X, MWR_0, MEN_0, MT_X , IS_X , IEN_0, UBR_N), "X")
+   /* Reg[rd] <- B?A:0 */,                  Signals(Cat(CSR.N, LDIR_0, RS_RD , RWR_1, REN_0, LDA_0, LDB_0, ALU_CZEQZ  , AEN_1, LDMA_X, MWR_0, MEN_0, MT_X , IS_X , IEN_0, UBR_J), "FETCH")
+
+   /* CZERO.NEZ        */
+   /* A  <- Reg[rs1]   */,Label("CZERO_NEZ"),Signals(Cat(CSR.N, LDIR_0, RS_RS1, RWR_0, REN_1, LDA_1, LDB_X, ALU_X      , AEN_0, LDMA_X, MWR_0, MEN_0, MT_X , IS_X , IEN_0, UBR_N), "X")
+   /* B  <- Reg[rs2]   */,                  Signals(Cat(CSR.N, LDIR_0, RS_RS2, RWR_0, REN_1, LDA_0, LDB_1, ALU_X      , AEN_0, LDMA_X, MWR_0, MEN_0, MT_X , IS_X , IEN_0, UBR_N), "X")
+   /* Reg[rd] <- B?0:A */,                  Signals(Cat(CSR.N, LDIR_0, RS_RD , RWR_1, REN_0, LDA_0, LDB_0, ALU_CZNEZ  , AEN_1, LDMA_X, MWR_0, MEN_0, MT_X , IS_X , IEN_0, UBR_J), "FETCH")
+
 
    /* --- Control Transfer Instructions ------------- */
 
@@ -410,7 +420,11 @@ object Microcode
    /* PC <- EVEC        */,                 Signals(Cat(CSR.I, LDIR_0, RS_PC , RWR_1, REN_0, LDA_0, LDB_X, ALU_EVEC   , AEN_1, LDMA_X, MWR_0, MEN_0, MT_X , IS_X , IEN_0, UBR_J), "FETCH")
 
    /* WFI               */
-   /* UBr to FETCH      */,Label("WFI")  ,  Signals(Cat(CSR.N, LDIR_0, RS_X  , RWR_0, REN_0, LDA_X, LDB_X, ALU_X      , AEN_0, LDMA_X, MWR_0, MEN_0, MT_X , IS_X , IEN_0, UBR_J), "FETCH")
+   /* pass inst to CSR  */
+   /* File, which puts  */
+   /* the hart to sleep */
+   /* Reg[CSR addr]<-Imm*/,Label("WFI")  ,  Signals(Cat(CSR.N, LDIR_0, RS_CA , RWR_1, REN_0, LDA_X, LDB_X, ALU_X      , AEN_0, LDMA_X, MWR_0, MEN_0, MT_X , IS_I , IEN_1, UBR_N), "X")
+   /* UBr to FETCH      */,                 Signals(Cat(CSR.I, LDIR_0, RS_X  , RWR_0, REN_0, LDA_X, LDB_X, ALU_X      , AEN_0, LDMA_X, MWR_0, MEN_0, MT_X , IS_X , IEN_0, UBR_J), "FETCH")
 
    /* Custom complex instructions */
 
@@ -0,0 +1,152 @@
+// Branchy against branch-free selection with the Zicond instructions.
+//
+// Each kernel runs twice over the same pseudo-random data: once with min/max
+// built on a conditional branch, whose direction depends on the data, and once
+// with slt + czero.eqz + czero.nez + or, which never redirects fetch. Prints
+// the cycles, instructions, CPI and data-dependent branches of both versions
+// and checks that they agree.
+//
+// czero.eqz/czero.nez are emitted with .insn so that the program also builds
+// with toolchains that do not know Zicond; run it on a core with
+// useConditionalZero (the default) or on spike with the zicond extension
+// ("make run" passes it).
+
+#include "util.h"
+
+#define N 256
+
+// r = a < b ? a : b, one branch
+#define MIN_BR(r, a, b) \
+    asm volatile ("mv %0, %1\n blt %1, %2, 1f\n mv %0, %2\n1:" : "=&r"(r) : "r"(a), "r"(b))
+#define MAX_BR(r, a, b) \
+    asm volatile ("mv %0, %1\n blt %2, %1, 1f\n mv %0, %2\n1:" : "=&r"(r) : "r"(a), "r"(b))
+
+// r = czero.eqz(b, b < a) | czero.nez(a, b < a)
+#define MIN_CZ(r, a, b) do { long c_; \
+    asm volatile ("slt %1, %3, %2\n" \
+                  ".insn r 0x33, 5, 7, %0, %3, %1\n" /* czero.eqz */ \
+                  ".insn r 0x33, 7, 7, %1, %2, %1\n" /* czero.nez */ \
+                  "or %0, %0, %1" : "=&r"(r), "=&r"(c_) : "r"(a), "r"(b)); } while (0)
+#define MAX_CZ(r, a, b) do { long c_; \
+    asm volatile ("slt %1, %2, %3\n" \
+                  ".insn r 0x33, 5, 7, %0, %3, %1\n" \
+                  ".insn r 0x33, 7, 7, %1, %2, %1\n" \
+                  "or %0, %0, %1" : "=&r"(r), "=&r"(c_) : "r"(a), "r"(b)); } while (0)
+
+static long in[N], out_br[N], out_cz[N];
+static unsigned long c0, i0, c1, i1;
+
+#define START() asm volatile ("rdcycle %0\n rdinstret %1" : "=r"(c0), "=r"(i0))
+#define STOP()  asm volatile ("rdcycle %0\n rdinstret %1" : "=r"(c1), "=r"(i1))
+
+static void report(const char *kernel, const char *version, unsigned long branches)
+{
+    unsigned long cycles = c1 - c0, insts = i1 - i0;
+    unsigned long cpi = cycles * 1000 / insts;
+
+    print_str(kernel);
+    print_str(version);
+    print_uint(cycles);
+    print_str(" cycles, ");
+    print_uint(insts);
+    print_str(" insts, CPI ");
+    print_uint(cpi / 1000);
+    putchar('.');
+    putchar('0' + cpi / 100 % 10);
+    putchar('0' + cpi / 10 % 10);
+    putchar('0' + cpi % 10);
+    print_str(", ");
+    print_uint(branches);
+    print_str(" data-dependent branches\n");
+}
+
+static int check(const char *kernel, int n)
+{
+    for (int i = 0; i < n; i++) {
+        if (out_br[i] != out_cz[i]) {
+            print_str(kernel);
+            print_str("mismatch at ");
+            print_uint(i);
+            putchar('\n');
+            return 1;
+        }
+    }
+    return 0;
+}
+
+int main(void)
+{
+    unsigned int seed = 1;
+    long lo, hi, t, u, v;
+    int err = 0;
+
+    for (int i = 0; i < N; i++) {
+        seed = seed * 1103515245 + 12345;
+        in[i] = (long)(seed >> 16 & 0x3ff) - 512;
+    }
+
+    // running minimum and maximum
+    START();
+    lo = in[0]; hi = in[0];
+    for (int i = 1; i < N; i++) {
+        MIN_BR(lo, lo, in[i]);
+        MAX_BR(hi, hi, in[i]);
+    }
+    STOP();
+    out_br[0] = lo; out_br[1] = hi;
+    report("minmax:  ", "branch ", 2 * (N - 1));
+
+    START();
+    lo = in[0]; hi = in[0];
+    for (int i = 1; i < N; i++) {
+        MIN_CZ(lo, lo, in[i]);
+        MAX_CZ(hi, hi, in[i]);
+    }
+    STOP();
+    out_cz[0] = lo; out_cz[1] = hi;
+    report("minmax:  ", "czero  ", 0);
+    err |= check("minmax:  ", 2);
+
+    // clamp to [-256, 255]
+    lo = -256; hi = 255;
+    START();
+    for (int i = 0; i < N; i++) {
+        MAX_BR(t, in[i], lo);
+        MIN_BR(out_br[i], t, hi);
+    }
+    STOP();
+    report("clamp:   ", "branch ", 2 * N);
+
+    START();
+    for (int i = 0; i < N; i++) {
+        MAX_CZ(t, in[i], lo);
+        MIN_CZ(out_cz[i], t, hi);
+    }
+    STOP();
+    report("clamp:   ", "czero  ", 0);
+    err |= check("clamp:   ", N);
+
+    // 3-tap median filter: max(min(a, b), min(max(a, b), c))
+    START();
+    for (int i = 0; i < N - 2; i++) {
+        MIN_BR(t, in[i], in[i + 1]);
+        MAX_BR(u, in[i], in[i + 1]);
+        MIN_BR(v, u, in[i + 2]);
+        MAX_BR(out_br[i], t, v);
+    }
+    STOP();
+    report("median3: ", "branch ", 4 * (N - 2));
+
+    START();
+    for (int i = 0; i < N - 2; i++) {
+        MIN_CZ(t, in[i], in[i + 1]);
+        MAX_CZ(u, in[i], in[i + 1]);
+        MIN_CZ(v, u, in[i + 2]);
+        MAX_CZ(out_cz[i], t, v);
+    }
+    STOP();
+    report("median3: ", "czero  ", 0);
+    err |= check("median3: ", N - 2);
+
+    return err;
+}
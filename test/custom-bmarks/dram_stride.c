@@ -0,0 +1,44 @@
+// Loads from off-tile memory at growing strides and prints the cycles per
+// load of each. Small strides stay in one DRAM row, larger ones move to the
+// next bank and the largest ones keep reopening rows in the same bank.
+//
+// Meant for an emulator built with WithSodorDRAMModel, which also prints its
+// row-buffer and queueing statistics on exit. The program itself runs out of
+// the scratchpad; DRAM_BASE must point at off-chip memory past its end.
+
+#include "util.h"
+
+#define DRAM_BASE 0x80100000
+#define LOADS     256
+
+static const unsigned int strides[] = { 4, 64, 2048, 16384, 65536 };
+
+static inline unsigned long rdcycle(void)
+{
+    unsigned long c;
+    asm volatile ("rdcycle %0" : "=r"(c));
+    return c;
+}
+
+int main(void)
+{
+    volatile unsigned int *dram = (volatile unsigned int *)DRAM_BASE;
+    unsigned int sum = 0;
+
+    for (int s = 0; s < sizeof(strides) / sizeof(strides[0]); s++) {
+        unsigned int step = strides[s] / 4;
+        unsigned long c0 = rdcycle();
+        for (int i = 0; i < LOADS; i++)
+            sum += dram[i * step];
+        unsigned long cycles = rdcycle() - c0;
+
+        print_str("dram stride ");
+        print_uint(strides[s]);
+        print_str(": ");
+        print_uint(cycles);
+        print_str(" cycles, ");
+        print_uint(cycles / LOADS);
+        print_str(" per load\n");
+    }
+    return sum == 0xdeadbeef; // keep the loads
+}
@@ -0,0 +1,121 @@
+// Measures the interrupt response time of the core: cycles from the store that
+// raises a machine software interrupt (CLINT msip) to the first instruction of
+// the software-interrupt handler, once with mtvec in direct mode (one trap
+// entry that dispatches on mcause) and once in vectored mode (the hardware
+// jumps to the cause's slot in the vector table).
+//
+// The count includes the store's trip to the CLINT and the interrupt's way
+// back to the tile, so it is an upper bound on the core's own latency.
+
+#include "encoding.h"
+#include "util.h"
+
+#define CLINT_BASE    0x02000000
+#define CLINT_MSIP    (*(volatile unsigned int *)(CLINT_BASE + 0x0))
+
+#define RUNS 8
+
+unsigned int irq_measure(void);
+extern char irq_direct[], irq_vectors[];
+
+// irq_measure raises msip and spins until the handler sends it to irq_return
+// with the handler's first-instruction timestamp in t2. The handler clears
+// msip and MPIE, so the interrupt stays off after mret even if the msip line
+// has not dropped yet.
+asm (
+"   .text\n"
+"   .align 2\n"
+"   .globl irq_measure\n"
+"irq_measure:\n"
+"   li t0, 0x02000000\n"        // CLINT_BASE
+"1: csrr t1, mip\n"             // let a late msip from the last run drain
+"   andi t1, t1, 8\n"           // MIP_MSIP
+"   bnez t1, 1b\n"
+"   li t1, 1\n"
+"   csrsi mstatus, 8\n"         // MSTATUS_MIE
+"   rdcycle a0\n"
+"   sw t1, 0(t0)\n"
+"2: j 2b\n"
+"irq_return:\n"
+"   sub a0, t2, a0\n"
+"   ret\n"
+"\n"
+"msi_handler:\n"
+"   rdcycle t2\n"
+"   li t0, 0x02000000\n"
+"   sw zero, 0(t0)\n"
+"   li t0, 0x80\n"              // MSTATUS_MPIE
+"   csrc mstatus, t0\n"
+"   la t0, irq_return\n"
+"   csrw mepc, t0\n"
+"   mret\n"
+"\n"
+"irq_unexpected:\n"
+"   csrr a0, mcause\n"
+"   slli a0, a0, 1\n"
+"   ori a0, a0, 1\n"
+"   la t0, tohost\n"
+"3: sw a0, 0(t0)\n"
+"   j 3b\n"
+"\n"
+// direct mode: a single entry reads mcause and dispatches
+"   .align 2\n"
+"   .globl irq_direct\n"
+"irq_direct:\n"
+"   csrr t0, mcause\n"
+"   bgez t0, irq_unexpected\n"  // not an interrupt
+"   slli t0, t0, 1\n"           // drop the interrupt bit, whatever XLEN
+"   li t1, 6\n"                 // IRQ_M_SOFT << 1
+"   beq t0, t1, msi_handler\n"
+"   j irq_unexpected\n"
+"\n"
+// vectored mode: interrupt n enters at base + 4 * n, exceptions at base
+"   .align 7\n"
+"   .globl irq_vectors\n"
+"irq_vectors:\n"
+"   j irq_unexpected\n"
+"   j irq_unexpected\n"
+"   j irq_unexpected\n"
+"   j msi_handler\n"
+"   j irq_unexpected\n"
+"   j irq_unexpected\n"
+"   j irq_unexpected\n"
+"   j irq_unexpected\n"
+"   j irq_unexpected\n"
+"   j irq_unexpected\n"
+"   j irq_unexpected\n"
+"   j irq_unexpected\n"
+);
+
+// best of RUNS, so that the first run's cold fetches don't count
+static unsigned int latency(unsigned long mtvec)
+{
+    unsigned int best = ~0u;
+    asm volatile ("csrw mtvec, %0" :: "r"(mtvec));
+    for (int i = 0; i < RUNS; i++) {
+        unsigned int t = irq_measure();
+        if (t < best)
+            best = t;
+    }
+    return best;
+}
+
+int main(void)
+{
+    unsigned int direct, vectored;
+
+    CLINT_MSIP = 0;
+    asm volatile ("csrs mie, %0" :: "r"(MIP_MSIP));
+
+    direct = latency((unsigned long)irq_direct);
+    vectored = latency((unsigned long)irq_vectors | 1);
+
+    asm volatile ("csrc mie, %0" :: "r"(MIP_MSIP));
+
+    print_str("irq latency: direct ");
+    print_uint(direct);
+    print_str(" cycles, vectored ");
+    print_uint(vectored);
+    print_str(" cycles\n");
+    return 0;
+}
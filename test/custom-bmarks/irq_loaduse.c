@@ -0,0 +1,191 @@
+// Raises a machine software interrupt while the core runs a chain of
+// load-use pairs, so that on the 5-stage it arrives while decode is held by a
+// load-use stall. Each run puts 0 to RUNS-1 nops between raising the
+// interrupt and the chain, so that the interrupt lands on every cycle of a
+// pair in one run or another.
+//
+// The handler checks that the interrupt was taken as a trap: mcause is the
+// software interrupt and mepc lies between raising it and the end of the
+// chain. The chain's sum checks that no instruction was lost or repeated.
+
+#include "encoding.h"
+#include "util.h"
+
+#define CLINT_BASE    0x02000000
+#define CLINT_MSIP    (*(volatile unsigned int *)(CLINT_BASE + 0x0))
+
+#define RUNS  16
+#define PAIRS 32
+
+long irq_loaduse(long delay, volatile int *one);
+extern char irq_handler[];
+
+volatile int irq_count;
+
+// irq_loaduse jumps into the nop sled RUNS - delay nops before its end. The
+// handler only uses registers that irq_loaduse no longer needs once the
+// interrupt is raised, clears msip and MPIE so that the interrupt stays off
+// after mret, and exits with code 2 (bad mcause) or 3 (bad mepc).
+asm (
+"   .text\n"
+"   .align 2\n"
+"   .globl irq_loaduse\n"
+"irq_loaduse:\n"
+"   li t0, 0x02000000\n"        // CLINT_BASE
+"   li t1, 1\n"
+"   li a2, 0\n"
+"   csrsi mstatus, 8\n"         // MSTATUS_MIE
+"   sw t1, 0(t0)\n"
+"irq_window:\n"
+"   la t2, irq_sled_end\n"
+"   slli a0, a0, 2\n"
+"   sub t2, t2, a0\n"
+"   jr t2\n"
+"   nop\n"
+"   nop\n"
+"   nop\n"
+"   nop\n"
+"   nop\n"
+"   nop\n"
+"   nop\n"
+"   nop\n"
+"   nop\n"
+"   nop\n"
+"   nop\n"
+"   nop\n"
+"   nop\n"
+"   nop\n"
+"   nop\n"
+"   nop\n"
+"irq_sled_end:\n"
+"   lw t3, 0(a1)\n"
+"   add a2, a2, t3\n"
+"   lw t3, 0(a1)\n"
+"   add a2, a2, t3\n"
+"   lw t3, 0(a1)\n"
+"   add a2, a2, t3\n"
+"   lw t3, 0(a1)\n"
+"   add a2, a2, t3\n"
+"   lw t3, 0(a1)\n"
+"   add a2, a2, t3\n"
+"   lw t3, 0(a1)\n"
+"   add a2, a2, t3\n"
+"   lw t3, 0(a1)\n"
+"   add a2, a2, t3\n"
+"   lw t3, 0(a1)\n"
+"   add a2, a2, t3\n"
+"   lw t3, 0(a1)\n"
+"   add a2, a2, t3\n"
+"   lw t3, 0(a1)\n"
+"   add a2, a2, t3\n"
+"   lw t3, 0(a1)\n"
+"   add a2, a2, t3\n"
+"   lw t3, 0(a1)\n"
+"   add a2, a2, t3\n"
+"   lw t3, 0(a1)\n"
+"   add a2, a2, t3\n"
+"   lw t3, 0(a1)\n"
+"   add a2, a2, t3\n"
+"   lw t3, 0(a1)\n"
+"   add a2, a2, t3\n"
+"   lw t3, 0(a1)\n"
+"   add a2, a2, t3\n"
+"   lw t3, 0(a1)\n"
+"   add a2, a2, t3\n"
+"   lw t3, 0(a1)\n"
+"   add a2, a2, t3\n"
+"   lw t3, 0(a1)\n"
+"   add a2, a2, t3\n"
+"   lw t3, 0(a1)\n"
+"   add a2, a2, t3\n"
+"   lw t3, 0(a1)\n"
+"   add a2, a2, t3\n"
+"   lw t3, 0(a1)\n"
+"   add a2, a2, t3\n"
+"   lw t3, 0(a1)\n"
+"   add a2, a2, t3\n"
+"   lw t3, 0(a1)\n"
+"   add a2, a2, t3\n"
+"   lw t3, 0(a1)\n"
+"   add a2, a2, t3\n"
+"   lw t3, 0(a1)\n"
+"   add a2, a2, t3\n"
+"   lw t3, 0(a1)\n"
+"   add a2, a2, t3\n"
+"   lw t3, 0(a1)\n"
+"   add a2, a2, t3\n"
+"   lw t3, 0(a1)\n"
+"   add a2, a2, t3\n"
+"   lw t3, 0(a1)\n"
+"   add a2, a2, t3\n"
+"   lw t3, 0(a1)\n"
+"   add a2, a2, t3\n"
+"   lw t3, 0(a1)\n"
+"   add a2, a2, t3\n"
+"irq_chain_end:\n"
+"   csrci mstatus, 8\n"
+"   mv a0, a2\n"
+"   ret\n"
+"\n"
+"   .align 2\n"
+"   .globl irq_handler\n"
+"irq_handler:\n"
+"   csrr t4, mcause\n"
+"   li a4, 5\n"                 // exit code 2
+"   bgez t4, irq_fail\n"        // not an interrupt
+"   slli t4, t4, 1\n"           // drop the interrupt bit, whatever XLEN
+"   li t5, 6\n"                 // IRQ_M_SOFT << 1
+"   bne t4, t5, irq_fail\n"
+"   csrr t4, mepc\n"
+"   la t5, irq_window\n"
+"   la t6, irq_chain_end\n"
+"   li a4, 7\n"                 // exit code 3
+"   bltu t4, t5, irq_fail\n"
+"   bltu t6, t4, irq_fail\n"
+"   li t4, 0x02000000\n"
+"   sw zero, 0(t4)\n"
+"   li t4, 0x80\n"              // MSTATUS_MPIE
+"   csrc mstatus, t4\n"
+"   la t4, irq_count\n"
+"   lw t5, 0(t4)\n"
+"   addi t5, t5, 1\n"
+"   sw t5, 0(t4)\n"
+"   mret\n"
+"irq_fail:\n"
+"   la t4, tohost\n"
+"1: sw a4, 0(t4)\n"
+"   j 1b\n"
+);
+
+int main(void)
+{
+    static volatile int one = 1;
+
+    CLINT_MSIP = 0;
+    asm volatile ("csrw mtvec, %0" :: "r"(irq_handler));
+    asm volatile ("csrs mie, %0" :: "r"(MIP_MSIP));
+
+    for (long delay = 0; delay < RUNS; delay++) {
+        int before = irq_count;
+        long sum = irq_loaduse(delay, &one);
+        // a late msip from the store must not leak into the next run
+        while (CLINT_MSIP)
+            ;
+        if (irq_count != before + 1) {
+            print_str("irq_loaduse: interrupt not taken once\n");
+            return 4;
+        }
+        if (sum != PAIRS) {
+            print_str("irq_loaduse: wrong sum ");
+            print_uint(sum);
+            print_str("\n");
+            return 5;
+        }
+    }
+
+    asm volatile ("csrc mie, %0" :: "r"(MIP_MSIP));
+    print_str("irq load-use: ");
+    print_uint(RUNS);
+    print_str(" runs, every interrupt taken as a trap\n");
+    return 0;
+}
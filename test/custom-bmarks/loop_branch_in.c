@@ -0,0 +1,70 @@
+// Runs short loops that are entered by a branch into the middle of their
+// body and that branch over part of the body on every other iteration, so
+// that on the 5-stage with USE_LOOP_BUFFER the buffer sees fetches killed by
+// these branches while it fills. Every run is checked against the same loop
+// in C. Prints mhpmcounter5, the instructions the loop buffer supplied (0
+// without it).
+
+#include "util.h"
+
+#define RUNS 12
+
+long loop_branch_in(long n, long enter_mid);
+
+// Each iteration adds 1, then 16 on even n only, then 4. Entering in the
+// middle skips the first two adds of the first iteration.
+asm (
+"   .text\n"
+"   .align 2\n"
+"   .globl loop_branch_in\n"
+"loop_branch_in:\n"
+"   li a2, 0\n"
+"   bnez a1, lbi_mid\n"
+"lbi_top:\n"
+"   addi a2, a2, 1\n"
+"   andi t0, a0, 1\n"
+"   bnez t0, lbi_mid\n"
+"   addi a2, a2, 16\n"
+"lbi_mid:\n"
+"   addi a2, a2, 4\n"
+"   addi a0, a0, -1\n"
+"   bnez a0, lbi_top\n"
+"   mv a0, a2\n"
+"   ret\n"
+);
+
+static long expect(long n, long enter_mid)
+{
+    long sum = 0;
+    for (int first = 1; n != 0; n--, first = 0) {
+        if (!(first && enter_mid)) {
+            sum += 1;
+            if (!(n & 1))
+                sum += 16;
+        }
+        sum += 4;
+    }
+    return sum;
+}
+
+int main(void)
+{
+    unsigned long hits;
+
+    for (long n = 1; n <= RUNS; n++) {
+        for (long mid = 0; mid < 2; mid++) {
+            if (loop_branch_in(n, mid) != expect(n, mid)) {
+                print_str("loop_branch_in: wrong result for n = ");
+                print_uint(n);
+                print_str(mid ? " entered in the middle\n" : "\n");
+                return 1;
+            }
+        }
+    }
+
+    asm volatile ("csrr %0, mhpmcounter5" : "=r"(hits));
+    print_str("loop buffer: ");
+    print_uint(hits);
+    print_str(" instructions supplied\n");
+    return 0;
+}
@@ -0,0 +1,106 @@
+// Compares copying a buffer from off-tile memory into the scratchpad with
+// core loads/stores against the tile-local DMA engine (WithSodorDMA). Then
+// pushes a misaligned descriptor and checks that the engine skips it and
+// reports the error.
+//
+// The program itself runs out of the scratchpad; OFFTILE_BASE must point at
+// memory outside of the tile (e.g. a system bus scratchpad or DRAM).
+
+#include "util.h"
+
+#define DMA_BASE      0x64001000
+#define OFFTILE_BASE  0x08000000
+
+#define DMA_SRC       (*(volatile unsigned int *)(DMA_BASE + 0x00))
+#define DMA_DST       (*(volatile unsigned int *)(DMA_BASE + 0x04))
+#define DMA_LEN       (*(volatile unsigned int *)(DMA_BASE + 0x08))
+#define DMA_PUSH      (*(volatile unsigned int *)(DMA_BASE + 0x0c))
+#define DMA_STATUS    (*(volatile unsigned int *)(DMA_BASE + 0x10))
+#define DMA_DONE      (*(volatile unsigned int *)(DMA_BASE + 0x14))
+#define DMA_ACK       (*(volatile unsigned int *)(DMA_BASE + 0x18))
+
+#define DMA_STATUS_BUSY  0x1
+#define DMA_STATUS_ERROR 0x8
+#define DMA_ACK_ERROR    0x2
+
+#define WORDS 1024
+
+static unsigned int buf[WORDS] __attribute__((aligned(64)));
+
+static inline unsigned int rdcycle(void)
+{
+    unsigned int c;
+    asm volatile ("rdcycle %0" : "=r"(c));
+    return c;
+}
+
+static void cpu_copy(unsigned int *dst, volatile unsigned int *src, int words)
+{
+    for (int i = 0; i < words; i++)
+        dst[i] = src[i];
+}
+
+static void dma_copy(unsigned int *dst, volatile unsigned int *src, int words)
+{
+    unsigned int done = DMA_DONE;
+    DMA_SRC = (unsigned long)src;
+    DMA_DST = (unsigned long)dst;
+    DMA_LEN = words * sizeof(unsigned int);
+    DMA_PUSH = 0;
+    while (DMA_DONE == done)
+        ;
+}
+
+static int check(void)
+{
+    for (int i = 0; i < WORDS; i++)
+        if (buf[i] != i * 0x01010101u)
+            return 0;
+    return 1;
+}
+
+int main(void)
+{
+    volatile unsigned int *src = (volatile unsigned int *)OFFTILE_BASE;
+    unsigned int start, cpu_cycles, dma_cycles;
+
+    for (int i = 0; i < WORDS; i++)
+        src[i] = i * 0x01010101u;
+
+    for (int i = 0; i < WORDS; i++)
+        buf[i] = 0;
+    start = rdcycle();
+    cpu_copy(buf, src, WORDS);
+    cpu_cycles = rdcycle() - start;
+    if (!check())
+        return 1;
+
+    for (int i = 0; i < WORDS; i++)
+        buf[i] = 0;
+    start = rdcycle();
+    dma_copy(buf, src, WORDS);
+    dma_cycles = rdcycle() - start;
+    if (!check())
+        return 2;
+    if (DMA_STATUS & (DMA_STATUS_BUSY | DMA_STATUS_ERROR))
+        return 3;
+
+    // Misaligned source: nothing is copied
+    for (int i = 0; i < WORDS; i++)
+        buf[i] = 0;
+    dma_copy(buf, (volatile unsigned int *)((unsigned long)src + 2), WORDS);
+    if (!(DMA_STATUS & DMA_STATUS_ERROR) || buf[1] != 0)
+        return 4;
+    DMA_ACK = DMA_ACK_ERROR;
+    if (DMA_STATUS & DMA_STATUS_ERROR)
+        return 5;
+
+    print_str("memcpy ");
+    print_uint(WORDS * sizeof(unsigned int));
+    print_str(" bytes: cpu ");
+    print_uint(cpu_cycles);
+    print_str(" cycles, dma ");
+    print_uint(dma_cycles);
+    print_str(" cycles\n");
+    return 0;
+}
@@ -0,0 +1,68 @@
+// vvadd and a strided gather over arrays outside the scratchpad, the access
+// patterns the stride prefetcher (WithSodorPrefetcher) is meant for. Prints
+// the cycles of each kernel and checks the results; an emulator built with
+// the prefetcher also prints its accuracy and coverage on exit. Run it with
+// and without the prefetcher to compare.
+//
+// The program itself runs out of the scratchpad; OFFTILE_BASE must point at
+// off-chip memory past its end.
+
+#include "util.h"
+
+#define OFFTILE_BASE 0x80100000
+#define N            512
+#define STRIDE       5 // words, for the gather
+
+static inline unsigned long rdcycle(void)
+{
+    unsigned long c;
+    asm volatile ("rdcycle %0" : "=r"(c));
+    return c;
+}
+
+static void report(const char *kernel, unsigned long cycles)
+{
+    print_str(kernel);
+    print_uint(cycles);
+    print_str(" cycles, ");
+    print_uint(cycles / N);
+    print_str(" per element\n");
+}
+
+int main(void)
+{
+    int *a = (int *)OFFTILE_BASE;
+    int *b = a + N;
+    int *c = b + N;
+    int *g = c + N; // N * STRIDE words
+    int err = 0;
+    long sum = 0, expect = 0;
+
+    for (int i = 0; i < N; i++) {
+        a[i] = i;
+        b[i] = 3 * i;
+    }
+    for (int i = 0; i < N * STRIDE; i++)
+        g[i] = i;
+
+    unsigned long c0 = rdcycle();
+    for (int i = 0; i < N; i++)
+        c[i] = a[i] + b[i];
+    report("vvadd:  ", rdcycle() - c0);
+
+    c0 = rdcycle();
+    for (int i = 0; i < N; i++)
+        sum += g[i * STRIDE];
+    report("gather: ", rdcycle() - c0);
+
+    for (int i = 0; i < N; i++) {
+        if (c[i] != 4 * i)
+            err = 1;
+        expect += i * STRIDE;
+    }
+    if (sum != expect)
+        err = 1;
+    if (err)
+        print_str("prefetch_vvadd: wrong result\n");
+    return err;
+}
@@ -0,0 +1,77 @@
+// Measures one kernel with the 5-stage's match triggers: trigger 0 starts
+// measuring when roi_begin() is executed and trigger 1 stops it when roi_end()
+// is. Prints mhpmcounter3/4, the cycles and instructions counted in between,
+// next to the rdcycle difference around the whole call sequence.
+//
+// Needs an emulator built with WithSodorTriggers; with roiOnly (the default)
+// its instruction trace also covers only the kernel, so
+// `scripts/tracer.py --roi` reports on the kernel alone. Elsewhere, writing
+// the trigger CSRs traps as illegal.
+
+#include "util.h"
+
+#define N 256
+
+#define MCONTROL_TYPE   (2ul << (sizeof(long) * 8 - 4))
+#define MCONTROL_ACTION(a) ((unsigned long)(a) << 12)
+#define MCONTROL_M      (1ul << 6)
+#define MCONTROL_EXEC   (1ul << 2)
+#define ACTION_START    2
+#define ACTION_STOP     3
+
+static int data[N];
+
+static void __attribute__((noinline)) roi_begin(void) { asm volatile (""); }
+static void __attribute__((noinline)) roi_end(void) { asm volatile (""); }
+
+static void set_trigger(unsigned long n, void (*pc)(void), unsigned long action)
+{
+    asm volatile ("csrw tselect, %0" :: "r"(n));
+    asm volatile ("csrw tdata2, %0" :: "r"(pc));
+    asm volatile ("csrw tdata1, %0" :: "r"(MCONTROL_TYPE | MCONTROL_ACTION(action) | MCONTROL_M | MCONTROL_EXEC));
+}
+
+static long kernel(void)
+{
+    long sum = 0;
+    for (int i = 0; i < N; i++)
+        sum += data[i] * data[N - 1 - i];
+    return sum;
+}
+
+int main(void)
+{
+    unsigned long c0, c1, cycles, insts;
+    long sum, expect = 0;
+
+    for (int i = 0; i < N; i++)
+        data[i] = i;
+    for (int i = 0; i < N; i++)
+        expect += (long)i * (N - 1 - i);
+
+    set_trigger(0, roi_begin, ACTION_START);
+    set_trigger(1, roi_end, ACTION_STOP);
+
+    asm volatile ("rdcycle %0" : "=r"(c0));
+    roi_begin();
+    sum = kernel();
+    roi_end();
+    asm volatile ("rdcycle %0" : "=r"(c1));
+
+    asm volatile ("csrr %0, mhpmcounter3" : "=r"(cycles));
+    asm volatile ("csrr %0, mhpmcounter4" : "=r"(insts));
+
+    print_str("roi: ");
+    print_uint(cycles);
+    print_str(" cycles, ");
+    print_uint(insts);
+    print_str(" instructions measured, ");
+    print_uint(c1 - c0);
+    print_str(" cycles around them\n");
+
+    if (sum != expect) {
+        print_str("roi_trigger: wrong result\n");
+        return 1;
+    }
+    return 0;
+}
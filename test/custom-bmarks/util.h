@@ -0,0 +1,29 @@
+// Output helpers shared by the benchmarks. putchar (crt.S) goes through the
+// host (an HTIF write syscall on tohost) unless the benchmarks are built with
+// CONSOLE=1 for an emulator with WithSodorConsole, which prints with a single
+// store to the MMIO console.
+
+#ifndef SODOR_BMARKS_UTIL_H
+#define SODOR_BMARKS_UTIL_H
+
+int putchar(int c);
+
+static inline void print_str(const char *s)
+{
+    while (*s)
+        putchar(*s++);
+}
+
+static inline void print_uint(unsigned long x)
+{
+    char digits[20];
+    int n = 0;
+    do {
+        digits[n++] = '0' + x % 10;
+        x /= 10;
+    } while (x);
+    while (n)
+        putchar(digits[--n]);
+}
+
+#endif
@@ -0,0 +1,73 @@
+// Byte and word memset and a word memcpy over buffers outside the scratchpad.
+// Every such store is a bus round trip of its own unless the emulator is
+// built with the write-combining buffer (WithSodorWriteCombine), which merges
+// them into line bursts. Prints the cycles of each loop and checks the
+// results; run it with and without the buffer to compare. Last, it writes a
+// small function to off-chip memory and calls it after a FENCE.I, which must
+// drain the buffer before the function is fetched.
+//
+// The program itself runs out of the scratchpad; OFFTILE_BASE must point at
+// off-chip memory past its end.
+
+#include "util.h"
+
+#define OFFTILE_BASE 0x80100000
+#define BYTES        4096
+
+static inline unsigned long rdcycle(void)
+{
+    unsigned long c;
+    asm volatile ("rdcycle %0" : "=r"(c));
+    return c;
+}
+
+static void report(const char *loop, unsigned long cycles)
+{
+    print_str(loop);
+    print_uint(cycles);
+    print_str(" cycles for ");
+    print_uint(BYTES);
+    print_str(" bytes\n");
+}
+
+int main(void)
+{
+    volatile unsigned char *dst8 = (volatile unsigned char *)OFFTILE_BASE;
+    volatile unsigned int *dst = (volatile unsigned int *)OFFTILE_BASE;
+    volatile unsigned int *src = (volatile unsigned int *)(OFFTILE_BASE + BYTES);
+    unsigned long c0;
+    int err = 0;
+
+    c0 = rdcycle();
+    for (int i = 0; i < BYTES; i++)
+        dst8[i] = 0x5a;
+    report("memset (bytes): ", rdcycle() - c0);
+    for (int i = 0; i < BYTES / 4; i++)
+        if (dst[i] != 0x5a5a5a5a)
+            err = 1;
+
+    c0 = rdcycle();
+    for (int i = 0; i < BYTES / 4; i++)
+        src[i] = i;
+    report("memset (words): ", rdcycle() - c0);
+
+    c0 = rdcycle();
+    for (int i = 0; i < BYTES / 4; i++)
+        dst[i] = src[i];
+    report("memcpy (words): ", rdcycle() - c0);
+    for (int i = 0; i < BYTES / 4; i++)
+        if (dst[i] != i)
+            err = 1;
+
+    // addi a0, zero, 42; ret
+    volatile unsigned int *code = (volatile unsigned int *)(OFFTILE_BASE + 2 * BYTES);
+    code[0] = 0x02a00513;
+    code[1] = 0x00008067;
+    asm volatile ("fence.i" ::: "memory");
+    if (((int (*)(void))code)() != 42)
+        err = 1;
+
+    if (err)
+        print_str("wc_memset: wrong result\n");
+    return err;
+}
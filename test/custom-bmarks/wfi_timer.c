@@ -0,0 +1,66 @@
+// Sleeps on the machine timer: each round arms mtimecmp PERIOD ticks ahead and
+// waits in WFI, with the timer interrupt enabled in mie but interrupts off in
+// mstatus, so that the hart wakes up without taking a trap.
+//
+// Prints the mtime ticks slept and the cycles they took. On an emulator built
+// with WithSodorIdleSkip the hart's mtime jumps to mtimecmp once it sleeps, so
+// the cycle count stays small whatever PERIOD.
+
+#include "encoding.h"
+#include "util.h"
+
+#define CLINT_BASE        0x02000000
+#define CLINT_MTIMECMP_LO (*(volatile unsigned int *)(CLINT_BASE + 0x4000)) // hart 0
+#define CLINT_MTIMECMP_HI (*(volatile unsigned int *)(CLINT_BASE + 0x4004))
+#define CLINT_MTIME_LO    (*(volatile unsigned int *)(CLINT_BASE + 0xbff8))
+#define CLINT_MTIME_HI    (*(volatile unsigned int *)(CLINT_BASE + 0xbffc))
+
+#define ROUNDS 8
+#define PERIOD 10000
+
+static unsigned long long mtime(void)
+{
+    unsigned int hi, lo;
+    do {
+        hi = CLINT_MTIME_HI;
+        lo = CLINT_MTIME_LO;
+    } while (hi != CLINT_MTIME_HI);
+    return ((unsigned long long)hi << 32) | lo;
+}
+
+// low word first to all ones, so that no earlier compare value shows in between
+static void set_mtimecmp(unsigned long long t)
+{
+    CLINT_MTIMECMP_LO = ~0u;
+    CLINT_MTIMECMP_HI = t >> 32;
+    CLINT_MTIMECMP_LO = t;
+}
+
+int main(void)
+{
+    unsigned long long start, deadline;
+    unsigned long c0, c1;
+
+    asm volatile ("csrc mstatus, %0" :: "r"(MSTATUS_MIE));
+    asm volatile ("csrs mie, %0" :: "r"(MIP_MTIP));
+
+    start = mtime();
+    asm volatile ("rdcycle %0" : "=r"(c0));
+    for (int i = 0; i < ROUNDS; i++) {
+        deadline = mtime() + PERIOD;
+        set_mtimecmp(deadline);
+        while (mtime() < deadline)
+            asm volatile ("wfi");
+    }
+    asm volatile ("rdcycle %0" : "=r"(c1));
+
+    set_mtimecmp(~0ull);
+    asm volatile ("csrc mie, %0" :: "r"(MIP_MTIP));
+
+    print_str("wfi timer: ");
+    print_uint((unsigned int)(mtime() - start));
+    print_str(" ticks asleep in ");
+    print_uint((unsigned int)(c1 - c0));
+    print_str(" cycles\n");
+    return 0;
+}